@@ -412,3 +412,29 @@ SELECT notify_name, be_pid = (select t.be_pid from dblink('select pg_backend_pid
 SELECT * from dblink_get_notify();
 
 SELECT dblink_disconnect();
+
+-- test that a seqscan qual evaluated as a heap scan key is rechecked against
+-- the new version of a row that was concurrently updated
+CREATE TABLE epq_keys (id int, val int);
+INSERT INTO epq_keys VALUES (1, 1), (2, 1);
+SELECT dblink_connect('dtest1', 'dbname=contrib_regression');
+BEGIN;
+UPDATE epq_keys SET val = 2 WHERE id = 1;
+SELECT dblink_send_query('dtest1',
+  'UPDATE epq_keys SET val = val + 10 WHERE val = 1 RETURNING id, val');
+-- wait (for at most a minute) until the other session blocks on our update
+DO $$
+BEGIN
+  FOR i IN 1..6000 LOOP
+    EXIT WHEN EXISTS (SELECT 1 FROM pg_locks
+                      WHERE locktype = 'transactionid' AND NOT granted);
+    PERFORM pg_sleep(0.01);
+  END LOOP;
+END
+$$;
+COMMIT;
+-- row 1 no longer has val = 1, so only row 2 may be updated
+SELECT * FROM dblink_get_result('dtest1') AS t(id int, val int);
+SELECT dblink_disconnect('dtest1');
+SELECT * FROM epq_keys ORDER BY id;
+DROP TABLE epq_keys;
@@ -17,6 +17,7 @@
 
 #include "access/heapam.h"
 #include "access/hio.h"
+#include "access/visibilitymap.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
@@ -95,6 +96,138 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
 	return buffer;
 }
 
+/*
+ * Extend the relation by several blocks at once, for RelationGetBufferForTuple.
+ *
+ * This is done when other backends are queued up behind us on the relation
+ * extension lock, so that they find pages in the FSM when they get the lock
+ * rather than each adding one block in turn.  The number of blocks added
+ * is proportional to the number of waiters, up to a limit.  The new pages
+ * are initialized as empty heap pages and entered into the FSM.  They are
+ * read in with the caller's bulk-insert strategy, if any, so that a bulk
+ * load doesn't push them all through the shared buffer pool.
+ *
+ * Caller must hold the relation extension lock.
+ */
+static void
+RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
+{
+	BlockNumber firstBlock = InvalidBlockNumber;
+	BlockNumber blockNum = InvalidBlockNumber;
+	Size		freespace = 0;
+	int			extraBlocks;
+	int			lockWaiters;
+
+	/* Use the length of the lock wait queue to judge how much to extend. */
+	lockWaiters = RelationExtensionLockWaiterCount(relation);
+	if (lockWaiters <= 0)
+		return;
+
+	/*
+	 * Add enough pages to keep each waiter, and the ones likely to queue up
+	 * behind them, busy for a while; a waiter with large tuples fills a page
+	 * quickly.  512 is just an arbitrary cap to prevent pathological results.
+	 */
+	extraBlocks = Min(512, lockWaiters * 20);
+
+	while (extraBlocks-- > 0)
+	{
+		Buffer		buffer;
+		Page		page;
+
+		/*
+		 * Extend by one page, and initialize it as we do for our own new page
+		 * below.  Nobody else can see the page before we release the
+		 * extension lock, so there's no need to WAL-log the initialization:
+		 * the first insertion into the page will reinitialize it on replay.
+		 */
+		buffer = ReadBufferExtended(relation, MAIN_FORKNUM, P_NEW, RBM_NORMAL,
+								   bistate ? bistate->strategy : NULL);
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+
+		page = BufferGetPage(buffer);
+		blockNum = BufferGetBlockNumber(buffer);
+
+		if (!PageIsNew(page))
+			elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
+				 blockNum, RelationGetRelationName(relation));
+
+		PageInit(page, BufferGetPageSize(buffer), 0);
+		freespace = PageGetHeapFreeSpace(page);
+		MarkBufferDirty(buffer);
+
+		UnlockReleaseBuffer(buffer);
+
+		if (firstBlock == InvalidBlockNumber)
+			firstBlock = blockNum;
+	}
+
+	/*
+	 * Advertise the new pages in the FSM, including its upper levels, so
+	 * that the backends waiting for the extension lock will find them.
+	 */
+	RecordNewPagesWithFreeSpace(relation, firstBlock, blockNum, freespace);
+}
+
+/*
+ * For each heap page which is all-visible, acquire a pin on the appropriate
+ * visibility map page, if we haven't already got one.
+ *
+ * buffer2 may be InvalidBuffer, if only one buffer is involved.  buffer1
+ * must not be InvalidBuffer.  If both buffers are specified, block1 must
+ * be less than or equal to block2.  Both buffers are locked on entry, and
+ * again on return, but may have been unlocked in between.
+ */
+static void
+GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
+					 BlockNumber block1, BlockNumber block2,
+					 Buffer *vmbuffer1, Buffer *vmbuffer2)
+{
+	bool		need_to_pin_buffer1;
+	bool		need_to_pin_buffer2;
+
+	Assert(BufferIsValid(buffer1));
+	Assert(buffer2 == InvalidBuffer || block1 <= block2);
+
+	for (;;)
+	{
+		/* Figure out which pins we need but don't have. */
+		need_to_pin_buffer1 = PageIsAllVisible(BufferGetPage(buffer1))
+			&& !visibilitymap_pin_ok(block1, *vmbuffer1);
+		need_to_pin_buffer2 = buffer2 != InvalidBuffer
+			&& PageIsAllVisible(BufferGetPage(buffer2))
+			&& !visibilitymap_pin_ok(block2, *vmbuffer2);
+		if (!need_to_pin_buffer1 && !need_to_pin_buffer2)
+			return;
+
+		/* We must unlock both buffers before doing any I/O. */
+		LockBuffer(buffer1, BUFFER_LOCK_UNLOCK);
+		if (buffer2 != InvalidBuffer && buffer2 != buffer1)
+			LockBuffer(buffer2, BUFFER_LOCK_UNLOCK);
+
+		/* Get pins. */
+		if (need_to_pin_buffer1)
+			visibilitymap_pin(relation, block1, vmbuffer1);
+		if (need_to_pin_buffer2)
+			visibilitymap_pin(relation, block2, vmbuffer2);
+
+		/* Relock buffers. */
+		LockBuffer(buffer1, BUFFER_LOCK_EXCLUSIVE);
+		if (buffer2 != InvalidBuffer && buffer2 != buffer1)
+			LockBuffer(buffer2, BUFFER_LOCK_EXCLUSIVE);
+
+		/*
+		 * If there are two buffers involved and we pinned just one of them,
+		 * it's possible that the second one became all-visible while we were
+		 * busy pinning the first one.  If it looks like that's a possible
+		 * scenario, we'll need to make a second pass through this loop.
+		 */
+		if (buffer2 == InvalidBuffer || buffer1 == buffer2 ||
+			(need_to_pin_buffer1 && need_to_pin_buffer2))
+			break;
+	}
+}
+
 /*
  * RelationGetBufferForTuple
  *
@@ -139,6 +272,18 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
  *	BULKWRITE buffer selection strategy object to the buffer manager.
  *	Passing NULL for bistate selects the default behavior.
  *
+ *	When other backends are waiting to extend the relation too, we add a
+ *	batch of pages at a time and enter the extra ones into the FSM for them
+ *	to use (see RelationAddExtraBlocks).
+ *
+ *	If the selected page (or the otherBuffer page) is all-visible, the
+ *	visibility map page covering it is pinned in *vmbuffer (or
+ *	*vmbuffer_other) before we return, so that the caller can clear its
+ *	bits without doing I/O while holding the buffer lock.  On entry, these
+ *	should be InvalidBuffer or pins from an earlier visibilitymap_pin call;
+ *	the caller must release them.  vmbuffer_other may be NULL if there is
+ *	no otherBuffer.
+ *
  *	We always try to avoid filling existing pages further than the fillfactor.
  *	This is OK since this routine is not consulted when updating a tuple and
  *	keeping it on the same page, which is the scenario fillfactor is meant
@@ -150,7 +295,8 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
 Buffer
 RelationGetBufferForTuple(Relation relation, Size len,
 						  Buffer otherBuffer, int options,
-						  struct BulkInsertStateData *bistate)
+						  struct BulkInsertStateData *bistate,
+						  Buffer *vmbuffer, Buffer *vmbuffer_other)
 {
 	bool		use_fsm = !(options & HEAP_INSERT_SKIP_FSM);
 	Buffer		buffer = InvalidBuffer;
@@ -231,6 +377,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 		}
 	}
 
+loop:
 	while (targetBlock != InvalidBlockNumber)
 	{
 		/*
@@ -242,18 +389,24 @@ RelationGetBufferForTuple(Relation relation, Size len,
 		{
 			/* easy case */
 			buffer = ReadBufferBI(relation, targetBlock, bistate);
+			if (PageIsAllVisible(BufferGetPage(buffer)))
+				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 		}
 		else if (otherBlock == targetBlock)
 		{
 			/* also easy case */
 			buffer = otherBuffer;
+			if (PageIsAllVisible(BufferGetPage(buffer)))
+				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 		}
 		else if (otherBlock < targetBlock)
 		{
 			/* lock other buffer first */
 			buffer = ReadBuffer(relation, targetBlock);
+			if (PageIsAllVisible(BufferGetPage(buffer)))
+				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 		}
@@ -261,10 +414,27 @@ RelationGetBufferForTuple(Relation relation, Size len,
 		{
 			/* lock target buffer first */
 			buffer = ReadBuffer(relation, targetBlock);
+			if (PageIsAllVisible(BufferGetPage(buffer)))
+				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 			LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
 		}
 
+		/*
+		 * The PageIsAllVisible checks above were made without the buffer
+		 * lock, so the page (or the other page) may have become all-visible
+		 * since.  If so, get the missing pins now; that means unlocking and
+		 * relocking the buffers, but shouldn't happen often.
+		 */
+		if (otherBuffer == InvalidBuffer || targetBlock <= otherBlock)
+			GetVisibilityMapPins(relation, buffer, otherBuffer,
+								 targetBlock, otherBlock, vmbuffer,
+								 vmbuffer_other);
+		else
+			GetVisibilityMapPins(relation, otherBuffer, buffer,
+								 otherBlock, targetBlock, vmbuffer_other,
+								 vmbuffer);
+
 		/*
 		 * Now we can check to see if there's enough free space here. If so,
 		 * we're done.
@@ -317,8 +487,35 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	 */
 	needLock = !RELATION_IS_LOCAL(relation);
 
+	/*
+	 * If we need the lock but can't get it immediately, others are extending
+	 * the relation at the same time, so once we have it we extend by several
+	 * blocks for them.  That only helps if they look in the FSM, though.
+	 */
 	if (needLock)
-		LockRelationForExtension(relation, ExclusiveLock);
+	{
+		if (!use_fsm)
+			LockRelationForExtension(relation, ExclusiveLock);
+		else if (!ConditionalLockRelationForExtension(relation, ExclusiveLock))
+		{
+			/* Couldn't get the lock immediately; wait for it. */
+			LockRelationForExtension(relation, ExclusiveLock);
+
+			/*
+			 * Whoever held the lock may have added pages for us meanwhile; if
+			 * so, use them rather than extending the relation further.
+			 */
+			targetBlock = GetPageWithFreeSpace(relation, len + saveFreeSpace);
+			if (targetBlock != InvalidBlockNumber)
+			{
+				UnlockRelationForExtension(relation, ExclusiveLock);
+				goto loop;
+			}
+
+			/* Time to bulk-extend. */
+			RelationAddExtraBlocks(relation, bistate);
+		}
+	}
 
 	/*
 	 * XXX This does an lseek - rather expensive - but at the moment it is the
@@ -330,7 +527,9 @@ RelationGetBufferForTuple(Relation relation, Size len,
 
 	/*
 	 * We can be certain that locking the otherBuffer first is OK, since it
-	 * must have a lower page number.
+	 * must have a lower page number.  A new page is never all-visible, and
+	 * the otherBuffer page can't have become all-visible while unlocked,
+	 * because heap_update has marked the old tuple with its own xid.
 	 */
 	if (otherBuffer != InvalidBuffer)
 		LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
@@ -376,7 +575,9 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	 * or just keep it for this backend's exclusive use in the short run
 	 * (until VACUUM sees it)?	Seems to depend on whether you expect the
 	 * current backend to make more insertions or not, which is probably a
-	 * good bet most of the time.  So for now, don't add it to FSM yet.
+	 * good bet most of the time.  So for now, don't add it to FSM yet.  (The
+	 * extra pages added by RelationAddExtraBlocks are a different matter:
+	 * they are meant for other backends.)
 	 */
 	RelationSetTargetBlock(relation, BufferGetBlockNumber(buffer));
 
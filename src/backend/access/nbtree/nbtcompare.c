@@ -44,11 +44,15 @@
  *	during an index access won't be recovered till end of query.  This
  *	primarily affects comparison routines for toastable datatypes;
  *	they have to be careful to free any detoasted copy of an input datum.
+ *
+ *	The btXXXsortsupport routines supply direct C comparators for sorting
+ *	(see utils/sortsupport.h); they must agree with the btXXXcmp functions.
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
 #include "utils/builtins.h"
+#include "utils/sortsupport.h"
 
 
 Datum
@@ -69,6 +73,21 @@ btint2cmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32((int32) a - (int32) b);
 }
 
+static int
+btint2fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	int16		a = DatumGetInt16(x);
+	int16		b = DatumGetInt16(y);
+
+	return (int) a - (int) b;
+}
+
+void
+btint2sortsupport(SortSupport ssup)
+{
+	ssup->comparator = btint2fastcmp;
+}
+
 Datum
 btint4cmp(PG_FUNCTION_ARGS)
 {
@@ -83,6 +102,26 @@ btint4cmp(PG_FUNCTION_ARGS)
 		PG_RETURN_INT32(-1);
 }
 
+static int
+btint4fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	int32		a = DatumGetInt32(x);
+	int32		b = DatumGetInt32(y);
+
+	if (a > b)
+		return 1;
+	else if (a == b)
+		return 0;
+	else
+		return -1;
+}
+
+void
+btint4sortsupport(SortSupport ssup)
+{
+	ssup->comparator = btint4fastcmp;
+}
+
 Datum
 btint8cmp(PG_FUNCTION_ARGS)
 {
@@ -97,6 +136,26 @@ btint8cmp(PG_FUNCTION_ARGS)
 		PG_RETURN_INT32(-1);
 }
 
+static int
+btint8fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	int64		a = DatumGetInt64(x);
+	int64		b = DatumGetInt64(y);
+
+	if (a > b)
+		return 1;
+	else if (a == b)
+		return 0;
+	else
+		return -1;
+}
+
+void
+btint8sortsupport(SortSupport ssup)
+{
+	ssup->comparator = btint8fastcmp;
+}
+
 Datum
 btint48cmp(PG_FUNCTION_ARGS)
 {
@@ -195,6 +254,26 @@ btoidcmp(PG_FUNCTION_ARGS)
 		PG_RETURN_INT32(-1);
 }
 
+static int
+btoidfastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	Oid			a = DatumGetObjectId(x);
+	Oid			b = DatumGetObjectId(y);
+
+	if (a > b)
+		return 1;
+	else if (a == b)
+		return 0;
+	else
+		return -1;
+}
+
+void
+btoidsortsupport(SortSupport ssup)
+{
+	ssup->comparator = btoidfastcmp;
+}
+
 Datum
 btoidvectorcmp(PG_FUNCTION_ARGS)
 {
@@ -247,6 +247,17 @@ btgettuple(PG_FUNCTION_ARGS)
 	/* btree indexes are never lossy */
 	scan->xs_recheck = false;
 
+	/*
+	 * If the caller wants the index tuples, allocate the workspaces we copy
+	 * them into.  They can't be returned straight from the page, since we
+	 * don't hold a lock on it between calls.
+	 */
+	if (scan->xs_want_itup && so->currTuples == NULL)
+	{
+		so->currTuples = (char *) palloc(BLCKSZ * 2);
+		so->markTuples = so->currTuples + BLCKSZ;
+	}
+
 	/*
 	 * If we've already initialized this scan, we can just advance it in the
 	 * appropriate direction.  If we haven't done so yet, we call a routine to
@@ -280,7 +291,37 @@ btgettuple(PG_FUNCTION_ARGS)
 		res = _bt_next(scan, dir);
 	}
 	else
+	{
+		/*
+		 * Starting a new scan.  Set up read-ahead of the heap pages our
+		 * caller is going to visit, unless it's an index-only scan, which
+		 * mostly won't.  This can't be done in btbeginscan, because the
+		 * heap relation isn't known yet at that point.
+		 */
+		so->useReadAhead = (!scan->xs_want_itup &&
+							scan->heapRelation != NULL);
+		if (so->useReadAhead)
+			ReadAheadInit(&so->readahead, scan->heapRelation, MAIN_FORKNUM,
+						  _bt_readahead_next, (void *) scan);
+		so->readaheadBlock = InvalidBlockNumber;
+
 		res = _bt_first(scan, dir);
+	}
+
+	/*
+	 * Keep the heap pages of the following items prefetched, whenever the
+	 * caller moves on to another heap page.
+	 */
+	if (res && so->useReadAhead)
+	{
+		BlockNumber blkno = ItemPointerGetBlockNumber(&scan->xs_ctup.t_self);
+
+		if (blkno != so->readaheadBlock)
+		{
+			so->readaheadBlock = blkno;
+			ReadAheadAdvance(&so->readahead);
+		}
+	}
 
 	PG_RETURN_BOOL(res);
 }
@@ -369,6 +410,10 @@ btrescan(PG_FUNCTION_ARGS)
 			so->keyData = NULL;
 		so->killedItems = NULL; /* until needed */
 		so->numKilled = 0;
+		so->currTuples = so->markTuples = NULL; /* until needed */
+		so->useReadAhead = false;	/* until btgettuple sets it up */
+		so->readaheadBlock = InvalidBlockNumber;
+		so->prefetchStep = 1;
 		scan->opaque = so;
 	}
 
@@ -430,6 +475,9 @@ btendscan(PG_FUNCTION_ARGS)
 
 	if (so->killedItems != NULL)
 		pfree(so->killedItems);
+	if (so->currTuples != NULL)
+		pfree(so->currTuples);
+	/* so->markTuples should not be pfree'd, see btgettuple() */
 	if (so->keyData != NULL)
 		pfree(so->keyData);
 	pfree(so);
@@ -504,9 +552,16 @@ btrestrpos(PG_FUNCTION_ARGS)
 			memcpy(&so->currPos, &so->markPos,
 				   offsetof(BTScanPosData, items[1]) +
 				   so->markPos.lastItem * sizeof(BTScanPosItem));
+			if (so->currTuples)
+				memcpy(so->currTuples, so->markTuples,
+					   so->markPos.nextTupleOffset);
 		}
 	}
 
+	/* restart heap read-ahead from the restored position */
+	if (BTScanPosIsValid(so->currPos))
+		_bt_reset_readahead(so);
+
 	PG_RETURN_VOID();
 }
 
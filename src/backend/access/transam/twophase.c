@@ -315,7 +315,7 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 	gxact->proc.inCommit = false;
 	gxact->proc.vacuumFlags = 0;
 	gxact->proc.lwWaiting = false;
-	gxact->proc.lwExclusive = false;
+	gxact->proc.lwWaitMode = 0;
 	gxact->proc.lwWaitLink = NULL;
 	gxact->proc.waitLock = NULL;
 	gxact->proc.waitProcLock = NULL;
@@ -291,7 +291,31 @@ static XLogRecPtr RedoStartLSN = {0, 0};
  * so it's a plain spinlock.  The other locks are held longer (potentially
  * over I/O operations), so we use LWLocks for them.  These locks are:
  *
- * WALInsertLock: must be held to insert a record into the WAL buffers.
+ * WALInsertLock: must be held to reserve space for a record in the WAL
+ * buffers (and, for records that don't qualify for the concurrent copy
+ * described below, to copy the record into them).
+ *
+ * XLog insertion slots: most records are copied into the WAL buffers after
+ * WALInsertLock has been released.  While reserving space, the inserter sets
+ * up every page the record will touch (including continuation headers), so
+ * the copy itself needs no lock; but to let writers know the data is not
+ * there yet, the inserter holds one of NUM_XLOGINSERT_SLOTS slot LWLocks
+ * and advertises the start of its record in the slot's insertingAt field.
+ * Before XLogWrite writes out WAL up to some point, it waits for every
+ * advertised insertion that starts before that point to finish.  A slot is
+ * always acquired before WALInsertLock, and insertingAt is only set while
+ * WALInsertLock is held, so anyone who has learned of a WAL position by any
+ * route also sees every in-progress insertion below it.
+ *
+ * The waiter never acquires a slot's lock; it sleeps in LWLockWaitForVar
+ * until insertingAt changes or the lock is released.  Several backends can
+ * share a slot, and one of them may be queued for the slot lock while it
+ * holds nothing else, or hold it while it waits for WALInsertLock; waiting
+ * for the lock itself could therefore deadlock against a writer that holds
+ * WALInsertLock.  A slot holder that has advertised an insertion only
+ * copies data until it lets go of the slot, and a backend gives up its slot
+ * before doing anything that could lead to XLogWrite, so the wait always
+ * ends.
  *
  * WALWriteLock: must be held to write WAL buffers to disk (XLogWrite or
  * XLogFlush).
@@ -342,6 +366,38 @@ typedef struct XLogCtlWrite
 	pg_time_t	lastSegSwitchTime;		/* time of last xlog segment switch */
 } XLogCtlWrite;
 
+/*
+ * Shared state of an XLog insertion slot.  insertingAt is the start of the
+ * record whose data is being copied into the WAL buffers by the holder of
+ * the slot's lock, or 0 if no copy is in progress.  It is stored as a
+ * 64-bit integer (see XLogRecPtrToSlotPos) so that it can be used with
+ * LWLockUpdateVar and LWLockWaitForVar, which protect it with the slot
+ * lock's own mutex.
+ */
+typedef struct XLogInsertSlot
+{
+	uint64		insertingAt;
+} XLogInsertSlot;
+
+#define XLogInsertSlotLock(slotno)	((LWLockId) (FirstXLogInsertSlotLock + (slotno)))
+
+#define XLogRecPtrToSlotPos(ptr) \
+	(((uint64) (ptr).xlogid << 32) | (uint64) (ptr).xrecoff)
+
+/*
+ * Largest number of buffer pages a record may touch and still be copied
+ * outside WALInsertLock.  Bigger records are rare and are copied while
+ * holding the lock, as before.
+ */
+#define XLOGINSERT_MAX_PAGES	8
+
+/* A piece of a record's data area, within a single WAL buffer page */
+typedef struct XLogInsertSegment
+{
+	char	   *dest;			/* where the piece goes */
+	uint32		len;			/* and its length */
+} XLogInsertSegment;
+
 /*
  * Total shared-memory state for XLOG.
  */
@@ -360,6 +416,9 @@ typedef struct XLogCtlData
 	/* Protected by WALWriteLock: */
 	XLogCtlWrite Write;
 
+	/* Each protected by its slot lock's mutex: */
+	XLogInsertSlot insertSlots[NUM_XLOGINSERT_SLOTS];
+
 	/*
 	 * These values do not change after startup, although the pointed-to pages
 	 * and xlblocks values certainly do.  Permission to read/write the pages
@@ -504,6 +563,14 @@ static void CheckRequiredParameterValues(CheckPoint checkPoint);
 static void LocalSetXLogInsertAllowed(void);
 static void CheckPointGuts(XLogRecPtr checkPointRedo, int flags);
 
+static int	XLogRecordPagesNeeded(uint32 tot_len);
+static bool XLogInsertBuffersFree(int npages);
+static void XLogFillRecordHeader(XLogRecord *record, XLogRecPtr PrevRecPtr,
+					 RmgrId rmid, uint8 info, uint32 len, uint32 write_len,
+					 pg_crc32 rdata_crc);
+static void XLogCopyRecordData(XLogRecData *rdata,
+				   XLogInsertSegment *segs, int nsegs);
+static void WaitXLogInsertionsToFinish(XLogRecPtr upto);
 static bool XLogCheckBuffer(XLogRecData *rdata, bool doPageWrites,
 				XLogRecPtr *lsn, BkpBlock *bkpb);
 static bool AdvanceXLInsertBuffer(bool new_segment);
@@ -542,6 +609,8 @@ static bool CheckForStandbyTrigger(void);
 
 #ifdef WAL_DEBUG
 static void xlog_outrec(StringInfo buf, XLogRecord *record);
+static void xlog_outinsert(XLogRecPtr RecPtr, XLogRecord *record,
+			   XLogRecData *rdata);
 #endif
 static void pg_start_backup_callback(int code, Datum arg);
 static bool read_backup_label(XLogRecPtr *checkPointLoc);
@@ -584,10 +653,18 @@ XLogInsert(RmgrId rmid, uint8 info, XLogRecData *rdata)
 	XLogRecData dtbuf_rdt3[XLR_MAX_BKP_BLOCKS];
 	pg_crc32	rdata_crc;
 	uint32		len,
-				write_len;
+				write_len,
+				est_len;
 	unsigned	i;
 	bool		updrqst;
 	bool		doPageWrites;
+	bool		concurrentCopy;
+	bool		holdingSlot = false;
+	int			slotno = 0;
+	XLogRecPtr	StartPos;
+	XLogRecPtr	PrevRecPtr;
+	XLogInsertSegment segs[XLOGINSERT_MAX_PAGES];
+	int			nsegs = 0;
 	bool		isLogSwitch = (rmid == RM_XLOG_ID && info == XLOG_SWITCH);
 
 	/* cross-check on whether we should be here or not */
@@ -631,6 +708,7 @@ XLogInsert(RmgrId rmid, uint8 info, XLogRecData *rdata)
 	 * over the chain later.
 	 */
 begin:;
+	holdingSlot = false;
 	for (i = 0; i < XLR_MAX_BKP_BLOCKS; i++)
 	{
 		dtbuf[i] = InvalidBuffer;
@@ -743,8 +821,37 @@ begin:;
 	if (len == 0 && !isLogSwitch)
 		elog(PANIC, "invalid xlog record length %u", len);
 
+	/*
+	 * Decide whether the record's data can be copied into the WAL buffers
+	 * after we release WALInsertLock.  That requires that all the pages it
+	 * will touch can be set up while we hold the lock, without recycling a
+	 * buffer page that the record itself occupies.  XLOG SWITCH records are
+	 * always done entirely under the lock.
+	 */
+	est_len = len;
+	for (i = 0; i < XLR_MAX_BKP_BLOCKS; i++)
+	{
+		if (dtbuf_bkp[i])
+			est_len += sizeof(BkpBlock) + BLCKSZ - dtbuf_xlg[i].hole_length;
+	}
+	concurrentCopy = !isLogSwitch &&
+		XLogRecordPagesNeeded(SizeOfXLogRecord + est_len) <=
+		Min(XLOGINSERT_MAX_PAGES, XLOGbuffers / 2);
+
 	START_CRIT_SECTION();
 
+	/*
+	 * Get an insertion slot if we'll need one.  This must be done before
+	 * acquiring WALInsertLock, since a backend holding WALInsertLock may
+	 * have to wait for in-progress copies to finish.
+	 */
+	if (concurrentCopy)
+	{
+		slotno = MyProcPid % NUM_XLOGINSERT_SLOTS;
+		LWLockAcquire(XLogInsertSlotLock(slotno), LW_EXCLUSIVE);
+		holdingSlot = true;
+	}
+
 	/* Now wait to get insert lock */
 	LWLockAcquire(WALInsertLock, LW_EXCLUSIVE);
 
@@ -776,6 +883,8 @@ begin:;
 					 * didn't think so above.  Start over.
 					 */
 					LWLockRelease(WALInsertLock);
+					if (holdingSlot)
+						LWLockRelease(XLogInsertSlotLock(slotno));
 					END_CRIT_SECTION();
 					goto begin;
 				}
@@ -793,6 +902,8 @@ begin:;
 	{
 		/* Oops, must redo it with full-page data */
 		LWLockRelease(WALInsertLock);
+		if (holdingSlot)
+			LWLockRelease(XLogInsertSlotLock(slotno));
 		END_CRIT_SECTION();
 		goto begin;
 	}
@@ -868,12 +979,38 @@ begin:;
 	if ((info & XLR_BKP_BLOCK_MASK) && !Insert->forcePageWrites)
 		info |= XLR_BKP_REMOVABLE;
 
+	/* the set of backup blocks can't have changed since we sized it */
+	Assert(write_len == est_len);
+
+	freespace = INSERT_FREESPACE(Insert);
+
+	/*
+	 * We can only copy the record after releasing the lock if setting up the
+	 * pages it needs won't force us to write out old WAL data: XLogWrite may
+	 * have to wait for in-progress copies, and a copier mustn't wait for
+	 * anything in turn.  If the buffers aren't free yet, do it the old way,
+	 * and give up the slot before anything below can get to XLogWrite.
+	 */
+	if (concurrentCopy)
+	{
+		int			npages;
+
+		npages = XLogRecordPagesNeeded(SizeOfXLogRecord + write_len) - 1;
+		if (freespace < SizeOfXLogRecord)
+			npages++;
+		if (!XLogInsertBuffersFree(npages))
+		{
+			concurrentCopy = false;
+			LWLockRelease(XLogInsertSlotLock(slotno));
+			holdingSlot = false;
+		}
+	}
+
 	/*
 	 * If there isn't enough space on the current XLOG page for a record
 	 * header, advance to the next page (leaving the unused space as zeroes).
 	 */
 	updrqst = false;
-	freespace = INSERT_FREESPACE(Insert);
 	if (freespace < SizeOfXLogRecord)
 	{
 		updrqst = AdvanceXLInsertBuffer(false);
@@ -894,6 +1031,8 @@ begin:;
 	if (isLogSwitch &&
 		(RecPtr.xrecoff % XLogSegSize) == SizeOfXLogLongPHD)
 	{
+		Assert(!holdingSlot);
+
 		/* We can release insert lock immediately */
 		LWLockRelease(WALInsertLock);
 
@@ -922,40 +1061,10 @@ begin:;
 		return RecPtr;
 	}
 
-	/* Insert record header */
-
+	/* Reserve space for the record header, and set up the record's links */
 	record = (XLogRecord *) Insert->currpos;
-	record->xl_prev = Insert->PrevRecord;
-	record->xl_xid = GetCurrentTransactionIdIfAny();
-	record->xl_tot_len = SizeOfXLogRecord + write_len;
-	record->xl_len = len;		/* doesn't include backup blocks */
-	record->xl_info = info;
-	record->xl_rmid = rmid;
-
-	/* Now we can finish computing the record's CRC */
-	COMP_CRC32(rdata_crc, (char *) record + sizeof(pg_crc32),
-			   SizeOfXLogRecord - sizeof(pg_crc32));
-	FIN_CRC32(rdata_crc);
-	record->xl_crc = rdata_crc;
-
-#ifdef WAL_DEBUG
-	if (XLOG_DEBUG)
-	{
-		StringInfoData buf;
-
-		initStringInfo(&buf);
-		appendStringInfo(&buf, "INSERT @ %X/%X: ",
-						 RecPtr.xlogid, RecPtr.xrecoff);
-		xlog_outrec(&buf, record);
-		if (rdata->data != NULL)
-		{
-			appendStringInfo(&buf, " - ");
-			RmgrTable[record->xl_rmid].rm_desc(&buf, record->xl_info, rdata->data);
-		}
-		elog(LOG, "%s", buf.data);
-		pfree(buf.data);
-	}
-#endif
+	PrevRecPtr = Insert->PrevRecord;
+	StartPos = RecPtr;
 
 	/* Record begin of record in appropriate places */
 	ProcLastRecPtr = RecPtr;
@@ -964,43 +1073,98 @@ begin:;
 	Insert->currpos += SizeOfXLogRecord;
 	freespace -= SizeOfXLogRecord;
 
-	/*
-	 * Append the data, including backup blocks if any
-	 */
-	while (write_len)
+	if (concurrentCopy)
 	{
-		while (rdata->data == NULL)
-			rdata = rdata->next;
+		uint32		remaining = write_len;
+
+		/*
+		 * Advertise the insertion before anyone can learn of a WAL position
+		 * beyond its start.
+		 */
+		LWLockUpdateVar(XLogInsertSlotLock(slotno),
+						&XLogCtl->insertSlots[slotno].insertingAt,
+						XLogRecPtrToSlotPos(StartPos));
 
-		if (freespace > 0)
+		/*
+		 * Reserve space for the data, setting up each page it spills onto
+		 * with its continuation record header.  Remember where each piece
+		 * goes; the data itself is copied after we release the lock.
+		 */
+		while (remaining)
 		{
-			if (rdata->len > freespace)
+			if (freespace > 0)
 			{
-				memcpy(Insert->currpos, rdata->data, freespace);
-				rdata->data += freespace;
-				rdata->len -= freespace;
-				write_len -= freespace;
+				uint32		seglen = Min(remaining, freespace);
+
+				Assert(nsegs < XLOGINSERT_MAX_PAGES);
+				segs[nsegs].dest = Insert->currpos;
+				segs[nsegs].len = seglen;
+				nsegs++;
+				Insert->currpos += seglen;
+				freespace -= seglen;
+				remaining -= seglen;
+				if (remaining == 0)
+					break;
 			}
-			else
-			{
-				memcpy(Insert->currpos, rdata->data, rdata->len);
-				freespace -= rdata->len;
-				write_len -= rdata->len;
-				Insert->currpos += rdata->len;
+
+			/* Use next buffer (known not to need writing out) */
+			updrqst = AdvanceXLInsertBuffer(false);
+			curridx = Insert->curridx;
+			/* Insert cont-record header */
+			Insert->currpage->xlp_info |= XLP_FIRST_IS_CONTRECORD;
+			contrecord = (XLogContRecord *) Insert->currpos;
+			contrecord->xl_rem_len = remaining;
+			Insert->currpos += SizeOfXLogContRecord;
+			freespace = INSERT_FREESPACE(Insert);
+		}
+	}
+	else
+	{
+		XLogFillRecordHeader(record, PrevRecPtr, rmid, info, len, write_len,
+							 rdata_crc);
+#ifdef WAL_DEBUG
+		if (XLOG_DEBUG)
+			xlog_outinsert(StartPos, record, rdata);
+#endif
+
+		/*
+		 * Append the data, including backup blocks if any
+		 */
+		while (write_len)
+		{
+			while (rdata->data == NULL)
 				rdata = rdata->next;
-				continue;
+
+			if (freespace > 0)
+			{
+				if (rdata->len > freespace)
+				{
+					memcpy(Insert->currpos, rdata->data, freespace);
+					rdata->data += freespace;
+					rdata->len -= freespace;
+					write_len -= freespace;
+				}
+				else
+				{
+					memcpy(Insert->currpos, rdata->data, rdata->len);
+					freespace -= rdata->len;
+					write_len -= rdata->len;
+					Insert->currpos += rdata->len;
+					rdata = rdata->next;
+					continue;
+				}
 			}
-		}
 
-		/* Use next buffer */
-		updrqst = AdvanceXLInsertBuffer(false);
-		curridx = Insert->curridx;
-		/* Insert cont-record header */
-		Insert->currpage->xlp_info |= XLP_FIRST_IS_CONTRECORD;
-		contrecord = (XLogContRecord *) Insert->currpos;
-		contrecord->xl_rem_len = write_len;
-		Insert->currpos += SizeOfXLogContRecord;
-		freespace = INSERT_FREESPACE(Insert);
+			/* Use next buffer */
+			updrqst = AdvanceXLInsertBuffer(false);
+			curridx = Insert->curridx;
+			/* Insert cont-record header */
+			Insert->currpage->xlp_info |= XLP_FIRST_IS_CONTRECORD;
+			contrecord = (XLogContRecord *) Insert->currpos;
+			contrecord->xl_rem_len = write_len;
+			Insert->currpos += SizeOfXLogContRecord;
+			freespace = INSERT_FREESPACE(Insert);
+		}
 	}
 
 	/* Ensure next record will be properly aligned */
@@ -1105,6 +1269,24 @@ begin:;
 
 	LWLockRelease(WALInsertLock);
 
+	if (concurrentCopy)
+	{
+		/* Now fill in the header and copy the data, without the lock */
+		XLogFillRecordHeader(record, PrevRecPtr, rmid, info, len, write_len,
+							 rdata_crc);
+#ifdef WAL_DEBUG
+		if (XLOG_DEBUG)
+			xlog_outinsert(StartPos, record, rdata);
+#endif
+		XLogCopyRecordData(rdata, segs, nsegs);
+
+		/* Done; let anyone waiting to write out this record proceed */
+		LWLockUpdateVar(XLogInsertSlotLock(slotno),
+						&XLogCtl->insertSlots[slotno].insertingAt, 0);
+	}
+	if (holdingSlot)
+		LWLockRelease(XLogInsertSlotLock(slotno));
+
 	if (updrqst)
 	{
 		/* use volatile pointer to prevent code rearrangement */
@@ -1126,6 +1308,156 @@ begin:;
 	return RecPtr;
 }
 
+/*
+ * Upper bound on the number of WAL buffer pages a record of tot_len bytes
+ * (header included) can touch, wherever on its first page it starts.
+ */
+static int
+XLogRecordPagesNeeded(uint32 tot_len)
+{
+	uint32		usable = XLOG_BLCKSZ - SizeOfXLogLongPHD - SizeOfXLogContRecord;
+
+	return 1 + (tot_len + usable - 1) / usable;
+}
+
+/*
+ * Check whether the npages WAL buffers following the current insertion page
+ * have already been written out, so that AdvanceXLInsertBuffer can move into
+ * them without doing any I/O.
+ *
+ * Must be called with WALInsertLock held.
+ */
+static bool
+XLogInsertBuffersFree(int npages)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	bool		refreshed = false;
+	int			idx = Insert->curridx;
+	int			i;
+
+	/* Use Insert->LogwrtResult copy if it's more fresh */
+	if (XLByteLT(LogwrtResult.Write, Insert->LogwrtResult.Write))
+		LogwrtResult = Insert->LogwrtResult;
+
+	for (i = 0; i < npages; i++)
+	{
+		idx = NextBufIdx(idx);
+		while (!XLByteLE(XLogCtl->xlblocks[idx], LogwrtResult.Write))
+		{
+			/* use volatile pointer to prevent code rearrangement */
+			volatile XLogCtlData *xlogctl = XLogCtl;
+
+			/* Our copy may just be stale; check the shared one, once */
+			if (refreshed)
+				return false;
+			SpinLockAcquire(&xlogctl->info_lck);
+			LogwrtResult = xlogctl->LogwrtResult;
+			SpinLockRelease(&xlogctl->info_lck);
+			Insert->LogwrtResult = LogwrtResult;
+			refreshed = true;
+		}
+	}
+	return true;
+}
+
+/*
+ * Fill in the header of a record that is being inserted, including its CRC.
+ * The CRC of the record's data (rdata, then backup blocks) must already be
+ * in rdata_crc; see XLogInsert.
+ */
+static void
+XLogFillRecordHeader(XLogRecord *record, XLogRecPtr PrevRecPtr,
+					 RmgrId rmid, uint8 info, uint32 len, uint32 write_len,
+					 pg_crc32 rdata_crc)
+{
+	record->xl_prev = PrevRecPtr;
+	record->xl_xid = GetCurrentTransactionIdIfAny();
+	record->xl_tot_len = SizeOfXLogRecord + write_len;
+	record->xl_len = len;		/* doesn't include backup blocks */
+	record->xl_info = info;
+	record->xl_rmid = rmid;
+
+	/* Now we can finish computing the record's CRC */
+	COMP_CRC32(rdata_crc, (char *) record + sizeof(pg_crc32),
+			   SizeOfXLogRecord - sizeof(pg_crc32));
+	FIN_CRC32(rdata_crc);
+	record->xl_crc = rdata_crc;
+}
+
+/*
+ * Copy a record's data, including backup blocks if any, from the rdata
+ * chain into the WAL buffer space that XLogInsert reserved for it.
+ */
+static void
+XLogCopyRecordData(XLogRecData *rdata, XLogInsertSegment *segs, int nsegs)
+{
+	int			i;
+
+	for (i = 0; i < nsegs; i++)
+	{
+		char	   *dest = segs[i].dest;
+		uint32		left = segs[i].len;
+
+		while (left > 0)
+		{
+			while (rdata->data == NULL)
+				rdata = rdata->next;
+
+			if (rdata->len > left)
+			{
+				memcpy(dest, rdata->data, left);
+				rdata->data += left;
+				rdata->len -= left;
+				left = 0;
+			}
+			else
+			{
+				memcpy(dest, rdata->data, rdata->len);
+				dest += rdata->len;
+				left -= rdata->len;
+				rdata = rdata->next;
+			}
+		}
+	}
+}
+
+/*
+ * Wait for any in-progress insertions into WAL below upto to finish copying
+ * their data, so that everything before upto is safe to write out.
+ *
+ * Insertions that started after we learned of upto can't start below it, so
+ * a single pass over the slots is enough.  We never acquire a slot's lock,
+ * only wait for its insertingAt value to move on (see the comments at the
+ * top of the file), so this is safe to call while holding WALWriteLock and
+ * WALInsertLock.
+ */
+static void
+WaitXLogInsertionsToFinish(XLogRecPtr upto)
+{
+	uint64		uptoPos = XLogRecPtrToSlotPos(upto);
+	int			i;
+
+	for (i = 0; i < NUM_XLOGINSERT_SLOTS; i++)
+	{
+		uint64		insertingAt = ~((uint64) 0);
+
+		/*
+		 * The initial oldval matches no real position, so the first call
+		 * returns the current value without sleeping (or true if the slot
+		 * isn't held at all).  A holder that hasn't advertised anything isn't
+		 * copying, and must not be waited for.  Otherwise we sleep until the
+		 * value changes or the slot is released.
+		 */
+		do
+		{
+			if (LWLockWaitForVar(XLogInsertSlotLock(i),
+								 &XLogCtl->insertSlots[i].insertingAt,
+								 insertingAt, &insertingAt))
+				break;			/* slot is free, so no copy in progress */
+		} while (insertingAt != 0 && insertingAt < uptoPos);
+	}
+}
+
 /*
  * Determine whether the buffer referenced by an XLogRecData item has to
  * be backed up, and if so fill a BkpBlock struct for it.  In any case
@@ -1575,6 +1907,13 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible, bool xlog_switch)
 	 */
 	LogwrtResult = Write->LogwrtResult;
 
+	/*
+	 * Records below the write request may still be being copied into the
+	 * buffers; wait for them to finish before writing anything out.
+	 */
+	if (XLByteLT(LogwrtResult.Write, WriteRqst.Write))
+		WaitXLogInsertionsToFinish(WriteRqst.Write);
+
 	/*
 	 * Since successive pages in the xlog cache are consecutively allocated,
 	 * we can usually gather multiple pages together and issue just one
@@ -4654,6 +4993,7 @@ XLOGShmemInit(void)
 	bool		foundCFile,
 				foundXLog;
 	char	   *allocptr;
+	int			i;
 
 	ControlFile = (ControlFileData *)
 		ShmemInitStruct("Control File", sizeof(ControlFileData), &foundCFile);
@@ -4694,6 +5034,8 @@ XLOGShmemInit(void)
 	XLogCtl->SharedRecoveryInProgress = true;
 	XLogCtl->Insert.currpage = (XLogPageHeader) (XLogCtl->pages);
 	SpinLockInit(&XLogCtl->info_lck);
+	for (i = 0; i < NUM_XLOGINSERT_SLOTS; i++)
+		XLogCtl->insertSlots[i].insertingAt = 0;
 
 	/*
 	 * If we are not in bootstrap mode, pg_control should already exist. Read
@@ -7644,21 +7986,48 @@ xlog_outrec(StringInfo buf, XLogRecord *record)
 
 	appendStringInfo(buf, ": %s", RmgrTable[record->xl_rmid].rm_name);
 }
+
+static void
+xlog_outinsert(XLogRecPtr RecPtr, XLogRecord *record, XLogRecData *rdata)
+{
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "INSERT @ %X/%X: ",
+					 RecPtr.xlogid, RecPtr.xrecoff);
+	xlog_outrec(&buf, record);
+	if (rdata->data != NULL)
+	{
+		appendStringInfo(&buf, " - ");
+		RmgrTable[record->xl_rmid].rm_desc(&buf, record->xl_info, rdata->data);
+	}
+	elog(LOG, "%s", buf.data);
+	pfree(buf.data);
+}
 #endif   /* WAL_DEBUG */
 
 
 /*
  * Return the (possible) sync flag used for opening a file, depending on the
- * value of the GUC wal_sync_method.
+ * value of the GUC wal_sync_method, plus O_DIRECT if direct_io asks for it.
  */
 static int
 get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
+	int			forced_direct_flag = 0;
+
+	/*
+	 * If direct_io includes WAL, bypass the kernel cache whatever the sync
+	 * method, even if archiving or streaming will then have to read the WAL
+	 * back from disk.  Not in walreceiver, though; see below.
+	 */
+	if ((direct_io & DIRECT_IO_WAL) && !am_walreceiver)
+		forced_direct_flag = o_direct_flag = PG_O_DIRECT;
 
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return forced_direct_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -7688,7 +8057,7 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return forced_direct_flag;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
 			return OPEN_SYNC_FLAG | o_direct_flag;
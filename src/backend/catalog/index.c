@@ -28,6 +28,7 @@
 #include "access/relscan.h"
 #include "access/sysattr.h"
 #include "access/transam.h"
+#include "access/visibilitymap.h"
 #include "access/xact.h"
 #include "bootstrap/bootstrap.h"
 #include "catalog/catalog.h"
@@ -1224,7 +1225,8 @@ FormIndexDatum(IndexInfo *indexInfo,
  *		else no change
  * reltuples: set reltuples to this value
  *
- * relpages is also updated (using RelationGetNumberOfBlocks()).
+ * relpages is also updated (using RelationGetNumberOfBlocks()), and so is
+ * relallvisible for a heap (using visibilitymap_count()).
  *
  * NOTE: an important side-effect of this operation is that an SI invalidation
  * message is sent out to all backends --- including me --- causing relcache
@@ -1240,6 +1242,7 @@ index_update_stats(Relation rel,
 				   Oid reltoastidxid, double reltuples)
 {
 	BlockNumber relpages = RelationGetNumberOfBlocks(rel);
+	BlockNumber relallvisible;
 	Oid			relid = RelationGetRelid(rel);
 	Relation	pg_class;
 	HeapTuple	tuple;
@@ -1280,6 +1283,11 @@ index_update_stats(Relation rel,
 	 * old values) regardless.
 	 */
 
+	if (rel->rd_rel->relkind != RELKIND_INDEX)
+		relallvisible = Min(visibilitymap_count(rel, NULL), relpages);
+	else
+		relallvisible = 0;
+
 	pg_class = heap_open(RelationRelationId, RowExclusiveLock);
 
 	/*
@@ -1357,6 +1365,11 @@ index_update_stats(Relation rel,
 		rd_rel->relpages = (int32) relpages;
 		dirty = true;
 	}
+	if (rd_rel->relallvisible != (int32) relallvisible)
+	{
+		rd_rel->relallvisible = (int32) relallvisible;
+		dirty = true;
+	}
 
 	/*
 	 * If anything changed, write out the tuple
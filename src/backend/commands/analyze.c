@@ -20,6 +20,7 @@
 #include "access/transam.h"
 #include "access/tupconvert.h"
 #include "access/tuptoaster.h"
+#include "access/visibilitymap.h"
 #include "access/xact.h"
 #include "catalog/index.h"
 #include "catalog/indexing.h"
@@ -551,9 +552,15 @@ do_analyze_rel(Relation onerel, VacuumStmt *vacstmt,
 	 * that got a more precise number.
 	 */
 	if (update_reltuples)
+	{
+		BlockNumber relpages = RelationGetNumberOfBlocks(onerel);
+		BlockNumber relallvisible = visibilitymap_count(onerel, NULL);
+
 		vac_update_relstats(onerel,
-							RelationGetNumberOfBlocks(onerel),
-							totalrows, hasindex, InvalidTransactionId);
+							relpages, totalrows,
+							Min(relallvisible, relpages),
+							hasindex, InvalidTransactionId);
+	}
 
 	/*
 	 * Same for indexes. Vacuum always scans all indexes, so if we're part of
@@ -570,7 +577,8 @@ do_analyze_rel(Relation onerel, VacuumStmt *vacstmt,
 			totalindexrows = ceil(thisdata->tupleFract * totalrows);
 			vac_update_relstats(Irel[ind],
 								RelationGetNumberOfBlocks(Irel[ind]),
-								totalindexrows, false, InvalidTransactionId);
+								totalindexrows, 0,
+								false, InvalidTransactionId);
 		}
 	}
 
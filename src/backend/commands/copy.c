@@ -19,6 +19,9 @@
 #include <sys/stat.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "access/heapam.h"
 #include "access/xact.h"
@@ -32,6 +35,7 @@
 #include "libpq/pqformat.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/clauses.h"
 #include "optimizer/planner.h"
 #include "parser/parse_relation.h"
 #include "rewrite/rewriteHandler.h"
@@ -149,6 +153,7 @@ typedef struct CopyStateData
 	 */
 	StringInfoData line_buf;
 	bool		line_buf_converted;		/* converted to server encoding? */
+	bool		line_buf_valid; /* contains the row being processed? */
 
 	/*
 	 * Finally, raw_buf holds raw data read from the data source (file or
@@ -247,6 +252,12 @@ static void CopyTo(CopyState cstate);
 static void CopyOneRowTo(CopyState cstate, Oid tupleOid,
 			 Datum *values, bool *nulls);
 static void CopyFrom(CopyState cstate);
+static void CopyFromInsertBatch(CopyState cstate, EState *estate,
+					CommandId mycid, int hi_options,
+					ResultRelInfo *resultRelInfo, TupleTableSlot *myslot,
+					BulkInsertState bistate,
+					int nBufferedTuples, HeapTuple *bufferedTuples,
+					int firstBufferedLineNo);
 static bool CopyReadLine(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
 static int CopyReadAttributesText(CopyState cstate, int maxfields,
@@ -1164,6 +1175,7 @@ DoCopy(const CopyStmt *stmt, const char *queryString)
 	initStringInfo(&cstate->attribute_buf);
 	initStringInfo(&cstate->line_buf);
 	cstate->line_buf_converted = false;
+	cstate->line_buf_valid = false;
 	cstate->raw_buf = (char *) palloc(RAW_BUF_SIZE + 1);
 	cstate->raw_buf_index = cstate->raw_buf_len = 0;
 	cstate->processed = 0;
@@ -1598,8 +1610,18 @@ copy_in_error_callback(void *arg)
 		}
 		else
 		{
-			/* error is relevant to a particular line */
-			if (cstate->line_buf_converted || !cstate->need_transcoding)
+			/*
+			 * Error is relevant to a particular line.
+			 *
+			 * If line_buf still contains the correct line, and it's already
+			 * transcoded, print it.  If it's still in a foreign encoding, it's
+			 * quite likely that the error is precisely a failure to do
+			 * encoding conversion (ie, bad data).  We dare not try to convert
+			 * it, and at present there's no way to regurgitate it without
+			 * conversion.  So we have to punt and just report the line number.
+			 */
+			if (cstate->line_buf_valid &&
+				(cstate->line_buf_converted || !cstate->need_transcoding))
 			{
 				char	   *lineval;
 
@@ -1610,14 +1632,6 @@ copy_in_error_callback(void *arg)
 			}
 			else
 			{
-				/*
-				 * Here, the line buffer is still in a foreign encoding, and
-				 * indeed it's quite likely that the error is precisely a
-				 * failure to do encoding conversion (ie, bad data).  We dare
-				 * not try to convert it, and at present there's no way to
-				 * regurgitate it without conversion.  So we have to punt and
-				 * just report the line number.
-				 */
 				errcontext("COPY %s, line %d",
 						   cstate->cur_relname, cstate->cur_lineno);
 			}
@@ -1698,6 +1712,14 @@ CopyFrom(CopyState cstate)
 	CommandId	mycid = GetCurrentCommandId(true);
 	int			hi_options = 0; /* start with default heap_insert options */
 	BulkInsertState bistate;
+	bool		volatile_defexprs = false;
+	bool		useHeapMultiInsert;
+	int			nBufferedTuples = 0;
+
+#define MAX_BUFFERED_TUPLES 1000
+	HeapTuple  *bufferedTuples = NULL;	/* initialize to silence warning */
+	Size		bufferedTuplesSize = 0;
+	int			firstBufferedLineNo = 0;
 
 	Assert(cstate->rel);
 
@@ -1856,10 +1878,34 @@ CopyFrom(CopyState cstate)
 														 estate);
 				defmap[num_defaults] = attnum - 1;
 				num_defaults++;
+
+				if (!volatile_defexprs)
+					volatile_defexprs = contain_volatile_functions(defexpr);
 			}
 		}
 	}
 
+	/*
+	 * It's more efficient to prepare a bunch of tuples for insertion, and
+	 * insert them in one heap_multi_insert() call, than call heap_insert()
+	 * separately for every tuple.  However, we can't do that if there are
+	 * BEFORE ROW triggers, or we need to evaluate volatile default
+	 * expressions.  Such triggers or expressions might query the table we're
+	 * inserting to, and act differently if the tuples that have already been
+	 * processed and prepared for insertion are not there.
+	 */
+	if ((resultRelInfo->ri_TrigDesc != NULL &&
+	  resultRelInfo->ri_TrigDesc->n_before_row[TRIGGER_EVENT_INSERT] > 0) ||
+		volatile_defexprs)
+	{
+		useHeapMultiInsert = false;
+	}
+	else
+	{
+		useHeapMultiInsert = true;
+		bufferedTuples = palloc(MAX_BUFFERED_TUPLES * sizeof(HeapTuple));
+	}
+
 	/* Prepare to catch AFTER triggers. */
 	AfterTriggerBeginQuery();
 
@@ -1958,8 +2004,12 @@ CopyFrom(CopyState cstate)
 
 		cstate->cur_lineno++;
 
-		/* Reset the per-tuple exprcontext */
-		ResetPerTupleExprContext(estate);
+		/*
+		 * Reset the per-tuple exprcontext.  We can only do this if the tuple
+		 * buffer is empty, because the buffered tuples live in it.
+		 */
+		if (nBufferedTuples == 0)
+			ResetPerTupleExprContext(estate);
 
 		/* Switch into its memory context */
 		MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
@@ -2150,8 +2200,6 @@ CopyFrom(CopyState cstate)
 
 		if (!skip_tuple)
 		{
-			List	   *recheckIndexes = NIL;
-
 			/* Place tuple in tuple slot */
 			ExecStoreTuple(tuple, slot, InvalidBuffer, false);
 
@@ -2159,18 +2207,49 @@ CopyFrom(CopyState cstate)
 			if (cstate->rel->rd_att->constr)
 				ExecConstraints(resultRelInfo, slot, estate);
 
-			/* OK, store the tuple and create index entries for it */
-			heap_insert(cstate->rel, tuple, mycid, hi_options, bistate);
+			if (useHeapMultiInsert)
+			{
+				/* Add this tuple to the tuple buffer */
+				if (nBufferedTuples == 0)
+					firstBufferedLineNo = cstate->cur_lineno;
+				bufferedTuples[nBufferedTuples++] = tuple;
+				bufferedTuplesSize += tuple->t_len;
 
-			if (resultRelInfo->ri_NumIndices > 0)
-				recheckIndexes = ExecInsertIndexTuples(slot, &(tuple->t_self),
-													   estate);
+				/*
+				 * If the buffer filled up, flush it.  Also flush if the total
+				 * size of all the tuples in the buffer becomes large, to
+				 * avoid using large amounts of memory for the buffers when
+				 * the tuples are exceptionally wide.
+				 */
+				if (nBufferedTuples == MAX_BUFFERED_TUPLES ||
+					bufferedTuplesSize > 65535)
+				{
+					CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+										resultRelInfo, slot, bistate,
+										nBufferedTuples, bufferedTuples,
+										firstBufferedLineNo);
+					nBufferedTuples = 0;
+					bufferedTuplesSize = 0;
+				}
+			}
+			else
+			{
+				List	   *recheckIndexes = NIL;
 
-			/* AFTER ROW INSERT Triggers */
-			ExecARInsertTriggers(estate, resultRelInfo, tuple,
-								 recheckIndexes);
+				/* OK, store the tuple and create index entries for it */
+				heap_insert(cstate->rel, tuple, mycid, hi_options, bistate);
 
-			list_free(recheckIndexes);
+				if (resultRelInfo->ri_NumIndices > 0)
+					recheckIndexes = ExecInsertIndexTuples(slot,
+														   &(tuple->t_self),
+														   estate);
+
+				/* AFTER ROW INSERT Triggers */
+				ExecARInsertTriggers(estate, resultRelInfo, tuple,
+									 recheckIndexes);
+
+				list_free(recheckIndexes);
+			}
 
 			/*
 			 * We count only tuples not suppressed by a BEFORE INSERT trigger;
@@ -2181,6 +2260,13 @@ CopyFrom(CopyState cstate)
 		}
 	}
 
+	/* Flush any remaining buffered tuples */
+	if (nBufferedTuples > 0)
+		CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+							resultRelInfo, slot, bistate,
+							nBufferedTuples, bufferedTuples,
+							firstBufferedLineNo);
+
 	/* Done, clean up */
 	error_context_stack = errcontext.previous;
 
@@ -2202,6 +2288,8 @@ CopyFrom(CopyState cstate)
 	pfree(typioparams);
 	pfree(defmap);
 	pfree(defexprs);
+	if (bufferedTuples)
+		pfree(bufferedTuples);
 
 	ExecResetTupleTable(estate->es_tupleTable, false);
 
@@ -2233,6 +2321,83 @@ CopyFrom(CopyState cstate)
 	}
 }
 
+/*
+ * A subroutine of CopyFrom, to write the current batch of buffered heap
+ * tuples to the heap.  Also updates indexes and runs AFTER ROW INSERT
+ * triggers.
+ */
+static void
+CopyFromInsertBatch(CopyState cstate, EState *estate, CommandId mycid,
+					int hi_options, ResultRelInfo *resultRelInfo,
+					TupleTableSlot *myslot, BulkInsertState bistate,
+					int nBufferedTuples, HeapTuple *bufferedTuples,
+					int firstBufferedLineNo)
+{
+	MemoryContext oldcontext;
+	int			i;
+	int			save_cur_lineno;
+
+	/*
+	 * Print error context information correctly, if one of the operations
+	 * below fail.
+	 */
+	cstate->line_buf_valid = false;
+	save_cur_lineno = cstate->cur_lineno;
+
+	/*
+	 * heap_multi_insert leaks memory, so switch to short-lived memory context
+	 * before calling it.
+	 */
+	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	heap_multi_insert(cstate->rel,
+					  bufferedTuples,
+					  nBufferedTuples,
+					  mycid,
+					  hi_options,
+					  bistate);
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * If there are any indexes, update them for all the inserted tuples, and
+	 * run AFTER ROW INSERT triggers.
+	 */
+	if (resultRelInfo->ri_NumIndices > 0)
+	{
+		for (i = 0; i < nBufferedTuples; i++)
+		{
+			List	   *recheckIndexes;
+
+			cstate->cur_lineno = firstBufferedLineNo + i;
+			ExecStoreTuple(bufferedTuples[i], myslot, InvalidBuffer, false);
+			recheckIndexes =
+				ExecInsertIndexTuples(myslot, &(bufferedTuples[i]->t_self),
+									  estate);
+			ExecARInsertTriggers(estate, resultRelInfo,
+								 bufferedTuples[i],
+								 recheckIndexes);
+			list_free(recheckIndexes);
+		}
+	}
+
+	/*
+	 * There's no indexes, but see if we need to run AFTER ROW INSERT triggers
+	 * anyway.
+	 */
+	else if (resultRelInfo->ri_TrigDesc != NULL &&
+			 resultRelInfo->ri_TrigDesc->n_after_row[TRIGGER_EVENT_INSERT] > 0)
+	{
+		for (i = 0; i < nBufferedTuples; i++)
+		{
+			cstate->cur_lineno = firstBufferedLineNo + i;
+			ExecARInsertTriggers(estate, resultRelInfo,
+								 bufferedTuples[i],
+								 NIL);
+		}
+	}
+
+	/* reset cur_lineno to where we were */
+	cstate->cur_lineno = save_cur_lineno;
+}
 
 /*
  * Read the next input line and stash it in line_buf, with conversion to
@@ -2248,6 +2413,7 @@ CopyReadLine(CopyState cstate)
 	bool		result;
 
 	resetStringInfo(&cstate->line_buf);
+	cstate->line_buf_valid = true;
 
 	/* Mark that encoding conversion hasn't occurred yet */
 	cstate->line_buf_converted = false;
@@ -2326,6 +2492,78 @@ CopyReadLine(CopyState cstate)
 	return result;
 }
 
+/*
+ * CopyScanPlainBytes - find the first "interesting" byte in a string
+ *
+ * Returns the length of the longest prefix of s[0..len-1] that contains
+ * none of the bytes c1, c2, c3 and c4.  Callers pass the same byte more than
+ * once if they have fewer than four to look for.
+ *
+ * The line and field splitting loops use this to hop over runs of ordinary
+ * data, and fall back to their byte-at-a-time logic at the first byte that
+ * needs attention.  Where SSE2 is available (which includes every x86-64
+ * machine) we test 16 bytes per step; elsewhere we test 8 bytes per step
+ * using the usual has-zero-byte trick on a 64-bit word.  Either way the
+ * tail is finished one byte at a time, and nothing beyond s[len-1] is read.
+ */
+static inline int
+CopyScanPlainBytes(const char *s, int len, char c1, char c2, char c3, char c4)
+{
+	int			i = 0;
+
+#ifdef __SSE2__
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+	const __m128i v3 = _mm_set1_epi8(c3);
+	const __m128i v4 = _mm_set1_epi8(c4);
+
+	for (; i + (int) sizeof(__m128i) <= len; i += sizeof(__m128i))
+	{
+		__m128i		chunk = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i		hits;
+
+		hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1),
+										 _mm_cmpeq_epi8(chunk, v2)),
+							_mm_or_si128(_mm_cmpeq_epi8(chunk, v3),
+										 _mm_cmpeq_epi8(chunk, v4)));
+		if (_mm_movemask_epi8(hits) != 0)
+			break;
+	}
+#else
+#define ONES_64		UINT64CONST(0x0101010101010101)
+#define HIGHS_64	UINT64CONST(0x8080808080808080)
+#define HAS_ZERO_BYTE(w)	(((w) - ONES_64) & ~(w) & HIGHS_64)
+	const uint64 p1 = ONES_64 * (unsigned char) c1;
+	const uint64 p2 = ONES_64 * (unsigned char) c2;
+	const uint64 p3 = ONES_64 * (unsigned char) c3;
+	const uint64 p4 = ONES_64 * (unsigned char) c4;
+
+	for (; i + (int) sizeof(uint64) <= len; i += sizeof(uint64))
+	{
+		uint64		w;
+
+		memcpy(&w, s + i, sizeof(uint64));
+		if (HAS_ZERO_BYTE(w ^ p1) | HAS_ZERO_BYTE(w ^ p2) |
+			HAS_ZERO_BYTE(w ^ p3) | HAS_ZERO_BYTE(w ^ p4))
+			break;
+	}
+#undef HAS_ZERO_BYTE
+#undef HIGHS_64
+#undef ONES_64
+#endif
+
+	/* Locate the exact position within the last block, or finish the tail */
+	for (; i < len; i++)
+	{
+		char		c = s[i];
+
+		if (c == c1 || c == c2 || c == c3 || c == c4)
+			break;
+	}
+
+	return i;
+}
+
 /*
  * CopyReadLineText - inner loop of CopyReadLine for text mode
  */
@@ -2347,6 +2585,10 @@ CopyReadLineText(CopyState cstate)
 	char		quotec = '\0';
 	char		escapec = '\0';
 
+	/* bytes the fast-skip step must stop at, besides \r and \n */
+	char		scanc1;
+	char		scanc2;
+
 	if (cstate->csv_mode)
 	{
 		quotec = cstate->quote[0];
@@ -2354,7 +2596,11 @@ CopyReadLineText(CopyState cstate)
 		/* ignore special escape processing if it's the same as quotec */
 		if (quotec == escapec)
 			escapec = '\0';
+		scanc1 = quotec;
+		scanc2 = escapec ? escapec : quotec;
 	}
+	else
+		scanc1 = scanc2 = '\\';
 
 	mblen_str[1] = '\0';
 
@@ -2423,6 +2669,32 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip quickly over a run of bytes that can't end the line or change
+		 * the quoting state.  That's everything except \r, \n, and backslash
+		 * or the CSV quote and escape characters.  We can only do this if
+		 * the client encoding never embeds ASCII bytes in multibyte
+		 * characters, since otherwise we must step through it character by
+		 * character; and the first character of a line is left to the code
+		 * below, because of the \. end-of-copy check in CSV mode.
+		 */
+		if (!cstate->encoding_embeds_ascii && !first_char_in_line)
+		{
+			int			nplain;
+
+			nplain = CopyScanPlainBytes(copy_raw_buf + raw_buf_ptr,
+										copy_buf_len - raw_buf_ptr,
+										'\n', '\r', scanc1, scanc2);
+			if (nplain > 0)
+			{
+				raw_buf_ptr += nplain;
+				/* none of the skipped bytes was the escape character */
+				last_was_esc = false;
+				if (raw_buf_ptr >= copy_buf_len)
+					continue;
+			}
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -2778,6 +3050,17 @@ CopyReadAttributesText(CopyState cstate, int maxfields, char **fieldvals)
 		for (;;)
 		{
 			char		c;
+			int			nplain;
+
+			/* Copy any run of bytes that need no de-escaping in one go */
+			nplain = CopyScanPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+										delimc, '\\', '\\', '\\');
+			if (nplain > 0)
+			{
+				memcpy(output_ptr, cur_ptr, nplain);
+				output_ptr += nplain;
+				cur_ptr += nplain;
+			}
 
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
@@ -3003,6 +3286,17 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 			/* Not in quote */
 			for (;;)
 			{
+				int			nplain;
+
+				nplain = CopyScanPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+											delimc, quotec, quotec, quotec);
+				if (nplain > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nplain);
+					output_ptr += nplain;
+					cur_ptr += nplain;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -3026,6 +3320,17 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 			/* In quote */
 			for (;;)
 			{
+				int			nplain;
+
+				nplain = CopyScanPlainBytes(cur_ptr, line_end_ptr - cur_ptr,
+											escapec, quotec, quotec, quotec);
+				if (nplain > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nplain);
+					output_ptr += nplain;
+					cur_ptr += nplain;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -66,9 +66,13 @@ static void show_scan_qual(List *qual, const char *qlabel,
 			   ExplainState *es);
 static void show_upper_qual(List *qual, const char *qlabel, Plan *plan,
 				ExplainState *es);
-static void show_sort_keys(Plan *sortplan, ExplainState *es);
+static void show_sort_keys(Plan *sortplan, int nkeys, const char *qlabel,
+			   ExplainState *es);
 static void show_sort_info(SortState *sortstate, ExplainState *es);
+static void show_incremental_sort_info(IncrementalSortState *incrsortstate,
+						   ExplainState *es);
 static void show_hash_info(HashState *hashstate, ExplainState *es);
+static void show_agg_info(AggState *aggstate, ExplainState *es);
 static const char *explain_get_index_name(Oid indexId);
 static void ExplainScanTarget(Scan *plan, ExplainState *es);
 static void ExplainMemberNodes(List *plans, PlanState **planstate,
@@ -669,7 +673,10 @@ ExplainNode(Plan *plan, PlanState *planstate,
 			pname = sname = "Seq Scan";
 			break;
 		case T_IndexScan:
-			pname = sname = "Index Scan";
+			if (((IndexScan *) plan)->indexonly)
+				pname = sname = "Index Only Scan";
+			else
+				pname = sname = "Index Scan";
 			break;
 		case T_BitmapIndexScan:
 			pname = sname = "Bitmap Index Scan";
@@ -701,6 +708,9 @@ ExplainNode(Plan *plan, PlanState *planstate,
 		case T_Sort:
 			pname = sname = "Sort";
 			break;
+		case T_IncrementalSort:
+			pname = sname = "Incremental Sort";
+			break;
 		case T_Group:
 			pname = sname = "Group";
 			break;
@@ -1008,6 +1018,9 @@ ExplainNode(Plan *plan, PlanState *planstate,
 			show_scan_qual(((IndexScan *) plan)->indexqualorig,
 						   "Index Cond", plan, outer_plan, es);
 			show_scan_qual(plan->qual, "Filter", plan, outer_plan, es);
+			if (((IndexScan *) plan)->indexonly && es->analyze)
+				ExplainPropertyLong("Heap Fetches",
+						((IndexScanState *) planstate)->iss_HeapFetches, es);
 			break;
 		case T_BitmapIndexScan:
 			show_scan_qual(((BitmapIndexScan *) plan)->indexqualorig,
@@ -1059,13 +1072,22 @@ ExplainNode(Plan *plan, PlanState *planstate,
 			show_upper_qual(plan->qual, "Filter", plan, es);
 			break;
 		case T_Agg:
+			show_upper_qual(plan->qual, "Filter", plan, es);
+			show_agg_info((AggState *) planstate, es);
+			break;
 		case T_Group:
 			show_upper_qual(plan->qual, "Filter", plan, es);
 			break;
 		case T_Sort:
-			show_sort_keys(plan, es);
+			show_sort_keys(plan, ((Sort *) plan)->numCols, "Sort Key", es);
 			show_sort_info((SortState *) planstate, es);
 			break;
+		case T_IncrementalSort:
+			show_sort_keys(plan, ((Sort *) plan)->numCols, "Sort Key", es);
+			show_sort_keys(plan, ((IncrementalSort *) plan)->presortedCols,
+						   "Presorted Key", es);
+			show_incremental_sort_info((IncrementalSortState *) planstate, es);
+			break;
 		case T_Result:
 			show_upper_qual((List *) ((Result *) plan)->resconstantqual,
 							"One-Time Filter", plan, es);
@@ -1354,12 +1376,12 @@ show_upper_qual(List *qual, const char *qlabel, Plan *plan, ExplainState *es)
 }
 
 /*
- * Show the sort keys for a Sort node.
+ * Show the first nkeys sort keys of a Sort or IncrementalSort node.
  */
 static void
-show_sort_keys(Plan *sortplan, ExplainState *es)
+show_sort_keys(Plan *sortplan, int nkeys, const char *qlabel,
+			   ExplainState *es)
 {
-	int			nkeys = ((Sort *) sortplan)->numCols;
 	AttrNumber *keycols = ((Sort *) sortplan)->sortColIdx;
 	List	   *context;
 	List	   *result = NIL;
@@ -1391,7 +1413,7 @@ show_sort_keys(Plan *sortplan, ExplainState *es)
 		result = lappend(result, exprstr);
 	}
 
-	ExplainPropertyList("Sort Key", result, es);
+	ExplainPropertyList(qlabel, result, es);
 }
 
 /*
@@ -1426,6 +1448,19 @@ show_sort_info(SortState *sortstate, ExplainState *es)
 	}
 }
 
+/*
+ * If it's EXPLAIN ANALYZE, show the number of groups an incremental sort
+ * node has sorted
+ */
+static void
+show_incremental_sort_info(IncrementalSortState *incrsortstate,
+						   ExplainState *es)
+{
+	Assert(IsA(incrsortstate, IncrementalSortState));
+	if (es->analyze)
+		ExplainPropertyLong("Sort Groups", incrsortstate->groups_sorted, es);
+}
+
 /*
  * Show information on hash buckets/batches.
  */
@@ -1468,6 +1503,33 @@ show_hash_info(HashState *hashstate, ExplainState *es)
 	}
 }
 
+/*
+ * If it's EXPLAIN ANALYZE, show how many times a hashed aggregate filled
+ * its hash table, and how deeply it had to repartition spilled groups.
+ */
+static void
+show_agg_info(AggState *aggstate, ExplainState *es)
+{
+	Agg		   *plan = (Agg *) aggstate->ss.ps.plan;
+
+	if (!es->analyze || plan->aggstrategy != AGG_HASHED ||
+		aggstate->hash_batches_used == 0)
+		return;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyLong("Hash Batches", aggstate->hash_batches_used, es);
+		ExplainPropertyLong("Spill Levels", aggstate->hash_spill_levels, es);
+	}
+	else
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "Batches: %d  Spill Levels: %d\n",
+						 aggstate->hash_batches_used,
+						 aggstate->hash_spill_levels);
+	}
+}
+
 /*
  * Fetch the name of an index in an EXPLAIN
  *
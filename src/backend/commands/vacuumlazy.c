@@ -84,6 +84,7 @@ typedef struct LVRelStats
 	/* hasindex = true means two-pass strategy; false means one-pass */
 	bool		hasindex;
 	bool		scanned_all;	/* have we scanned all pages (this far)? */
+	bool		scanned_all_unfrozen;	/* ... all pages not marked all-frozen? */
 	/* Overall statistics about rel */
 	BlockNumber rel_pages;
 	double		old_rel_tuples; /* previous value of pg_class.reltuples */
@@ -100,6 +101,24 @@ typedef struct LVRelStats
 	TransactionId latestRemovedXid;
 } LVRelStats;
 
+/*
+ * State for prefetching the heap pages that lazy_scan_heap or
+ * lazy_vacuum_heap is about to read (see ReadAheadState).
+ */
+typedef struct LVReadAhead
+{
+	Relation	onerel;
+	/* for lazy_scan_heap */
+	bool		scan_all;		/* skipping only all-frozen pages? */
+	BlockNumber next_block;		/* next heap block to consider */
+	BlockNumber nblocks;		/* # of heap blocks being scanned */
+	Buffer		vmbuffer;		/* visibility map page, if pinned */
+	/* for lazy_vacuum_heap */
+	LVRelStats *vacrelstats;
+	int			next_tupindex;	/* next dead tuple to consider */
+	BlockNumber last_block;		/* heap block last returned */
+} LVReadAhead;
+
 
 /* A few variables that don't seem worth passing around as parameters */
 static int	elevel = -1;
@@ -109,6 +128,8 @@ static TransactionId FreezeLimit;
 
 static BufferAccessStrategy vac_strategy;
 
+static const XLogRecPtr InvalidXLogRecPtr = {0, 0};
+
 
 /* non-export function prototypes */
 static void lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
@@ -130,6 +151,8 @@ static void lazy_record_dead_tuple(LVRelStats *vacrelstats,
 					   ItemPointer itemptr);
 static bool lazy_tid_reaped(ItemPointer itemptr, void *state);
 static int	vac_cmp_itemptr(const void *left, const void *right);
+static BlockNumber lazy_scan_readahead_next(void *arg);
+static BlockNumber lazy_vacuum_readahead_next(void *arg);
 
 
 /*
@@ -149,6 +172,7 @@ lazy_vacuum_rel(Relation onerel, VacuumStmt *vacstmt,
 	Relation   *Irel;
 	int			nindexes;
 	BlockNumber possibly_freeable;
+	BlockNumber new_rel_allvisible;
 	PGRUsage	ru0;
 	TimestampTz starttime = 0;
 	bool		scan_all;
@@ -176,6 +200,7 @@ lazy_vacuum_rel(Relation onerel, VacuumStmt *vacstmt,
 	vacrelstats = (LVRelStats *) palloc0(sizeof(LVRelStats));
 
 	vacrelstats->scanned_all = true;	/* will be cleared if we skip a page */
+	vacrelstats->scanned_all_unfrozen = true;
 	vacrelstats->old_rel_tuples = onerel->rd_rel->reltuples;
 	vacrelstats->num_index_scans = 0;
 
@@ -211,12 +236,33 @@ lazy_vacuum_rel(Relation onerel, VacuumStmt *vacstmt,
 	 * accurate in any case, but because we use the reltuples / relpages ratio
 	 * in the planner, it's better to not update relpages either if we can't
 	 * update reltuples.
+	 *
+	 * If the only pages we skipped were marked all-frozen, there's nothing
+	 * in them to freeze, so we can still advance relfrozenxid; we just leave
+	 * relpages and reltuples alone.
+	 *
+	 * The all-visible page count comes straight from the visibility map, so
+	 * it is accurate however many pages we skipped; we store it even when
+	 * the other counts have to be left alone, since tables whose pages are
+	 * mostly skipped are just the ones index-only scans pay off for.  It's
+	 * clamped to relpages because the planner uses it as a fraction of that.
 	 */
+	new_rel_allvisible = visibilitymap_count(onerel, NULL);
 	if (vacrelstats->scanned_all)
 		vac_update_relstats(onerel,
 							vacrelstats->rel_pages, vacrelstats->rel_tuples,
+							Min(new_rel_allvisible, vacrelstats->rel_pages),
 							vacrelstats->hasindex,
 							FreezeLimit);
+	else
+		vac_update_relstats(onerel,
+							onerel->rd_rel->relpages,
+							onerel->rd_rel->reltuples,
+							Min(new_rel_allvisible,
+								(BlockNumber) onerel->rd_rel->relpages),
+							vacrelstats->hasindex,
+							vacrelstats->scanned_all_unfrozen ?
+							FreezeLimit : InvalidTransactionId);
 
 	/* report results to the stats collector, too */
 	pgstat_report_vacuum(RelationGetRelid(onerel),
@@ -308,6 +354,8 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
 	BlockNumber all_visible_streak;
+	LVReadAhead lvra;
+	ReadAheadState readahead;
 
 	pg_rusage_init(&ru0);
 
@@ -330,6 +378,19 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 
 	lazy_space_alloc(vacrelstats, nblocks);
 
+	/*
+	 * Prefetch the pages we will read.  That's the pages not marked as
+	 * skippable in the visibility map; the few skippable pages we read
+	 * anyway because the streak of them is too short aren't prefetched.
+	 */
+	lvra.onerel = onerel;
+	lvra.scan_all = scan_all;
+	lvra.next_block = 0;
+	lvra.nblocks = nblocks;
+	lvra.vmbuffer = InvalidBuffer;
+	ReadAheadInit(&readahead, onerel, MAIN_FORKNUM,
+				  lazy_scan_readahead_next, (void *) &lvra);
+
 	all_visible_streak = 0;
 	for (blkno = 0; blkno < nblocks; blkno++)
 	{
@@ -343,8 +404,19 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		OffsetNumber frozen[MaxOffsetNumber];
 		int			nfrozen;
 		Size		freespace;
-		bool		all_visible_according_to_vm = false;
+		uint8		vmstatus;
+		bool		all_visible_according_to_vm;
+		bool		all_frozen_according_to_vm;
+		bool		skippable;
 		bool		all_visible;
+		bool		all_frozen;
+		TransactionId visibility_cutoff_xid = InvalidTransactionId;
+
+		vmstatus = visibilitymap_get_status(onerel, blkno, &vmbuffer);
+		all_visible_according_to_vm =
+			(vmstatus & VISIBILITYMAP_ALL_VISIBLE) != 0;
+		all_frozen_according_to_vm =
+			(vmstatus & VISIBILITYMAP_ALL_FROZEN) != 0;
 
 		/*
 		 * Skip pages that don't require vacuuming according to the visibility
@@ -353,26 +425,29 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 * sequentially, the OS should be doing readahead for us and there's
 		 * no gain in skipping a page now and then. You need a longer run of
 		 * consecutive skipped pages before it's worthwhile. Also, skipping
-		 * even a single page means that we can't update relfrozenxid or
-		 * reltuples, so we only want to do it if there's a good chance to
-		 * skip a goodly number of pages.
+		 * even a single page means that we can't update reltuples, nor
+		 * relfrozenxid unless the page is all-frozen, so we only want to do
+		 * it if there's a good chance to skip a goodly number of pages.
+		 *
+		 * When we must scan all pages to freeze tuples and advance
+		 * relfrozenxid, only pages marked all-frozen can be skipped, since
+		 * they have no XIDs left that would need freezing.
 		 */
-		if (!scan_all)
+		skippable = scan_all ? all_frozen_according_to_vm :
+			all_visible_according_to_vm;
+		if (skippable)
 		{
-			all_visible_according_to_vm =
-				visibilitymap_test(onerel, blkno, &vmbuffer);
-			if (all_visible_according_to_vm)
+			all_visible_streak++;
+			if (all_visible_streak >= SKIP_PAGES_THRESHOLD)
 			{
-				all_visible_streak++;
-				if (all_visible_streak >= SKIP_PAGES_THRESHOLD)
-				{
-					vacrelstats->scanned_all = false;
-					continue;
-				}
+				vacrelstats->scanned_all = false;
+				if (!all_frozen_according_to_vm)
+					vacrelstats->scanned_all_unfrozen = false;
+				continue;
 			}
-			else
-				all_visible_streak = 0;
 		}
+		else
+			all_visible_streak = 0;
 
 		vacuum_delay_point();
 
@@ -401,8 +476,17 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			vacrelstats->num_index_scans++;
 		}
 
+		/*
+		 * Pin the visibility map page now, before locking the heap page, so
+		 * that we can update the map while still holding the heap page lock
+		 * without risking I/O under it.
+		 */
+		visibilitymap_pin(onerel, blkno, &vmbuffer);
+
 		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, blkno,
 								 RBM_NORMAL, vac_strategy);
+		if (!skippable)
+			ReadAheadAdvance(&readahead);
 
 		/* We need buffer cleanup lock so that we can prune HOT chains. */
 		LockBufferForCleanup(buf);
@@ -462,19 +546,14 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				SetBufferCommitInfoNeedsSave(buf);
 			}
 
-			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-
-			/* Update the visibility map */
-			if (!all_visible_according_to_vm)
-			{
-				visibilitymap_pin(onerel, blkno, &vmbuffer);
-				LockBuffer(buf, BUFFER_LOCK_SHARE);
-				if (PageIsAllVisible(page))
-					visibilitymap_set(onerel, blkno, PageGetLSN(page), &vmbuffer);
-				LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-			}
+			/* Update the visibility map; an empty page is all-frozen, too */
+			if (!all_frozen_according_to_vm)
+				visibilitymap_set(onerel, blkno, InvalidXLogRecPtr,
+								  &vmbuffer, InvalidTransactionId,
+								  VISIBILITYMAP_ALL_VISIBLE |
+								  VISIBILITYMAP_ALL_FROZEN);
 
-			ReleaseBuffer(buf);
+			UnlockReleaseBuffer(buf);
 			RecordPageWithFreeSpace(onerel, blkno, freespace);
 			continue;
 		}
@@ -491,6 +570,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 * requiring freezing.
 		 */
 		all_visible = true;
+		all_frozen = true;
 		nfrozen = 0;
 		hastup = false;
 		prev_dead_count = vacrelstats->num_dead_tuples;
@@ -601,6 +681,11 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 							all_visible = false;
 							break;
 						}
+
+						/* Track newest xmin on page, for the WAL record */
+						if (TransactionIdIsNormal(xmin) &&
+							TransactionIdFollows(xmin, visibility_cutoff_xid))
+							visibility_cutoff_xid = xmin;
 					}
 					break;
 				case HEAPTUPLE_RECENTLY_DEAD:
@@ -644,6 +729,10 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				if (heap_freeze_tuple(tuple.t_data, FreezeLimit,
 									  InvalidBuffer))
 					frozen[nfrozen++] = offnum;
+
+				/* Is the page still all-frozen after that? */
+				if (all_frozen && !heap_tuple_is_frozen(tuple.t_data))
+					all_frozen = false;
 			}
 		}						/* scan along page */
 
@@ -696,28 +785,30 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				 relname, blkno);
 			PageClearAllVisible(page);
 			SetBufferCommitInfoNeedsSave(buf);
-
-			/*
-			 * Normally, we would drop the lock on the heap page before
-			 * updating the visibility map, but since this case shouldn't
-			 * happen anyway, don't worry about that.
-			 */
-			visibilitymap_clear(onerel, blkno);
+			visibilitymap_clear(onerel, blkno, vmbuffer,
+								VISIBILITYMAP_VALID_BITS);
 		}
 
-		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-
-		/* Update the visibility map */
-		if (!all_visible_according_to_vm && all_visible)
+		/*
+		 * Update the visibility map.  We do this before releasing the lock
+		 * on the heap page, so that nobody can lock or modify a tuple on it
+		 * in between and leave the all-frozen bit set incorrectly.  (Both
+		 * clear the bits while holding their own heap page lock, so they
+		 * can't slip in between either.)
+		 */
+		if (all_visible &&
+			(!all_visible_according_to_vm ||
+			 (all_frozen && !all_frozen_according_to_vm)))
 		{
-			visibilitymap_pin(onerel, blkno, &vmbuffer);
-			LockBuffer(buf, BUFFER_LOCK_SHARE);
-			if (PageIsAllVisible(page))
-				visibilitymap_set(onerel, blkno, PageGetLSN(page), &vmbuffer);
-			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			uint8		flags = VISIBILITYMAP_ALL_VISIBLE;
+
+			if (all_frozen)
+				flags |= VISIBILITYMAP_ALL_FROZEN;
+			visibilitymap_set(onerel, blkno, InvalidXLogRecPtr,
+							  &vmbuffer, visibility_cutoff_xid, flags);
 		}
 
-		ReleaseBuffer(buf);
+		UnlockReleaseBuffer(buf);
 
 		/* Remember the location of the last page with nonremovable tuples */
 		if (hastup)
@@ -755,12 +846,17 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		vacrelstats->num_index_scans++;
 	}
 
-	/* Release the pin on the visibility map page */
+	/* Release the pins on the visibility map pages */
 	if (BufferIsValid(vmbuffer))
 	{
 		ReleaseBuffer(vmbuffer);
 		vmbuffer = InvalidBuffer;
 	}
+	if (BufferIsValid(lvra.vmbuffer))
+	{
+		ReleaseBuffer(lvra.vmbuffer);
+		lvra.vmbuffer = InvalidBuffer;
+	}
 
 	/* Do post-vacuum cleanup and statistics update for each index */
 	for (i = 0; i < nindexes; i++)
@@ -805,10 +901,20 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 	int			tupindex;
 	int			npages;
 	PGRUsage	ru0;
+	LVReadAhead lvra;
+	ReadAheadState readahead;
 
 	pg_rusage_init(&ru0);
 	npages = 0;
 
+	/* Prefetch the pages holding the dead tuples, in order */
+	lvra.onerel = onerel;
+	lvra.vacrelstats = vacrelstats;
+	lvra.next_tupindex = 0;
+	lvra.last_block = InvalidBlockNumber;
+	ReadAheadInit(&readahead, onerel, MAIN_FORKNUM,
+				  lazy_vacuum_readahead_next, (void *) &lvra);
+
 	tupindex = 0;
 	while (tupindex < vacrelstats->num_dead_tuples)
 	{
@@ -822,6 +928,7 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
 		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, tblk, RBM_NORMAL,
 								 vac_strategy);
+		ReadAheadAdvance(&readahead);
 		LockBufferForCleanup(buf);
 		tupindex = lazy_vacuum_page(onerel, tblk, buf, tupindex, vacrelstats);
 
@@ -842,6 +949,60 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 					   pg_rusage_show(&ru0))));
 }
 
+/*
+ *	lazy_scan_readahead_next() -- ReadAheadNextBlock callback for
+ *								  lazy_scan_heap
+ *
+ * Returns the next heap block that the visibility map doesn't allow us to
+ * skip.
+ */
+static BlockNumber
+lazy_scan_readahead_next(void *arg)
+{
+	LVReadAhead *lvra = (LVReadAhead *) arg;
+
+	while (lvra->next_block < lvra->nblocks)
+	{
+		BlockNumber blkno = lvra->next_block++;
+		uint8		vmstatus;
+
+		vmstatus = visibilitymap_get_status(lvra->onerel, blkno,
+											&lvra->vmbuffer);
+		if (lvra->scan_all ? !(vmstatus & VISIBILITYMAP_ALL_FROZEN) :
+			!(vmstatus & VISIBILITYMAP_ALL_VISIBLE))
+			return blkno;
+	}
+
+	return InvalidBlockNumber;
+}
+
+/*
+ *	lazy_vacuum_readahead_next() -- ReadAheadNextBlock callback for
+ *									lazy_vacuum_heap
+ *
+ * Returns the next heap block holding dead tuples.
+ */
+static BlockNumber
+lazy_vacuum_readahead_next(void *arg)
+{
+	LVReadAhead *lvra = (LVReadAhead *) arg;
+	LVRelStats *vacrelstats = lvra->vacrelstats;
+
+	while (lvra->next_tupindex < vacrelstats->num_dead_tuples)
+	{
+		ItemPointer itemptr = &vacrelstats->dead_tuples[lvra->next_tupindex++];
+		BlockNumber blkno = ItemPointerGetBlockNumber(itemptr);
+
+		if (blkno != lvra->last_block)
+		{
+			lvra->last_block = blkno;
+			return blkno;
+		}
+	}
+
+	return InvalidBlockNumber;
+}
+
 /*
  *	lazy_vacuum_page() -- free dead tuples on a page
  *					 and repair its fragmentation.
@@ -966,7 +1127,7 @@ lazy_cleanup_index(Relation indrel,
 	if (!stats->estimated_count)
 		vac_update_relstats(indrel,
 							stats->num_pages, stats->num_index_tuples,
-							false, InvalidTransactionId);
+							0, false, InvalidTransactionId);
 
 	ereport(elevel,
 			(errmsg("index \"%s\" now contains %.0f row versions in %u pages",
@@ -26,6 +26,7 @@
 #include "executor/nodeGroup.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
+#include "executor/nodeIncrementalSort.h"
 #include "executor/nodeIndexscan.h"
 #include "executor/nodeLimit.h"
 #include "executor/nodeLockRows.h"
@@ -209,6 +210,10 @@ ExecReScan(PlanState *node, ExprContext *exprCtxt)
 			ExecReScanSort((SortState *) node, exprCtxt);
 			break;
 
+		case T_IncrementalSortState:
+			ExecReScanIncrementalSort((IncrementalSortState *) node, exprCtxt);
+			break;
+
 		case T_GroupState:
 			ExecReScanGroup((GroupState *) node, exprCtxt);
 			break;
@@ -100,6 +100,9 @@ static Datum ExecMakeFunctionResult(FuncExprState *fcache,
 static Datum ExecMakeFunctionResultNoSets(FuncExprState *fcache,
 							 ExprContext *econtext,
 							 bool *isNull, ExprDoneCond *isDone);
+static Datum ExecMakeFunctionResultStrict2(FuncExprState *fcache,
+							 ExprContext *econtext,
+							 bool *isNull, ExprDoneCond *isDone);
 static Datum ExecEvalFunc(FuncExprState *fcache, ExprContext *econtext,
 			 bool *isNull, ExprDoneCond *isDone);
 static Datum ExecEvalOper(FuncExprState *fcache, ExprContext *econtext,
@@ -775,7 +778,16 @@ ExecEvalScalarVar(ExprState *exprstate, ExprContext *econtext,
 
 	attnum = variable->varattno;
 
-	/* Fetch the value from the slot */
+	/*
+	 * Fetch the value from the slot.  If the slot has already been deformed
+	 * that far, which is the usual case after the first Var of a row has been
+	 * evaluated, we can skip the call to slot_getattr.
+	 */
+	if (attnum > 0 && attnum <= slot->tts_nvalid)
+	{
+		*isNull = slot->tts_isnull[attnum - 1];
+		return slot->tts_values[attnum - 1];
+	}
 	return slot_getattr(slot, attnum, isNull);
 }
 
@@ -1800,7 +1812,10 @@ restart:
 		 * assuming that no argument can return a set if it didn't do so the
 		 * first time.
 		 */
-		fcache->xprstate.evalfunc = (ExprStateEvalFunc) ExecMakeFunctionResultNoSets;
+		if (fcache->func.fn_strict && list_length(fcache->args) == 2)
+			fcache->xprstate.evalfunc = (ExprStateEvalFunc) ExecMakeFunctionResultStrict2;
+		else
+			fcache->xprstate.evalfunc = (ExprStateEvalFunc) ExecMakeFunctionResultNoSets;
 
 		if (isDone)
 			*isDone = ExprSingleResult;
@@ -1833,6 +1848,55 @@ restart:
 	return result;
 }
 
+/*
+ * ExecEvalFuncArg
+ *
+ * Evaluate one argument of a function or operator.  Simple Vars and Consts,
+ * which are by far the most common arguments, are handled inline rather than
+ * through their evalfunc.  By the time this is used the argument has been
+ * evaluated once already, so a plain user-column Var will have had its
+ * evalfunc switched to ExecEvalScalarVar and its one-time checks done.
+ */
+static inline Datum
+ExecEvalFuncArg(ExprState *argstate, ExprContext *econtext, bool *isNull)
+{
+	if (argstate->evalfunc == ExecEvalScalarVar)
+	{
+		Var		   *variable = (Var *) argstate->expr;
+		AttrNumber	attnum = variable->varattno;
+		TupleTableSlot *slot;
+
+		switch (variable->varno)
+		{
+			case INNER:
+				slot = econtext->ecxt_innertuple;
+				break;
+			case OUTER:
+				slot = econtext->ecxt_outertuple;
+				break;
+			default:
+				slot = econtext->ecxt_scantuple;
+				break;
+		}
+
+		if (attnum > 0 && attnum <= slot->tts_nvalid)
+		{
+			*isNull = slot->tts_isnull[attnum - 1];
+			return slot->tts_values[attnum - 1];
+		}
+		return slot_getattr(slot, attnum, isNull);
+	}
+	else if (argstate->evalfunc == ExecEvalConst)
+	{
+		Const	   *con = (Const *) argstate->expr;
+
+		*isNull = con->constisnull;
+		return con->constvalue;
+	}
+
+	return ExecEvalExpr(argstate, econtext, isNull, NULL);
+}
+
 /*
  *		ExecMakeFunctionResultNoSets
  *
@@ -1863,10 +1927,9 @@ ExecMakeFunctionResultNoSets(FuncExprState *fcache,
 	{
 		ExprState  *argstate = (ExprState *) lfirst(arg);
 
-		fcinfo.arg[i] = ExecEvalExpr(argstate,
-									 econtext,
-									 &fcinfo.argnull[i],
-									 NULL);
+		fcinfo.arg[i] = ExecEvalFuncArg(argstate,
+										econtext,
+										&fcinfo.argnull[i]);
 		i++;
 	}
 
@@ -1899,6 +1962,57 @@ ExecMakeFunctionResultNoSets(FuncExprState *fcache,
 	return result;
 }
 
+/*
+ *		ExecMakeFunctionResultStrict2
+ *
+ * Further specialization of ExecMakeFunctionResultNoSets for a strict
+ * function of exactly two arguments.  That covers nearly every operator
+ * appearing in a WHERE clause, such as "a = $1" or "b > 10", so it's worth
+ * avoiding the argument-list loop and the generic null-argument scan.
+ */
+static Datum
+ExecMakeFunctionResultStrict2(FuncExprState *fcache,
+							  ExprContext *econtext,
+							  bool *isNull,
+							  ExprDoneCond *isDone)
+{
+	ListCell   *arg = list_head(fcache->args);
+	Datum		result;
+	FunctionCallInfoData fcinfo;
+	PgStat_FunctionCallUsage fcusage;
+
+	/* Guard against stack overflow due to overly complex expressions */
+	check_stack_depth();
+
+	if (isDone)
+		*isDone = ExprSingleResult;
+
+	fcinfo.arg[0] = ExecEvalFuncArg((ExprState *) lfirst(arg),
+									econtext, &fcinfo.argnull[0]);
+	arg = lnext(arg);
+	fcinfo.arg[1] = ExecEvalFuncArg((ExprState *) lfirst(arg),
+									econtext, &fcinfo.argnull[1]);
+
+	/* The function is strict, so a NULL argument means a NULL result */
+	if (fcinfo.argnull[0] || fcinfo.argnull[1])
+	{
+		*isNull = true;
+		return (Datum) 0;
+	}
+
+	InitFunctionCallInfoData(fcinfo, &(fcache->func), 2, NULL, NULL);
+
+	pgstat_init_function_usage(&fcinfo, &fcusage);
+
+	/* fcinfo.isnull = false; */	/* handled by InitFunctionCallInfoData */
+	result = FunctionCallInvoke(&fcinfo);
+	*isNull = fcinfo.isnull;
+
+	pgstat_end_function_usage(&fcusage, true);
+
+	return result;
+}
+
 
 /*
  *		ExecMakeTableFunctionResult
@@ -62,6 +62,16 @@
  *	  nominal transition value; they can use the memory context returned by
  *	  AggCheckCallContext() to do that.
  *
+ *	  In AGG_HASHED mode, the hash table is limited to approximately work_mem.
+ *	  Once it is full, input tuples that belong to groups already in the
+ *	  table are still aggregated as usual, but tuples for new groups are
+ *	  written out to one of several temporary files, partitioned by the high
+ *	  bits of their hash value.  When the in-memory groups have been emitted,
+ *	  the table is rebuilt from each spilled partition in turn.  A partition
+ *	  that still doesn't fit is split again using the next few hash bits.
+ *	  The space estimate doesn't include pass-by-reference transition values,
+ *	  so aggregates with large states can still overrun work_mem somewhat.
+ *
  *	  Note: AggCheckCallContext() is available as of PostgreSQL 9.0.  The
  *	  AggState is available as context in earlier releases (back to 8.1),
  *	  but direct examination of the node is needed to use it before 9.0.
@@ -89,6 +99,7 @@
 #include "optimizer/tlist.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "storage/buffile.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -247,6 +258,37 @@ typedef struct AggHashEntryData
 	AggStatePerGroupData pergroup[1];	/* VARIABLE LENGTH ARRAY */
 } AggHashEntryData;				/* VARIABLE LENGTH STRUCT */
 
+/*
+ * When the hash table exceeds work_mem, tuples of groups not already in
+ * the table are spilled to AGG_SPILL_PARTITIONS temp files.  Each level of
+ * repartitioning consumes another AGG_SPILL_BITS bits of the hash value,
+ * starting from the high end (the low bits are used by dynahash to choose
+ * buckets).  Once the hash bits are used up we stop spilling and just let
+ * the table grow.
+ */
+#define AGG_SPILL_BITS			4
+#define AGG_SPILL_PARTITIONS	(1 << AGG_SPILL_BITS)
+#define AGG_SPILL_MAX_LEVEL		(32 / AGG_SPILL_BITS)
+
+/* A spilled partition waiting to be aggregated */
+typedef struct AggSpillBatch
+{
+	BufFile    *file;			/* tuples, rewound to the start */
+	int			level;			/* partitioning level of the tuples */
+} AggSpillBatch;
+
+typedef struct AggHashSpillData
+{
+	long		mem_used;		/* estimated size of hash table, in bytes */
+	bool		spilling;		/* table is full, spill new groups? */
+	bool		spilled;		/* spilled anything since last rescan? */
+	int			level;			/* partitioning level of current pass */
+	BufFile    *infile;			/* batch being reloaded, or NULL */
+	BufFile    *files[AGG_SPILL_PARTITIONS];	/* output partitions */
+	List	   *batches;		/* pending AggSpillBatch entries */
+	TupleTableSlot *slot;		/* slot for reading spilled tuples */
+} AggHashSpillData;
+
 
 static void initialize_aggregates(AggState *aggstate,
 					  AggStatePerAgg peragg,
@@ -271,6 +313,13 @@ static bool find_unaggregated_cols_walker(Node *node, Bitmapset **colnos);
 static void build_hash_table(AggState *aggstate);
 static AggHashEntry lookup_hash_entry(AggState *aggstate,
 				  TupleTableSlot *inputslot);
+static uint32 agg_hash_tuple(AggState *aggstate, TupleTableSlot *slot);
+static void agg_spill_tuple(AggState *aggstate, TupleTableSlot *slot,
+				uint32 hashvalue);
+static TupleTableSlot *agg_read_spilled_tuple(AggState *aggstate,
+					   uint32 *hashvalue);
+static bool agg_refill_hash_table(AggState *aggstate);
+static void agg_spill_reset(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
 static void agg_fill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
@@ -907,12 +956,17 @@ hash_agg_entry_size(int numAggs)
  * Find or create a hashtable entry for the tuple group containing the
  * given tuple.
  *
+ * If the hash table has filled up, no new entries are created; NULL is
+ * returned if the tuple's group isn't already in the table, and the caller
+ * must spill the tuple.
+ *
  * When called, CurrentMemoryContext should be the per-query context.
  */
 static AggHashEntry
 lookup_hash_entry(AggState *aggstate, TupleTableSlot *inputslot)
 {
 	TupleTableSlot *hashslot = aggstate->hashslot;
+	AggHashSpill spill = aggstate->hashspill;
 	ListCell   *l;
 	AggHashEntry entry;
 	bool		isnew;
@@ -936,6 +990,11 @@ lookup_hash_entry(AggState *aggstate, TupleTableSlot *inputslot)
 	}
 
 	/* find or create the hashtable entry using the filtered tuple */
+	if (spill->spilling)
+		return (AggHashEntry) LookupTupleHashEntry(aggstate->hashtable,
+												   hashslot,
+												   NULL);
+
 	entry = (AggHashEntry) LookupTupleHashEntry(aggstate->hashtable,
 												hashslot,
 												&isnew);
@@ -944,11 +1003,217 @@ lookup_hash_entry(AggState *aggstate, TupleTableSlot *inputslot)
 	{
 		/* initialize aggregates for new tuple group */
 		initialize_aggregates(aggstate, aggstate->peragg, entry->pergroup);
+
+		/*
+		 * Charge the new entry against work_mem, and stop adding groups once
+		 * the table is full, unless we have run out of hash bits to split on.
+		 */
+		spill->mem_used += hash_agg_entry_size(aggstate->numaggs) +
+			MAXALIGN(entry->shared.firstTuple->t_len);
+		if (spill->mem_used > work_mem * 1024L &&
+			spill->level < AGG_SPILL_MAX_LEVEL)
+			spill->spilling = true;
 	}
 
 	return entry;
 }
 
+/*
+ * Compute the hash value of the grouping columns of an input tuple.
+ *
+ * This needn't match the hash used inside the TupleHashTable; it's only
+ * used to choose spill partitions.
+ */
+static uint32
+agg_hash_tuple(AggState *aggstate, TupleTableSlot *slot)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	MemoryContext oldContext;
+	uint32		hashkey = 0;
+	int			i;
+
+	/* the hash functions might leak, so run them in the per-tuple context */
+	oldContext =
+		MemoryContextSwitchTo(aggstate->tmpcontext->ecxt_per_tuple_memory);
+
+	for (i = 0; i < node->numCols; i++)
+	{
+		Datum		attr;
+		bool		isNull;
+
+		/* rotate hashkey left 1 bit at each step */
+		hashkey = (hashkey << 1) | ((hashkey & 0x80000000) ? 1 : 0);
+
+		attr = slot_getattr(slot, node->grpColIdx[i], &isNull);
+
+		if (!isNull)			/* treat nulls as having hash key 0 */
+			hashkey ^= DatumGetUInt32(FunctionCall1(&aggstate->hashfunctions[i],
+													attr));
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	return hashkey;
+}
+
+/*
+ * Write an input tuple whose group doesn't fit in the hash table to the
+ * spill partition selected by the next AGG_SPILL_BITS bits of its hash.
+ *
+ * The data recorded in the file for each tuple is its hash value, then the
+ * tuple in MinimalTuple format.  As with ExecHashJoinSaveTuple, this must
+ * be called in the per-query context, not a shorter-lived one.
+ */
+static void
+agg_spill_tuple(AggState *aggstate, TupleTableSlot *slot, uint32 hashvalue)
+{
+	AggHashSpill spill = aggstate->hashspill;
+	MinimalTuple tuple;
+	int			partno;
+	size_t		written;
+
+	Assert(spill->level < AGG_SPILL_MAX_LEVEL);
+	partno = (hashvalue >> (32 - (spill->level + 1) * AGG_SPILL_BITS)) &
+		(AGG_SPILL_PARTITIONS - 1);
+
+	if (spill->files[partno] == NULL)
+		spill->files[partno] = BufFileCreateTemp(false);
+
+	/* set up the slot for reading the tuples back, if not done yet */
+	if (spill->slot->tts_tupleDescriptor == NULL)
+		ExecSetSlotDescriptor(spill->slot, slot->tts_tupleDescriptor);
+
+	tuple = ExecFetchSlotMinimalTuple(slot);
+
+	written = BufFileWrite(spill->files[partno], (void *) &hashvalue,
+						   sizeof(uint32));
+	if (written != sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			  errmsg("could not write to hash-aggregate temporary file: %m")));
+
+	written = BufFileWrite(spill->files[partno], (void *) tuple, tuple->t_len);
+	if (written != tuple->t_len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			  errmsg("could not write to hash-aggregate temporary file: %m")));
+
+	spill->spilled = true;
+}
+
+/*
+ * Read the next tuple from the spilled batch being reloaded.  Returns NULL
+ * at end of file.
+ */
+static TupleTableSlot *
+agg_read_spilled_tuple(AggState *aggstate, uint32 *hashvalue)
+{
+	AggHashSpill spill = aggstate->hashspill;
+	uint32		header[2];
+	size_t		nread;
+	MinimalTuple tuple;
+
+	/* the hash value and the MinimalTuple length word are both uint32 */
+	nread = BufFileRead(spill->infile, (void *) header, sizeof(header));
+	if (nread == 0)				/* end of file */
+	{
+		ExecClearTuple(spill->slot);
+		return NULL;
+	}
+	if (nread != sizeof(header))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			 errmsg("could not read from hash-aggregate temporary file: %m")));
+	*hashvalue = header[0];
+	tuple = (MinimalTuple) palloc(header[1]);
+	tuple->t_len = header[1];
+	nread = BufFileRead(spill->infile,
+						(void *) ((char *) tuple + sizeof(uint32)),
+						header[1] - sizeof(uint32));
+	if (nread != header[1] - sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			 errmsg("could not read from hash-aggregate temporary file: %m")));
+	return ExecStoreMinimalTuple(tuple, spill->slot, true);
+}
+
+/*
+ * Discard the current hash table and rebuild it from the next pending
+ * spilled batch.  Returns false if there are no more batches.
+ */
+static bool
+agg_refill_hash_table(AggState *aggstate)
+{
+	AggHashSpill spill = aggstate->hashspill;
+	AggSpillBatch *batch;
+
+	if (spill->batches == NIL)
+		return false;
+
+	batch = (AggSpillBatch *) linitial(spill->batches);
+	spill->batches = list_delete_first(spill->batches);
+
+	/* the scan slot may be pointing at a tuple in the old table */
+	ExecClearTuple(aggstate->ss.ss_ScanTupleSlot);
+
+	MemoryContextResetAndDeleteChildren(aggstate->aggcontext);
+	build_hash_table(aggstate);
+
+	spill->mem_used = 0;
+	spill->level = batch->level;
+	spill->infile = batch->file;
+	pfree(batch);
+
+	aggstate->hash_spill_levels = Max(aggstate->hash_spill_levels,
+									  spill->level);
+
+	agg_fill_hash_table(aggstate);
+
+	return true;
+}
+
+/*
+ * Release all spill files and forget about pending batches.
+ */
+static void
+agg_spill_reset(AggState *aggstate)
+{
+	AggHashSpill spill = aggstate->hashspill;
+	ListCell   *l;
+	int			i;
+
+	if (spill == NULL)
+		return;
+
+	if (spill->infile)
+		BufFileClose(spill->infile);
+	spill->infile = NULL;
+
+	for (i = 0; i < AGG_SPILL_PARTITIONS; i++)
+	{
+		if (spill->files[i])
+			BufFileClose(spill->files[i]);
+		spill->files[i] = NULL;
+	}
+
+	foreach(l, spill->batches)
+	{
+		AggSpillBatch *batch = (AggSpillBatch *) lfirst(l);
+
+		BufFileClose(batch->file);
+	}
+	list_free_deep(spill->batches);
+	spill->batches = NIL;
+
+	if (spill->slot)
+		ExecClearTuple(spill->slot);
+
+	spill->mem_used = 0;
+	spill->spilling = false;
+	spill->spilled = false;
+	spill->level = 0;
+}
+
 /*
  * ExecAgg -
  *
@@ -1202,14 +1467,20 @@ agg_retrieve_direct(AggState *aggstate)
 
 /*
  * ExecAgg for hashed case: phase 1, read input and build hash table
+ *
+ * The input is either the outer plan or, when reloading a spilled batch,
+ * the batch's temp file.  Tuples whose groups don't fit are spilled again.
  */
 static void
 agg_fill_hash_table(AggState *aggstate)
 {
 	PlanState  *outerPlan;
 	ExprContext *tmpcontext;
+	AggHashSpill spill = aggstate->hashspill;
 	AggHashEntry entry;
 	TupleTableSlot *outerslot;
+	uint32		hashvalue = 0;
+	int			i;
 
 	/*
 	 * get state info from node
@@ -1218,13 +1489,18 @@ agg_fill_hash_table(AggState *aggstate)
 	/* tmpcontext is the per-input-tuple expression context */
 	tmpcontext = aggstate->tmpcontext;
 
+	aggstate->hash_batches_used++;
+
 	/*
 	 * Process each outer-plan tuple, and then fetch the next one, until we
 	 * exhaust the outer plan.
 	 */
 	for (;;)
 	{
-		outerslot = ExecProcNode(outerPlan);
+		if (spill->infile)
+			outerslot = agg_read_spilled_tuple(aggstate, &hashvalue);
+		else
+			outerslot = ExecProcNode(outerPlan);
 		if (TupIsNull(outerslot))
 			break;
 		/* set up for advance_aggregates call */
@@ -1233,13 +1509,51 @@ agg_fill_hash_table(AggState *aggstate)
 		/* Find or build hashtable entry for this tuple's group */
 		entry = lookup_hash_entry(aggstate, outerslot);
 
-		/* Advance the aggregates */
-		advance_aggregates(aggstate, entry->pergroup);
+		if (entry != NULL)
+		{
+			/* Advance the aggregates */
+			advance_aggregates(aggstate, entry->pergroup);
+		}
+		else
+		{
+			/* No room for a new group; save the tuple for a later pass */
+			if (spill->infile == NULL)
+				hashvalue = agg_hash_tuple(aggstate, outerslot);
+			agg_spill_tuple(aggstate, outerslot, hashvalue);
+		}
 
 		/* Reset per-input-tuple context after each tuple */
 		ResetExprContext(tmpcontext);
 	}
 
+	/* We're done with the batch we were reloading, if any */
+	if (spill->infile)
+	{
+		BufFileClose(spill->infile);
+		spill->infile = NULL;
+	}
+
+	/* Queue up the partitions written in this pass */
+	for (i = 0; i < AGG_SPILL_PARTITIONS; i++)
+	{
+		AggSpillBatch *batch;
+
+		if (spill->files[i] == NULL)
+			continue;
+
+		if (BufFileSeek(spill->files[i], 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+			   errmsg("could not rewind hash-aggregate temporary file: %m")));
+
+		batch = (AggSpillBatch *) palloc(sizeof(AggSpillBatch));
+		batch->file = spill->files[i];
+		batch->level = spill->level + 1;
+		spill->batches = lappend(spill->batches, batch);
+		spill->files[i] = NULL;
+	}
+	spill->spilling = false;
+
 	aggstate->table_filled = true;
 	/* Initialize to walk the hash table */
 	ResetTupleHashIterator(aggstate->hashtable, &aggstate->hashiter);
@@ -1282,6 +1596,10 @@ agg_retrieve_hash_table(AggState *aggstate)
 		entry = (AggHashEntry) ScanTupleHashTable(&aggstate->hashiter);
 		if (entry == NULL)
 		{
+			/* Move on to the next spilled batch, if there is one */
+			if (agg_refill_hash_table(aggstate))
+				continue;
+
 			/* No more entries in hashtable, so done */
 			aggstate->agg_done = TRUE;
 			return NULL;
@@ -1387,6 +1705,9 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	aggstate->pergroup = NULL;
 	aggstate->grp_firstTuple = NULL;
 	aggstate->hashtable = NULL;
+	aggstate->hashspill = NULL;
+	aggstate->hash_batches_used = 0;
+	aggstate->hash_spill_levels = 0;
 
 	/*
 	 * Create expression contexts.	We need two, one for per-input-tuple
@@ -1511,6 +1832,9 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		aggstate->table_filled = false;
 		/* Compute the columns we actually need to hash on */
 		aggstate->hash_needed = find_hash_columns(aggstate);
+		/* Set up for spilling, in case the table outgrows work_mem */
+		aggstate->hashspill = (AggHashSpill) palloc0(sizeof(AggHashSpillData));
+		aggstate->hashspill->slot = ExecInitExtraTupleSlot(estate);
 	}
 	else
 	{
@@ -1869,6 +2193,9 @@ ExecEndAgg(AggState *node)
 			tuplesort_end(peraggstate->sortstate);
 	}
 
+	/* Close any temp files of a hashed aggregation */
+	agg_spill_reset(node);
+
 	/*
 	 * Free both the expr contexts.
 	 */
@@ -1909,13 +2236,19 @@ ExecReScanAgg(AggState *node, ExprContext *exprCtxt)
 		/*
 		 * If we do have the hash table and the subplan does not have any
 		 * parameter changes, then we can just rescan the existing hash table;
-		 * no need to build it again.
+		 * no need to build it again.  That doesn't work if any groups were
+		 * spilled, since the table then holds only the last batch.
 		 */
-		if (((PlanState *) node)->lefttree->chgParam == NULL)
+		if (((PlanState *) node)->lefttree->chgParam == NULL &&
+			!node->hashspill->spilled)
 		{
 			ResetTupleHashIterator(node->hashtable, &node->hashiter);
 			return;
 		}
+
+		/* Throw away any spilled batches; we'll read the input again */
+		agg_spill_reset(node);
+		ExecClearTuple(node->ss.ss_ScanTupleSlot);
 	}
 
 	/* Make sure we have closed any open tuplesorts */
@@ -24,6 +24,7 @@
 #include <math.h>
 #include <limits.h>
 
+#include "access/hash.h"
 #include "catalog/pg_statistic.h"
 #include "commands/tablespace.h"
 #include "executor/execdebug.h"
@@ -47,6 +48,9 @@ static void ExecHashSkewTableInsert(HashJoinTable hashtable,
 						uint32 hashvalue,
 						int bucketNumber);
 static void ExecHashRemoveNextSkewBucket(HashJoinTable hashtable);
+static void *dense_alloc(HashJoinTable hashtable, Size size);
+static void ExecHashBuildBloomFilter(HashJoinTable hashtable, double ntuples);
+static void ExecHashBloomAdd(HashJoinTable hashtable, uint32 hashvalue);
 
 
 /* ----------------------------------------------------------------
@@ -110,6 +114,9 @@ MultiExecHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			if (hashtable->bloomFilter)
+				ExecHashBloomAdd(hashtable, hashvalue);
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -126,6 +133,18 @@ MultiExecHash(HashState *node)
 		}
 	}
 
+	/*
+	 * If the bloom filter came out more than half full, it would pass most
+	 * probes anyway; give the memory back to the hash table instead.
+	 */
+	if (hashtable->bloomFilter &&
+		hashtable->bloomBitsSet > (hashtable->bloomMask / 2))
+	{
+		pfree(hashtable->bloomFilter);
+		hashtable->bloomFilter = NULL;
+		hashtable->spaceAllowed += ((Size) hashtable->bloomMask + 1) / 8;
+	}
+
 	/* must provide our own instrumentation support */
 	if (node->ps.instrument)
 		InstrStopNode(node->ps.instrument, hashtable->totalTuples);
@@ -292,6 +311,10 @@ ExecHashTableCreate(Hash *node, List *hashOperators)
 	hashtable->spaceUsedSkew = 0;
 	hashtable->spaceAllowedSkew =
 		hashtable->spaceAllowed * SKEW_WORK_MEM_PERCENT / 100;
+	hashtable->chunks = NULL;
+	hashtable->bloomFilter = NULL;
+	hashtable->bloomMask = 0;
+	hashtable->bloomBitsSet = 0;
 
 	/*
 	 * Get info about the hash functions to be used for each hash key. Also
@@ -351,6 +374,9 @@ ExecHashTableCreate(Hash *node, List *hashOperators)
 		/* The files will not be opened until needed... */
 		/* ... but make sure we have temp tablespaces established for them */
 		PrepareTempTablespaces();
+
+		/* the bloom filter is only worthwhile if outer tuples hit disk */
+		ExecHashBuildBloomFilter(hashtable, outerNode->plan_rows);
 	}
 
 	/*
@@ -553,10 +579,10 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 	int			oldnbatch = hashtable->nbatch;
 	int			curbatch = hashtable->curbatch;
 	int			nbatch;
-	int			i;
 	MemoryContext oldcxt;
 	long		ninmemory;
 	long		nfreed;
+	HashMemoryChunk oldchunks;
 
 	/* do nothing if we've decided to shut off growth */
 	if (!hashtable->growEnabled)
@@ -605,55 +631,69 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 
 	/*
 	 * Scan through the existing hash table entries and dump out any that are
-	 * no longer of the current batch.
+	 * no longer of the current batch.  Rather than following the bucket
+	 * chains, we walk the memory chunks, copying the tuples we keep into
+	 * fresh chunks and rebuilding the buckets from scratch; the old chunks
+	 * are then freed as a whole.  Skew-table tuples aren't in the chunks and
+	 * are not affected.
 	 */
 	ninmemory = nfreed = 0;
 
-	for (i = 0; i < hashtable->nbuckets; i++)
-	{
-		HashJoinTuple prevtuple;
-		HashJoinTuple tuple;
+	MemSet(hashtable->buckets, 0,
+		   sizeof(HashJoinTuple) * hashtable->nbuckets);
 
-		prevtuple = NULL;
-		tuple = hashtable->buckets[i];
+	oldchunks = hashtable->chunks;
+	hashtable->chunks = NULL;
 
-		while (tuple != NULL)
+	while (oldchunks != NULL)
+	{
+		HashMemoryChunk nextchunk = oldchunks->next;
+		Size		idx = 0;
+
+		/* process all tuples stored in this chunk */
+		while (idx < oldchunks->used)
 		{
-			/* save link in case we delete */
-			HashJoinTuple nexttuple = tuple->next;
+			HashJoinTuple hashTuple;
+			MinimalTuple tuple;
+			Size		hashTupleSize;
 			int			bucketno;
 			int			batchno;
 
+			hashTuple = (HashJoinTuple) (HASH_CHUNK_DATA(oldchunks) + idx);
+			tuple = HJTUPLE_MINTUPLE(hashTuple);
+			hashTupleSize = HJTUPLE_OVERHEAD + tuple->t_len;
+
 			ninmemory++;
-			ExecHashGetBucketAndBatch(hashtable, tuple->hashvalue,
+			ExecHashGetBucketAndBatch(hashtable, hashTuple->hashvalue,
 									  &bucketno, &batchno);
-			Assert(bucketno == i);
 			if (batchno == curbatch)
 			{
-				/* keep tuple */
-				prevtuple = tuple;
+				/* keep tuple: copy it into a new chunk and relink it */
+				HashJoinTuple copyTuple;
+
+				copyTuple = (HashJoinTuple) dense_alloc(hashtable,
+														hashTupleSize);
+				memcpy(copyTuple, hashTuple, hashTupleSize);
+				copyTuple->next = hashtable->buckets[bucketno];
+				hashtable->buckets[bucketno] = copyTuple;
 			}
 			else
 			{
 				/* dump it out */
 				Assert(batchno > curbatch);
-				ExecHashJoinSaveTuple(HJTUPLE_MINTUPLE(tuple),
-									  tuple->hashvalue,
+				ExecHashJoinSaveTuple(tuple,
+									  hashTuple->hashvalue,
 									  &hashtable->innerBatchFile[batchno]);
-				/* and remove from hash table */
-				if (prevtuple)
-					prevtuple->next = nexttuple;
-				else
-					hashtable->buckets[i] = nexttuple;
-				/* prevtuple doesn't change */
-				hashtable->spaceUsed -=
-					HJTUPLE_OVERHEAD + HJTUPLE_MINTUPLE(tuple)->t_len;
-				pfree(tuple);
+				hashtable->spaceUsed -= hashTupleSize;
 				nfreed++;
 			}
 
-			tuple = nexttuple;
+			idx += MAXALIGN(hashTupleSize);
 		}
+
+		/* we're done with the old chunk */
+		pfree(oldchunks);
+		oldchunks = nextchunk;
 	}
 
 #ifdef HJDEBUG
@@ -713,8 +753,7 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		int			hashTupleSize;
 
 		hashTupleSize = HJTUPLE_OVERHEAD + tuple->t_len;
-		hashTuple = (HashJoinTuple) MemoryContextAlloc(hashtable->batchCxt,
-													   hashTupleSize);
+		hashTuple = (HashJoinTuple) dense_alloc(hashtable, hashTupleSize);
 		hashTuple->hashvalue = hashvalue;
 		memcpy(HJTUPLE_MINTUPLE(hashTuple), tuple, tuple->t_len);
 		hashTuple->next = hashtable->buckets[bucketno];
@@ -957,6 +996,9 @@ ExecHashTableReset(HashJoinTable hashtable)
 
 	hashtable->spaceUsed = 0;
 
+	/* the chunks went away with the rest of batchCxt */
+	hashtable->chunks = NULL;
+
 	MemoryContextSwitchTo(oldcxt);
 }
 
@@ -1269,9 +1311,16 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 		/* Decide whether to put the tuple in the hash table or a temp file */
 		if (batchno == hashtable->curbatch)
 		{
-			/* Move the tuple to the main hash table */
-			hashTuple->next = hashtable->buckets[bucketno];
-			hashtable->buckets[bucketno] = hashTuple;
+			/* Move the tuple to the main hash table's dense storage */
+			HashJoinTuple copyTuple;
+
+			copyTuple = (HashJoinTuple) dense_alloc(hashtable, tupleSize);
+			memcpy(copyTuple, hashTuple, tupleSize);
+			pfree(hashTuple);
+
+			copyTuple->next = hashtable->buckets[bucketno];
+			hashtable->buckets[bucketno] = copyTuple;
+
 			/* We have reduced skew space, but overall space doesn't change */
 			hashtable->spaceUsedSkew -= tupleSize;
 		}
@@ -1322,3 +1371,165 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 		hashtable->spaceUsedSkew = 0;
 	}
 }
+
+/*
+ * dense_alloc
+ *
+ *		Allocate space for a tuple in the current batch's dense storage.
+ *		The result is MAXALIGN'd and lives until the batch is reset.
+ */
+static void *
+dense_alloc(HashJoinTable hashtable, Size size)
+{
+	HashMemoryChunk newChunk;
+	char	   *ptr;
+
+	/* just in case the size is not already aligned properly */
+	size = MAXALIGN(size);
+
+	/*
+	 * Oversized tuples get a chunk of their own.  Link it in behind the
+	 * current chunk, so that the current chunk can still be filled up.
+	 */
+	if (size > HASH_CHUNK_THRESHOLD)
+	{
+		newChunk = (HashMemoryChunk)
+			MemoryContextAlloc(hashtable->batchCxt,
+							   HASH_CHUNK_HEADER_SIZE + size);
+		newChunk->maxlen = size;
+		newChunk->used = size;
+		newChunk->ntuples = 1;
+
+		if (hashtable->chunks != NULL)
+		{
+			newChunk->next = hashtable->chunks->next;
+			hashtable->chunks->next = newChunk;
+		}
+		else
+		{
+			newChunk->next = NULL;
+			hashtable->chunks = newChunk;
+		}
+
+		return HASH_CHUNK_DATA(newChunk);
+	}
+
+	/*
+	 * Start a new chunk if there is none yet, or the current one hasn't
+	 * enough space left.
+	 */
+	if (hashtable->chunks == NULL ||
+		hashtable->chunks->maxlen - hashtable->chunks->used < size)
+	{
+		newChunk = (HashMemoryChunk)
+			MemoryContextAlloc(hashtable->batchCxt,
+							   HASH_CHUNK_HEADER_SIZE + HASH_CHUNK_SIZE);
+		newChunk->maxlen = HASH_CHUNK_SIZE;
+		newChunk->used = 0;
+		newChunk->ntuples = 0;
+		newChunk->next = hashtable->chunks;
+		hashtable->chunks = newChunk;
+	}
+
+	/* there is enough space in the current chunk, let's add the tuple */
+	ptr = HASH_CHUNK_DATA(hashtable->chunks) + hashtable->chunks->used;
+	hashtable->chunks->used += size;
+	hashtable->chunks->ntuples += 1;
+
+	return ptr;
+}
+
+/*
+ * ExecHashBuildBloomFilter
+ *
+ *		Set up an empty bloom filter sized for the estimated number of inner
+ *		tuples.  The filter lives in hashCxt, since it covers all batches.
+ *		Its space is taken out of spaceAllowed.
+ */
+static void
+ExecHashBuildBloomFilter(HashJoinTable hashtable, double ntuples)
+{
+	double		maxbits;
+	double		nbits;
+	Size		bloombits;
+
+	/* Limit the filter to a fraction of the join's memory */
+	maxbits = (double) hashtable->spaceAllowed * 8 *
+		BLOOM_WORK_MEM_PERCENT / 100;
+	/* ... and keep bloomMask within a uint32 */
+	maxbits = Min(maxbits, (double) ((uint32) 1 << 31));
+	if (maxbits < BLOOM_MIN_BITS)
+		return;
+
+	nbits = Max(ntuples * BLOOM_BITS_PER_TUPLE, BLOOM_MIN_BITS);
+	nbits = Min(nbits, maxbits);
+
+	/* round down to a power of 2, so we can mask rather than divide */
+	bloombits = BLOOM_MIN_BITS;
+	while ((double) bloombits * 2 <= nbits)
+		bloombits *= 2;
+
+	hashtable->bloomFilter = (uint32 *)
+		MemoryContextAllocZero(hashtable->hashCxt, bloombits / 8);
+	hashtable->bloomMask = (uint32) (bloombits - 1);
+	hashtable->bloomBitsSet = 0;
+	hashtable->spaceAllowed -= bloombits / 8;
+}
+
+/*
+ * The two bit positions for a hash value are taken from the value itself
+ * and from a remix of it, so that they are independent of each other.
+ */
+#define BLOOM_BIT1(hashtable, hashvalue) \
+	((hashvalue) & (hashtable)->bloomMask)
+#define BLOOM_BIT2(hashtable, hashvalue) \
+	(DatumGetUInt32(hash_uint32(hashvalue)) & (hashtable)->bloomMask)
+#define BLOOM_TEST_AND_SET(filter, bit, nset) \
+	do { \
+		uint32		_word = (bit) >> 5; \
+		uint32		_mask = (uint32) 1 << ((bit) & 31); \
+		if (((filter)[_word] & _mask) == 0) \
+		{ \
+			(filter)[_word] |= _mask; \
+			(nset)++; \
+		} \
+	} while (0)
+
+/*
+ * ExecHashBloomAdd
+ *
+ *		Add an inner tuple's hash value to the bloom filter.
+ */
+static void
+ExecHashBloomAdd(HashJoinTable hashtable, uint32 hashvalue)
+{
+	uint32		bit1 = BLOOM_BIT1(hashtable, hashvalue);
+	uint32		bit2 = BLOOM_BIT2(hashtable, hashvalue);
+
+	BLOOM_TEST_AND_SET(hashtable->bloomFilter, bit1, hashtable->bloomBitsSet);
+	BLOOM_TEST_AND_SET(hashtable->bloomFilter, bit2, hashtable->bloomBitsSet);
+}
+
+/*
+ * ExecHashBloomTest
+ *
+ *		Returns false if no inner tuple can have the given hash value, true
+ *		if one might.  Always returns true if there is no filter.
+ */
+bool
+ExecHashBloomTest(HashJoinTable hashtable, uint32 hashvalue)
+{
+	uint32	   *filter = hashtable->bloomFilter;
+	uint32		bit;
+
+	if (filter == NULL)
+		return true;
+
+	bit = BLOOM_BIT1(hashtable, hashvalue);
+	if ((filter[bit >> 5] & ((uint32) 1 << (bit & 31))) == 0)
+		return false;
+	bit = BLOOM_BIT2(hashtable, hashvalue);
+	if ((filter[bit >> 5] & ((uint32) 1 << (bit & 31))) == 0)
+		return false;
+	return true;
+}
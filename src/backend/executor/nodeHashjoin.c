@@ -60,6 +60,7 @@ ExecHashJoin(HashJoinState *node)
 	TupleTableSlot *outerTupleSlot;
 	uint32		hashvalue;
 	int			batchno;
+	bool		skip_probe = false;
 
 	/*
 	 * get information from HashJoin node
@@ -196,6 +197,24 @@ ExecHashJoin(HashJoinState *node)
 			econtext->ecxt_outertuple = outerTupleSlot;
 			node->hj_NeedNewOuter = false;
 			node->hj_MatchedOuter = false;
+			skip_probe = false;
+
+			/*
+			 * If the bloom filter says no inner tuple has this hash value,
+			 * the outer tuple can't have a match in any batch.  For an inner
+			 * join or semijoin we can just drop it; otherwise go straight to
+			 * emitting it as unmatched.  Either way it needn't be probed for
+			 * nor saved to a batch file.
+			 */
+			if (!ExecHashBloomTest(hashtable, hashvalue))
+			{
+				if (!HASHJOIN_IS_OUTER(node))
+				{
+					node->hj_NeedNewOuter = true;
+					continue;	/* loop around for a new outer tuple */
+				}
+				skip_probe = true;
+			}
 
 			/*
 			 * Now we have an outer tuple; find the corresponding bucket for
@@ -214,7 +233,8 @@ ExecHashJoin(HashJoinState *node)
 			 * a skew bucket.
 			 */
 			if (batchno != hashtable->curbatch &&
-				node->hj_CurSkewBucketNo == INVALID_SKEW_BUCKET_NO)
+				node->hj_CurSkewBucketNo == INVALID_SKEW_BUCKET_NO &&
+				!skip_probe)
 			{
 				/*
 				 * Need to postpone this outer tuple to a later batch. Save it
@@ -232,7 +252,7 @@ ExecHashJoin(HashJoinState *node)
 		/*
 		 * OK, scan the selected hash bucket for matches
 		 */
-		for (;;)
+		while (!skip_probe)
 		{
 			curtuple = ExecScanHashBucket(node, econtext);
 			if (curtuple == NULL)
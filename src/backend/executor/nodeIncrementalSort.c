@@ -0,0 +1,315 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeIncrementalSort.c
+ *	  Routines to handle incremental sorting of relations.
+ *
+ * An incremental sort is used when the input is already sorted by a
+ * prefix of the required sort keys ("presorted" columns).  Rather than
+ * sorting the whole input, we read one group of tuples that are equal on
+ * the presorted columns at a time, sort just that group by the remaining
+ * columns, and return it before reading the next group.  Each sort is
+ * therefore much smaller than a full sort, and the first tuples can be
+ * returned as soon as the first group has been read.  If a LIMIT bounds
+ * the number of tuples required, we stop reading input as soon as enough
+ * groups have been returned.
+ *
+ * Since the tuples of a group all agree on the presorted columns, the
+ * group sorts compare only the remaining columns.  One tuplesort is set up
+ * for the first group and reset for each following one.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execdebug.h"
+#include "executor/executor.h"
+#include "executor/nodeIncrementalSort.h"
+#include "miscadmin.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplesort.h"
+
+
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Each call returns the next tuple of the current group from
+ *		tuplesort.  When the group is exhausted, the next group is read
+ *		from the outer plan and sorted.  The first tuple of the next group
+ *		is only recognized by reading it, so it is kept in the scan tuple
+ *		slot until we get around to that group.
+ * ----------------------------------------------------------------
+ */
+TupleTableSlot *
+ExecIncrementalSort(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	PlanState  *outerNode = outerPlanState(node);
+	TupleTableSlot *pivot = node->ss.ss_ScanTupleSlot;
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+	Tuplesortstate *tuplesortstate;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	/* we don't support backward scans */
+	Assert(ScanDirectionIsForward(estate->es_direction));
+
+	for (;;)
+	{
+		/* Return the next tuple of the current group, if any */
+		if (node->group_Done)
+		{
+			tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
+			if (tuplesort_gettupleslot(tuplesortstate, true, slot))
+			{
+				node->tuples_returned++;
+				return slot;
+			}
+			node->group_Done = false;
+		}
+
+		/* Done if the input is exhausted, or we've returned enough tuples */
+		if (node->outer_Done ||
+			(node->bounded && node->tuples_returned >= node->bound))
+			return ExecClearTuple(slot);
+
+		/*
+		 * Fetch the first tuple of the first group, if we haven't got it yet.
+		 */
+		if (TupIsNull(pivot))
+		{
+			TupleTableSlot *outerslot = ExecProcNode(outerNode);
+
+			if (TupIsNull(outerslot))
+			{
+				node->outer_Done = true;
+				return ExecClearTuple(slot);
+			}
+			ExecCopySlot(pivot, outerslot);
+		}
+
+		/*
+		 * Start a new sort for the group, on the columns after the presorted
+		 * ones.  If a LIMIT applies, the group sort need only keep as many
+		 * tuples as are still required.
+		 */
+		SO1_printf("ExecIncrementalSort: %s\n", "sorting next group");
+
+		if (node->tuplesortstate == NULL)
+		{
+			int			presortedCols = plannode->presortedCols;
+
+			tuplesortstate =
+				tuplesort_begin_heap(ExecGetResultType(outerNode),
+									 plannode->sort.numCols - presortedCols,
+									 plannode->sort.sortColIdx + presortedCols,
+								 plannode->sort.sortOperators + presortedCols,
+									 plannode->sort.nullsFirst + presortedCols,
+									 work_mem,
+									 false);
+			node->tuplesortstate = (void *) tuplesortstate;
+		}
+		else
+		{
+			tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
+			tuplesort_reset(tuplesortstate);
+		}
+		if (node->bounded)
+			tuplesort_set_bound(tuplesortstate,
+								node->bound - node->tuples_returned);
+
+		tuplesort_puttupleslot(tuplesortstate, pivot);
+
+		/*
+		 * Feed tuples to tuplesort until we see one that doesn't belong to
+		 * the group; it becomes the first tuple of the next group.
+		 */
+		for (;;)
+		{
+			TupleTableSlot *outerslot = ExecProcNode(outerNode);
+
+			if (TupIsNull(outerslot))
+			{
+				node->outer_Done = true;
+				ExecClearTuple(pivot);
+				break;
+			}
+
+			if (!execTuplesMatch(pivot, outerslot,
+								 plannode->presortedCols,
+								 plannode->sort.sortColIdx,
+								 node->eqfunctions,
+								 econtext->ecxt_per_tuple_memory))
+			{
+				ExecCopySlot(pivot, outerslot);
+				break;
+			}
+
+			tuplesort_puttupleslot(tuplesortstate, outerslot);
+		}
+
+		tuplesort_performsort(tuplesortstate);
+		node->group_Done = true;
+		node->groups_sorted++;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitIncrementalSort
+ *
+ *		Creates the run-time state information for the incremental sort
+ *		node produced by the planner and initializes its outer subtree.
+ * ----------------------------------------------------------------
+ */
+IncrementalSortState *
+ExecInitIncrementalSort(IncrementalSort *node, EState *estate, int eflags)
+{
+	IncrementalSortState *incrsortstate;
+	Oid		   *eqOperators;
+	int			i;
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "initializing incremental sort node");
+
+	/* check for unsupported flags */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	incrsortstate = makeNode(IncrementalSortState);
+	incrsortstate->ss.ps.plan = (Plan *) node;
+	incrsortstate->ss.ps.state = estate;
+
+	incrsortstate->bounded = false;
+	incrsortstate->group_Done = false;
+	incrsortstate->outer_Done = false;
+	incrsortstate->tuples_returned = 0;
+	incrsortstate->groups_sorted = 0;
+	incrsortstate->tuplesortstate = NULL;
+
+	/*
+	 * create expression context, used as scratch space for comparing the
+	 * presorted columns
+	 */
+	ExecAssignExprContext(estate, &incrsortstate->ss.ps);
+
+	/*
+	 * tuple table initialization
+	 *
+	 * The scan tuple slot holds the first tuple of the next group.
+	 */
+	ExecInitResultTupleSlot(estate, &incrsortstate->ss.ps);
+	ExecInitScanTupleSlot(estate, &incrsortstate->ss);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND; we always
+	 * rescan it rather than saving our output.
+	 */
+	eflags &= ~EXEC_FLAG_REWIND;
+
+	outerPlanState(incrsortstate) = ExecInitNode(outerPlan(node), estate,
+												 eflags);
+
+	/*
+	 * initialize tuple type.  no need to initialize projection info because
+	 * this node doesn't do projections.
+	 */
+	ExecAssignResultTypeFromTL(&incrsortstate->ss.ps);
+	ExecAssignScanTypeFromOuterPlan(&incrsortstate->ss);
+	incrsortstate->ss.ps.ps_ProjInfo = NULL;
+
+	/*
+	 * Look up the equality operators for the presorted columns, and
+	 * precompute fmgr lookup data for them.
+	 */
+	Assert(node->presortedCols > 0 &&
+		   node->presortedCols < node->sort.numCols);
+	eqOperators = (Oid *) palloc(node->presortedCols * sizeof(Oid));
+	for (i = 0; i < node->presortedCols; i++)
+	{
+		eqOperators[i] =
+			get_equality_op_for_ordering_op(node->sort.sortOperators[i],
+											NULL);
+		if (!OidIsValid(eqOperators[i]))
+			elog(ERROR, "could not find equality operator for ordering operator %u",
+				 node->sort.sortOperators[i]);
+	}
+	incrsortstate->eqfunctions = execTuplesMatchPrepare(node->presortedCols,
+														eqOperators);
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "incremental sort node initialized");
+
+	return incrsortstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndIncrementalSort(node)
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndIncrementalSort(IncrementalSortState *node)
+{
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "shutting down incremental sort node");
+
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+
+	/*
+	 * Release tuplesort resources
+	 */
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "incremental sort node shutdown");
+}
+
+void
+ExecReScanIncrementalSort(IncrementalSortState *node, ExprContext *exprCtxt)
+{
+	/*
+	 * We don't keep the output of earlier groups, so we must always re-read
+	 * the subplan from the start.
+	 */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+
+	node->group_Done = false;
+	node->outer_Done = false;
+	node->tuples_returned = 0;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (((PlanState *) node)->lefttree->chgParam == NULL)
+		ExecReScan(((PlanState *) node)->lefttree, exprCtxt);
+}
@@ -27,15 +27,21 @@
 #include "access/genam.h"
 #include "access/nbtree.h"
 #include "access/relscan.h"
+#include "access/visibilitymap.h"
 #include "executor/execdebug.h"
 #include "executor/nodeIndexscan.h"
 #include "optimizer/clauses.h"
+#include "storage/bufmgr.h"
 #include "utils/array.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/tqual.h"
 
 
 static TupleTableSlot *IndexNext(IndexScanState *node);
+static TupleTableSlot *IndexOnlyNext(IndexScanState *node);
+static void StoreIndexTuple(TupleTableSlot *slot, IndexTuple itup,
+				Relation indexRel);
 
 
 /* ----------------------------------------------------------------
@@ -72,6 +78,9 @@ IndexNext(IndexScanState *node)
 	econtext = node->ss.ps.ps_ExprContext;
 	slot = node->ss.ss_ScanTupleSlot;
 
+	if (node->iss_IndexOnly)
+		return IndexOnlyNext(node);
+
 	/*
 	 * ok, now that we have what we need, fetch the next tuple.
 	 */
@@ -109,6 +118,151 @@ IndexNext(IndexScanState *node)
 	return ExecClearTuple(slot);
 }
 
+/* ----------------------------------------------------------------
+ *		IndexOnlyNext
+ *
+ *		Like IndexNext, but for an index-only scan: if the visibility map
+ *		says the heap page holding the tuple is all-visible, the column
+ *		values are taken from the index tuple and the heap isn't visited.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+IndexOnlyNext(IndexScanState *node)
+{
+	EState	   *estate;
+	ExprContext *econtext;
+	ScanDirection direction;
+	IndexScanDesc scandesc;
+	HeapTuple	tuple;
+	TupleTableSlot *slot;
+	ItemPointer tid;
+
+	/*
+	 * extract necessary information from index scan node
+	 */
+	estate = node->ss.ps.state;
+	direction = estate->es_direction;
+	/* flip direction if this is an overall backward scan */
+	if (ScanDirectionIsBackward(((IndexScan *) node->ss.ps.plan)->indexorderdir))
+	{
+		if (ScanDirectionIsForward(direction))
+			direction = BackwardScanDirection;
+		else if (ScanDirectionIsBackward(direction))
+			direction = ForwardScanDirection;
+	}
+	scandesc = node->iss_ScanDesc;
+	econtext = node->ss.ps.ps_ExprContext;
+	slot = node->ss.ss_ScanTupleSlot;
+
+	/*
+	 * OK, now that we have what we need, fetch the next tuple.
+	 */
+	while ((tid = index_getnext_tid(scandesc, direction)) != NULL)
+	{
+		/*
+		 * We can skip the heap fetch if the TID references a heap page on
+		 * which all tuples are known visible to everybody.  In any case,
+		 * we'll use the index tuple not the heap tuple as the data source.
+		 *
+		 * Note on memory ordering: we don't take a lock on the visibility
+		 * map buffer.  See the comments at the top of visibilitymap.c for
+		 * why that's safe: a transaction that could make the tuple invisible
+		 * to us must have cleared the bit before we could see its index
+		 * entry.
+		 */
+		if (!visibilitymap_test(scandesc->heapRelation,
+								ItemPointerGetBlockNumber(tid),
+								&node->iss_VMBuffer))
+		{
+			/*
+			 * Rats, we have to visit the heap to check visibility.
+			 */
+			node->iss_HeapFetches++;
+			tuple = index_fetch_heap(scandesc);
+			if (tuple == NULL)
+				continue;		/* no visible tuple, try next index entry */
+
+			/*
+			 * Only MVCC snapshots are supported here, so there should be no
+			 * need to keep following the HOT chain once a visible entry has
+			 * been found.
+			 */
+			Assert(scandesc->xs_next_hot == InvalidOffsetNumber);
+		}
+
+		/*
+		 * Fill the scan tuple slot with data from the index.
+		 */
+		StoreIndexTuple(slot, scandesc->xs_itup, scandesc->indexRelation);
+
+		/*
+		 * If the index was lossy, we have to recheck the index quals.  The
+		 * index columns are all we need for that, so the slot will do.
+		 */
+		if (scandesc->xs_recheck)
+		{
+			econtext->ecxt_scantuple = slot;
+			ResetExprContext(econtext);
+			if (!ExecQual(node->indexqualorig, econtext, false))
+				continue;		/* nope, so ask index for another one */
+		}
+
+		return slot;
+	}
+
+	/*
+	 * if we get here it means the index scan failed so we are at the end of
+	 * the scan..
+	 */
+	return ExecClearTuple(slot);
+}
+
+/*
+ * StoreIndexTuple
+ *		Fill the slot with data from the index tuple.
+ *
+ * The slot has the heap relation's rowtype.  The planner has made sure that
+ * the only columns referenced are plain index columns, so we fill those in
+ * and leave the rest NULL.
+ */
+static void
+StoreIndexTuple(TupleTableSlot *slot, IndexTuple itup, Relation indexRel)
+{
+	TupleDesc	itupdesc = RelationGetDescr(indexRel);
+	int2vector *indkey = &indexRel->rd_index->indkey;
+	Datum	   *values = slot->tts_values;
+	bool	   *isnull = slot->tts_isnull;
+	int			natts = slot->tts_tupleDescriptor->natts;
+	int			i;
+
+	/*
+	 * Note: we must use the values/isnull arrays of the slot itself, since
+	 * the datums point into the index AM's workspace and stay valid until
+	 * the next index_getnext_tid call, which is exactly as long as the slot
+	 * contents are needed.
+	 */
+	ExecClearTuple(slot);
+	memset(values, 0, natts * sizeof(Datum));
+	memset(isnull, true, natts * sizeof(bool));
+
+	for (i = 0; i < itupdesc->natts; i++)
+	{
+		int			attno = indkey->values[i];
+
+		/*
+		 * An expression column doesn't correspond to any heap column; the
+		 * planner has made sure the query doesn't need its inputs.
+		 */
+		if (attno == 0)
+			continue;
+		Assert(attno > 0 && attno <= natts);
+		values[attno - 1] = index_getattr(itup, i + 1, itupdesc,
+										  &isnull[attno - 1]);
+	}
+
+	ExecStoreVirtualTuple(slot);
+}
+
 /*
  * IndexRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
@@ -427,6 +581,13 @@ ExecEndIndexScan(IndexScanState *node)
 	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
 
+	/* Release VM buffer pin, if any. */
+	if (node->iss_VMBuffer != InvalidBuffer)
+	{
+		ReleaseBuffer(node->iss_VMBuffer);
+		node->iss_VMBuffer = InvalidBuffer;
+	}
+
 	/*
 	 * close the index relation (no-op if we didn't open it)
 	 */
@@ -485,6 +646,9 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 	indexstate = makeNode(IndexScanState);
 	indexstate->ss.ps.plan = (Plan *) node;
 	indexstate->ss.ps.state = estate;
+	indexstate->iss_IndexOnly = false;
+	indexstate->iss_VMBuffer = InvalidBuffer;
+	indexstate->iss_HeapFetches = 0;
 
 	/*
 	 * Miscellaneous initialization
@@ -605,6 +769,18 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 											   indexstate->iss_NumScanKeys,
 											   indexstate->iss_ScanKeys);
 
+	/*
+	 * If the plan asks for an index-only scan, tell the index AM to return
+	 * index tuples.  The visibility map only tells us about visibility to
+	 * MVCC snapshots, so with any other kind we scan normally; that still
+	 * works since the quals and targetlist reference the heap's columns.
+	 */
+	if (node->indexonly && IsMVCCSnapshot(estate->es_snapshot))
+	{
+		indexstate->iss_IndexOnly = true;
+		indexstate->iss_ScanDesc->xs_want_itup = true;
+	}
+
 	/*
 	 * all done.
 	 */
@@ -294,18 +294,18 @@ recompute_limits(LimitState *node)
 	node->lstate = LIMIT_RESCAN;
 
 	/*
-	 * If we have a COUNT, and our input is a Sort node, notify it that it can
-	 * use bounded sort.
+	 * If we have a COUNT, and our input is a Sort or IncrementalSort node,
+	 * notify it that it can use bounded sort.
 	 *
 	 * This is a bit of a kluge, but we don't have any more-abstract way of
 	 * communicating between the two nodes; and it doesn't seem worth trying
 	 * to invent one without some more examples of special communication
 	 * needs.
 	 *
-	 * Note: it is the responsibility of nodeSort.c to react properly to
-	 * changes of these parameters.  If we ever do redesign this, it'd be a
-	 * good idea to integrate this signaling with the parameter-change
-	 * mechanism.
+	 * Note: it is the responsibility of nodeSort.c and nodeIncrementalSort.c
+	 * to react properly to changes of these parameters.  If we ever do
+	 * redesign this, it'd be a good idea to integrate this signaling with the
+	 * parameter-change mechanism.
 	 */
 	if (IsA(outerPlanState(node), SortState))
 	{
@@ -324,6 +324,20 @@ recompute_limits(LimitState *node)
 			sortState->bound = tuples_needed;
 		}
 	}
+	else if (IsA(outerPlanState(node), IncrementalSortState))
+	{
+		IncrementalSortState *sortState = (IncrementalSortState *) outerPlanState(node);
+		int64		tuples_needed = node->count + node->offset;
+
+		/* negative test checks for overflow */
+		if (node->noCount || tuples_needed < 0)
+			sortState->bounded = false;
+		else
+		{
+			sortState->bounded = true;
+			sortState->bound = tuples_needed;
+		}
+	}
 }
 
 /* ----------------------------------------------------------------
@@ -26,10 +26,19 @@
 
 #include "access/heapam.h"
 #include "access/relscan.h"
+#include "access/skey.h"
+#include "access/valid.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
-
-static void InitScanRelation(SeqScanState *node, EState *estate);
+#include "optimizer/planmain.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/tqual.h"
+
+static List *SeqScanExtractKeys(SeqScan *plan, ScanKey *scankeys,
+				   int *numkeys);
+static void InitScanRelation(SeqScanState *node, EState *estate,
+				 ScanKey scankeys, int numkeys);
 static TupleTableSlot *SeqNext(SeqScanState *node);
 
 /* ----------------------------------------------------------------
@@ -91,11 +100,25 @@ SeqNext(SeqScanState *node)
 static bool
 SeqRecheck(SeqScanState *node, TupleTableSlot *slot)
 {
+	HeapScanDesc scan = node->ss_currentScanDesc;
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	MemoryContext oldcxt;
+	bool		result;
+
 	/*
-	 * Note that unlike IndexScan, SeqScan never use keys in heap_beginscan
-	 * (and this is very bad) - so, here we do not check are keys ok or not.
+	 * Quals that were turned into heap scan keys by ExecInitSeqScan are not
+	 * in ps.qual, so we must recheck them here against the new tuple version.
+	 * Like ExecQual, evaluate them in the per-tuple context.
 	 */
-	return true;
+	if (scan->rs_nkeys <= 0)
+		return true;
+
+	oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	HeapKeyTest(ExecFetchSlotTuple(slot), RelationGetDescr(scan->rs_rd),
+				scan->rs_nkeys, scan->rs_key, result);
+	MemoryContextSwitchTo(oldcxt);
+
+	return result;
 }
 
 /* ----------------------------------------------------------------
@@ -115,6 +138,151 @@ ExecSeqScan(SeqScanState *node)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		SeqScanExtractKeys
+ *
+ *		Separates out the qual clauses that heapam can evaluate for us.
+ *
+ *		A clause of the form "var op const", where var is a column of the
+ *		scanned relation and op is a strict btree comparison operator whose
+ *		function takes exactly the var's and const's types, is converted
+ *		into a heap scan key.  heapgettup_pagemode then tests those keys
+ *		while it holds the page, so tuples that fail them are never stored
+ *		into the scan slot nor passed through ExecQual.  Clauses with the
+ *		constant on the left are commuted if possible.
+ *
+ *		Returns the list of clauses that must still be evaluated by ExecQual;
+ *		the keys are returned in *scankeys and *numkeys.
+ * ----------------------------------------------------------------
+ */
+static List *
+SeqScanExtractKeys(SeqScan *plan, ScanKey *scankeys, int *numkeys)
+{
+	List	   *qual = plan->plan.qual;
+	List	   *remaining = NIL;
+	ScanKey		keys;
+	int			n_keys = 0;
+	ListCell   *lc;
+
+	*scankeys = NULL;
+	*numkeys = 0;
+
+	if (qual == NIL)
+		return NIL;
+
+	keys = (ScanKey) palloc(list_length(qual) * sizeof(ScanKeyData));
+
+	foreach(lc, qual)
+	{
+		Expr	   *clause = (Expr *) lfirst(lc);
+		OpExpr	   *op;
+		Node	   *leftop;
+		Node	   *rightop;
+		Var		   *var;
+		Const	   *con;
+		Oid			opno;
+		Oid			opfuncid;
+		List	   *opfamilies;
+		List	   *opstrats;
+		Oid		   *argtypes;
+		int			nargs;
+
+		if (!IsA(clause, OpExpr) ||
+			list_length(((OpExpr *) clause)->args) != 2)
+		{
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+		op = (OpExpr *) clause;
+		leftop = (Node *) linitial(op->args);
+		rightop = (Node *) lsecond(op->args);
+		opno = op->opno;
+
+		if (IsA(leftop, Var) && IsA(rightop, Const))
+		{
+			var = (Var *) leftop;
+			con = (Const *) rightop;
+		}
+		else if (IsA(leftop, Const) && IsA(rightop, Var))
+		{
+			var = (Var *) rightop;
+			con = (Const *) leftop;
+			opno = get_commutator(opno);
+		}
+		else
+		{
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+
+		/* A null constant is left to ExecQual; it's not worth a scan key */
+		if (!OidIsValid(opno) ||
+			var->varno != plan->scanrelid ||
+			var->varlevelsup != 0 ||
+			var->varattno <= 0 ||
+			con->constisnull)
+		{
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+
+		/*
+		 * Restrict ourselves to btree comparison operators: they can't fail
+		 * on valid input and don't care about evaluation order, so running
+		 * them ahead of the other quals is safe.
+		 */
+		get_op_btree_interpretation(opno, &opfamilies, &opstrats);
+		if (opfamilies == NIL)
+		{
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+		list_free(opfamilies);
+		list_free(opstrats);
+
+		opfuncid = get_opcode(opno);
+		if (!OidIsValid(opfuncid) || !func_strict(opfuncid))
+		{
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+
+		/*
+		 * HeapKeyTest passes the raw attribute datum to the function, so
+		 * the function must accept the column's type without any coercion.
+		 */
+		get_func_signature(opfuncid, &argtypes, &nargs);
+		if (nargs != 2 ||
+			argtypes[0] != var->vartype ||
+			argtypes[1] != con->consttype)
+		{
+			pfree(argtypes);
+			remaining = lappend(remaining, clause);
+			continue;
+		}
+		pfree(argtypes);
+
+		ScanKeyInit(&keys[n_keys],
+					var->varattno,
+					InvalidStrategy,
+					opfuncid,
+					con->constvalue);
+		n_keys++;
+	}
+
+	if (n_keys == 0)
+	{
+		pfree(keys);
+		list_free(remaining);
+		return qual;
+	}
+
+	*scankeys = keys;
+	*numkeys = n_keys;
+
+	return remaining;
+}
+
 /* ----------------------------------------------------------------
  *		InitScanRelation
  *
@@ -123,7 +291,8 @@ ExecSeqScan(SeqScanState *node)
  * ----------------------------------------------------------------
  */
 static void
-InitScanRelation(SeqScanState *node, EState *estate)
+InitScanRelation(SeqScanState *node, EState *estate,
+				 ScanKey scankeys, int numkeys)
 {
 	Relation	currentRelation;
 	HeapScanDesc currentScanDesc;
@@ -137,8 +306,21 @@ InitScanRelation(SeqScanState *node, EState *estate)
 
 	currentScanDesc = heap_beginscan(currentRelation,
 									 estate->es_snapshot,
-									 0,
-									 NULL);
+									 numkeys,
+									 scankeys);
+
+	/*
+	 * The key functions may allocate memory, for instance when detoasting a
+	 * column value, so have them run in a context that heapam resets after
+	 * each tuple.
+	 */
+	if (numkeys > 0)
+		heap_setscankeycxt(currentScanDesc,
+						   AllocSetContextCreate(CurrentMemoryContext,
+												 "SeqScan keys",
+												 ALLOCSET_SMALL_MINSIZE,
+												 ALLOCSET_SMALL_INITSIZE,
+												 ALLOCSET_SMALL_MAXSIZE));
 
 	node->ss_currentRelation = currentRelation;
 	node->ss_currentScanDesc = currentScanDesc;
@@ -155,6 +337,9 @@ SeqScanState *
 ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 {
 	SeqScanState *scanstate;
+	List	   *qual;
+	ScanKey		scankeys;
+	int			numkeys;
 
 	/*
 	 * Once upon a time it was possible to have an outerPlan of a SeqScan, but
@@ -178,13 +363,26 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	ExecAssignExprContext(estate, &scanstate->ps);
 
 	/*
-	 * initialize child expressions
+	 * initialize child expressions.  Simple comparisons against constants
+	 * are handed to the heap scan as scan keys; only the rest of the qual
+	 * needs to be evaluated by ExecQual.  That's only done for MVCC
+	 * snapshots, because only page-at-a-time scans test the keys without
+	 * holding the buffer content lock.
 	 */
+	if (IsMVCCSnapshot(estate->es_snapshot))
+		qual = SeqScanExtractKeys(node, &scankeys, &numkeys);
+	else
+	{
+		qual = node->plan.qual;
+		scankeys = NULL;
+		numkeys = 0;
+	}
+
 	scanstate->ps.targetlist = (List *)
 		ExecInitExpr((Expr *) node->plan.targetlist,
 					 (PlanState *) scanstate);
 	scanstate->ps.qual = (List *)
-		ExecInitExpr((Expr *) node->plan.qual,
+		ExecInitExpr((Expr *) qual,
 					 (PlanState *) scanstate);
 
 	/*
@@ -196,7 +394,7 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	/*
 	 * initialize scan relation
 	 */
-	InitScanRelation(scanstate, estate);
+	InitScanRelation(scanstate, estate, scankeys, numkeys);
 
 	scanstate->ps.ps_TupFromTlist = false;
 
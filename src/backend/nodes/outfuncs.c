@@ -413,6 +413,7 @@ _outIndexScan(StringInfo str, IndexScan *node)
 	WRITE_NODE_FIELD(indexqual);
 	WRITE_NODE_FIELD(indexqualorig);
 	WRITE_ENUM_FIELD(indexorderdir, ScanDirection);
+	WRITE_BOOL_FIELD(indexonly);
 }
 
 static void
@@ -666,6 +667,32 @@ _outSort(StringInfo str, Sort *node)
 		appendStringInfo(str, " %s", booltostr(node->nullsFirst[i]));
 }
 
+static void
+_outIncrementalSort(StringInfo str, IncrementalSort *node)
+{
+	int			i;
+
+	WRITE_NODE_TYPE("INCREMENTALSORT");
+
+	_outPlanInfo(str, (Plan *) node);
+
+	appendStringInfo(str, " :numCols %d", node->sort.numCols);
+
+	appendStringInfo(str, " :sortColIdx");
+	for (i = 0; i < node->sort.numCols; i++)
+		appendStringInfo(str, " %d", node->sort.sortColIdx[i]);
+
+	appendStringInfo(str, " :sortOperators");
+	for (i = 0; i < node->sort.numCols; i++)
+		appendStringInfo(str, " %u", node->sort.sortOperators[i]);
+
+	appendStringInfo(str, " :nullsFirst");
+	for (i = 0; i < node->sort.numCols; i++)
+		appendStringInfo(str, " %s", booltostr(node->sort.nullsFirst[i]));
+
+	WRITE_INT_FIELD(presortedCols);
+}
+
 static void
 _outUnique(StringInfo str, Unique *node)
 {
@@ -1384,6 +1411,7 @@ _outIndexPath(StringInfo str, IndexPath *node)
 	WRITE_NODE_FIELD(indexclauses);
 	WRITE_NODE_FIELD(indexquals);
 	WRITE_BOOL_FIELD(isjoininner);
+	WRITE_BOOL_FIELD(indexonly);
 	WRITE_ENUM_FIELD(indexscandir, ScanDirection);
 	WRITE_FLOAT_FIELD(indextotalcost, "%.2f");
 	WRITE_FLOAT_FIELD(indexselectivity, "%.4f");
@@ -1599,6 +1627,7 @@ _outRelOptInfo(StringInfo str, RelOptInfo *node)
 	WRITE_NODE_FIELD(indexlist);
 	WRITE_UINT_FIELD(pages);
 	WRITE_FLOAT_FIELD(tuples, "%.0f");
+	WRITE_FLOAT_FIELD(allvisfrac, "%.6f");
 	WRITE_NODE_FIELD(subplan);
 	WRITE_NODE_FIELD(subrtable);
 	WRITE_NODE_FIELD(subrowmark);
@@ -2556,6 +2585,9 @@ _outNode(StringInfo str, void *obj)
 			case T_Sort:
 				_outSort(str, obj);
 				break;
+			case T_IncrementalSort:
+				_outIncrementalSort(str, obj);
+				break;
 			case T_Unique:
 				_outUnique(str, obj);
 				break;
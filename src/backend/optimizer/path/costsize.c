@@ -109,9 +109,11 @@ Cost		disable_cost = 1.0e10;
 
 bool		enable_seqscan = true;
 bool		enable_indexscan = true;
+bool		enable_indexonlyscan = true;
 bool		enable_bitmapscan = true;
 bool		enable_tidscan = true;
 bool		enable_sort = true;
+bool		enable_incrementalsort = true;
 bool		enable_hashagg = true;
 bool		enable_nestloop = true;
 bool		enable_mergejoin = true;
@@ -309,6 +311,13 @@ cost_index(IndexPath *path, PlannerInfo *root,
 	 * For partially-correlated indexes, we ought to charge somewhere between
 	 * these two estimates.  We currently interpolate linearly between the
 	 * estimates based on the correlation squared (XXX is that appropriate?).
+	 *
+	 * If it's an index-only scan, then we will not need to fetch any heap
+	 * pages for which the visibility map shows all tuples are visible.
+	 * Hence, reduce the estimated number of heap fetches accordingly.
+	 * We use the measured fraction of the entire heap that is all-visible,
+	 * which might not be particularly relevant to the subset of the heap
+	 * that this query will fetch; but it's not clear how to do better.
 	 *----------
 	 */
 	if (outer_rel != NULL && outer_rel->rows > 1)
@@ -328,6 +337,9 @@ cost_index(IndexPath *path, PlannerInfo *root,
 											(double) index->pages,
 											root);
 
+		if (path->indexonly)
+			pages_fetched = ceil(pages_fetched * (1.0 - baserel->allvisfrac));
+
 		max_IO_cost = (pages_fetched * spc_random_page_cost) / num_scans;
 
 		/*
@@ -347,6 +359,9 @@ cost_index(IndexPath *path, PlannerInfo *root,
 											(double) index->pages,
 											root);
 
+		if (path->indexonly)
+			pages_fetched = ceil(pages_fetched * (1.0 - baserel->allvisfrac));
+
 		min_IO_cost = (pages_fetched * spc_random_page_cost) / num_scans;
 	}
 	else
@@ -360,14 +375,26 @@ cost_index(IndexPath *path, PlannerInfo *root,
 											(double) index->pages,
 											root);
 
+		if (path->indexonly)
+			pages_fetched = ceil(pages_fetched * (1.0 - baserel->allvisfrac));
+
 		/* max_IO_cost is for the perfectly uncorrelated case (csquared=0) */
 		max_IO_cost = pages_fetched * spc_random_page_cost;
 
 		/* min_IO_cost is for the perfectly correlated case (csquared=1) */
 		pages_fetched = ceil(indexSelectivity * (double) baserel->pages);
-		min_IO_cost = spc_random_page_cost;
-		if (pages_fetched > 1)
-			min_IO_cost += (pages_fetched - 1) * spc_seq_page_cost;
+
+		if (path->indexonly)
+			pages_fetched = ceil(pages_fetched * (1.0 - baserel->allvisfrac));
+
+		if (pages_fetched > 0)
+		{
+			min_IO_cost = spc_random_page_cost;
+			if (pages_fetched > 1)
+				min_IO_cost += (pages_fetched - 1) * spc_seq_page_cost;
+		}
+		else
+			min_IO_cost = 0;
 	}
 
 	/*
@@ -1079,8 +1106,8 @@ cost_recursive_union(Plan *runion, Plan *nrterm, Plan *rterm)
  * total, but we will also need to write and read each tuple once per
  * merge pass.	We expect about ceil(logM(r)) merge passes where r is the
  * number of initial runs formed and M is the merge order used by tuplesort.c.
- * Since the average initial run should be about twice work_mem, we have
- *		disk traffic = 2 * relsize * ceil(logM(p / (2*work_mem)))
+ * Since each initial run is one sorted work_mem-load of tuples, we have
+ *		disk traffic = 2 * relsize * ceil(logM(p / work_mem))
  *		cpu = comparison_cost * t * log2(t)
  *
  * If the sort is bounded (i.e., only the first k result tuples are needed)
@@ -1146,7 +1173,7 @@ cost_sort(Path *path, PlannerInfo *root,
 		 * We'll have to use a disk-based sort of all the tuples
 		 */
 		double		npages = ceil(input_bytes / BLCKSZ);
-		double		nruns = (input_bytes / work_mem_bytes) * 0.5;
+		double		nruns = input_bytes / work_mem_bytes;
 		double		mergeorder = tuplesort_merge_order(work_mem_bytes);
 		double		log_runs;
 		double		npageaccesses;
@@ -1201,6 +1228,107 @@ cost_sort(Path *path, PlannerInfo *root,
 	path->total_cost = startup_cost + run_cost;
 }
 
+/*
+ * cost_incremental_sort
+ *	  Determines and returns the cost of sorting a relation that is already
+ *	  sorted by a leading subset of the required sort keys.
+ *
+ * An incremental sort reads the input one group of tuples with equal values
+ * in the presorted keys at a time, and sorts each group by the remaining keys
+ * independently.  We estimate the number of groups from the presorted key
+ * expressions and assume the groups are all of about the same size.  Only
+ * the first group has to be read and sorted before the first tuple can be
+ * returned, which is what makes this attractive under a LIMIT.
+ *
+ * On top of the per-group sorts, we charge one operator eval per presorted
+ * key per input tuple, for comparing each tuple to the current group.
+ *
+ * 'pathkeys' is the list of sort keys; the first 'presorted_keys' of them
+ *		are already satisfied by the input
+ * 'input_startup_cost', 'input_total_cost' are the costs of the input
+ * 'tuples', 'width' and 'limit_tuples' are as for cost_sort
+ */
+void
+cost_incremental_sort(Path *path, PlannerInfo *root,
+					  List *pathkeys, int presorted_keys,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double tuples, int width, double limit_tuples)
+{
+	Cost		startup_cost;
+	Cost		run_cost;
+	Cost		group_startup_cost;
+	Cost		group_run_cost;
+	Path		sort_path;		/* dummy for result of cost_sort */
+	List	   *presortedExprs = NIL;
+	double		num_groups;
+	double		group_tuples;
+	ListCell   *l;
+	int			i = 0;
+
+	Assert(presorted_keys > 0 && presorted_keys < list_length(pathkeys));
+
+	if (tuples < 2.0)
+		tuples = 2.0;
+
+	/*
+	 * Collect an expression for each presorted key; any non-constant member
+	 * of the pathkey's EquivalenceClass will do.
+	 */
+	foreach(l, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(l);
+		ListCell   *lc;
+
+		if (i++ >= presorted_keys)
+			break;
+
+		foreach(lc, pathkey->pk_eclass->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+
+			if (em->em_is_const || em->em_is_child)
+				continue;
+			presortedExprs = lappend(presortedExprs, em->em_expr);
+			break;
+		}
+	}
+
+	if (list_length(presortedExprs) == presorted_keys)
+		num_groups = estimate_num_groups(root, presortedExprs, tuples);
+	else
+		num_groups = Min(tuples, DEFAULT_NUM_DISTINCT);
+	list_free(presortedExprs);
+
+	if (num_groups < 1.0)
+		num_groups = 1.0;
+	group_tuples = tuples / num_groups;
+
+	/* Cost of sorting one average-sized group */
+	cost_sort(&sort_path, root, NIL, 0.0, group_tuples, width, -1.0);
+	group_startup_cost = sort_path.startup_cost;
+	group_run_cost = sort_path.total_cost - sort_path.startup_cost;
+
+	/*
+	 * Before returning the first tuple we must have read the first group
+	 * (plus the first tuple of the next one) and sorted it.
+	 */
+	startup_cost = input_startup_cost +
+		(input_total_cost - input_startup_cost) / num_groups +
+		group_startup_cost;
+
+	run_cost = (input_total_cost - input_startup_cost) *
+		(1.0 - 1.0 / num_groups);
+	run_cost += group_run_cost + (num_groups - 1.0) *
+		(group_startup_cost + group_run_cost);
+	run_cost += cpu_operator_cost * presorted_keys * tuples;
+
+	if (!enable_incrementalsort)
+		startup_cost += disable_cost;
+
+	path->startup_cost = startup_cost;
+	path->total_cost = startup_cost + run_cost;
+}
+
 /*
  * cost_material
  *	  Determines and returns the cost of materializing a relation, including
@@ -18,6 +18,7 @@
 #include <math.h>
 
 #include "access/skey.h"
+#include "access/sysattr.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_opfamily.h"
@@ -296,6 +297,7 @@ find_usable_indexes(PlannerInfo *root, RelOptInfo *rel,
 		bool		useful_predicate;
 		bool		found_clause;
 		bool		index_is_ordered;
+		bool		index_only_scan;
 
 		/*
 		 * Check that index supports the desired scan type(s)
@@ -398,12 +400,22 @@ find_usable_indexes(PlannerInfo *root, RelOptInfo *rel,
 			useful_pathkeys = NIL;
 
 		/*
-		 * 3. Generate an indexscan path if there are relevant restriction
+		 * 3. Check if an index-only scan is possible.  This is pointless for
+		 * a bitmap scan, which always visits the heap.
+		 */
+		index_only_scan = (scantype != ST_BITMAPSCAN &&
+						   check_index_only(rel, index));
+
+		/*
+		 * 4. Generate an indexscan path if there are relevant restriction
 		 * clauses in the current clauses, OR the index ordering is
 		 * potentially useful for later merging or final output ordering, OR
-		 * the index has a predicate that was proven by the current clauses.
+		 * the index has a predicate that was proven by the current clauses,
+		 * OR an index-only scan is possible at top level (a full scan of the
+		 * index may well be cheaper than a seqscan of the heap).
 		 */
-		if (found_clause || useful_pathkeys != NIL || useful_predicate)
+		if (found_clause || useful_pathkeys != NIL || useful_predicate ||
+			(index_only_scan && istoplevel))
 		{
 			ipath = create_index_path(root, index,
 									  restrictclauses,
@@ -411,12 +423,13 @@ find_usable_indexes(PlannerInfo *root, RelOptInfo *rel,
 									  index_is_ordered ?
 									  ForwardScanDirection :
 									  NoMovementScanDirection,
+									  index_only_scan,
 									  outer_rel);
 			result = lappend(result, ipath);
 		}
 
 		/*
-		 * 4. If the index is ordered, a backwards scan might be interesting.
+		 * 5. If the index is ordered, a backwards scan might be interesting.
 		 * Again, this is only interesting at top level.
 		 */
 		if (index_is_ordered && possibly_useful_pathkeys &&
@@ -432,6 +445,7 @@ find_usable_indexes(PlannerInfo *root, RelOptInfo *rel,
 										  restrictclauses,
 										  useful_pathkeys,
 										  BackwardScanDirection,
+										  index_only_scan,
 										  outer_rel);
 				result = lappend(result, ipath);
 			}
@@ -442,6 +456,66 @@ find_usable_indexes(PlannerInfo *root, RelOptInfo *rel,
 }
 
 
+/*
+ * check_index_only
+ *		Determine whether an index-only scan is possible for this index.
+ *
+ * That requires that the index AM can return index tuples, and that every
+ * column of the relation that the query needs, whether for output, for a
+ * join, or to evaluate a restriction clause, is stored as a plain column of
+ * the index.  Expression columns can't be used to reconstruct heap columns,
+ * and system columns are never available from an index.
+ */
+bool
+check_index_only(RelOptInfo *rel, IndexOptInfo *index)
+{
+	bool		result;
+	Bitmapset  *attrs_used = NULL;
+	Bitmapset  *index_attrs = NULL;
+	ListCell   *lc;
+	int			i;
+
+	/* Index-only scans must be enabled, and index must be capable of them */
+	if (!enable_indexonlyscan)
+		return false;
+	if (!index->amcanreturn)
+		return false;
+
+	/* Collect the columns used in the rel's targetlist */
+	pull_varattnos((Node *) rel->reltargetlist, rel->relid, &attrs_used);
+
+	/* Add all the columns used by restriction clauses */
+	foreach(lc, rel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		pull_varattnos((Node *) rinfo->clause, rel->relid, &attrs_used);
+	}
+
+	/* Construct a bitmapset of the plain columns stored in the index */
+	for (i = 0; i < index->ncolumns; i++)
+	{
+		int			attno = index->indexkeys[i];
+
+		/* ignore expression columns */
+		if (attno == 0)
+			continue;
+
+		index_attrs =
+			bms_add_member(index_attrs,
+						   attno - FirstLowInvalidHeapAttributeNumber);
+	}
+
+	/* Do we have all the necessary attributes? */
+	result = bms_is_subset(attrs_used, index_attrs);
+
+	bms_free(attrs_used);
+	bms_free(index_attrs);
+
+	return result;
+}
+
+
 /*
  * find_saop_paths
  *		Find all the potential indexpaths that make use of ScalarArrayOpExpr
@@ -388,6 +388,37 @@ pathkeys_contained_in(List *keys1, List *keys2)
 	return false;
 }
 
+/*
+ * pathkeys_common
+ *	  Return the number of leading pathkeys that keys1 and keys2 have in
+ *	  common.  If this is less than list_length(keys1), a path sorted by
+ *	  keys2 is sorted by only a prefix of keys1; such a path can still be
+ *	  brought into keys1 order by an incremental sort.
+ */
+int
+pathkeys_common(List *keys1, List *keys2)
+{
+	int			n = 0;
+	ListCell   *key1,
+			   *key2;
+
+	forboth(key1, keys1, key2, keys2)
+	{
+		PathKey    *pathkey1 = (PathKey *) lfirst(key1);
+		PathKey    *pathkey2 = (PathKey *) lfirst(key2);
+
+		/*
+		 * XXX would like to check that we've been given canonicalized input,
+		 * but PlannerInfo not accessible here...
+		 */
+		if (pathkey1 != pathkey2)
+			break;
+		n++;
+	}
+
+	return n;
+}
+
 /*
  * get_cheapest_path_for_pathkeys
  *	  Find the cheapest path (according to the specified criterion) that
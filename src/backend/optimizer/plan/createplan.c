@@ -24,6 +24,7 @@
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
 #include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
 #include "optimizer/plancat.h"
 #include "optimizer/planmain.h"
 #include "optimizer/predtest.h"
@@ -80,7 +81,7 @@ static void copy_plan_costsize(Plan *dest, Plan *src);
 static SeqScan *make_seqscan(List *qptlist, List *qpqual, Index scanrelid);
 static IndexScan *make_indexscan(List *qptlist, List *qpqual, Index scanrelid,
 			   Oid indexid, List *indexqual, List *indexqualorig,
-			   ScanDirection indexscandir);
+			   ScanDirection indexscandir, bool indexonly);
 static BitmapIndexScan *make_bitmap_indexscan(Index scanrelid, Oid indexid,
 					  List *indexqual,
 					  List *indexqualorig);
@@ -219,9 +220,12 @@ create_scan_plan(PlannerInfo *root, Path *best_path)
 	 * tlist containing all Vars in order.	This will allow the executor to
 	 * optimize away projection of the table tuples, if possible.  (Note that
 	 * planner.c may replace the tlist we generate here, forcing projection to
-	 * occur.)
+	 * occur.)  An index-only scan can't do that, since the columns that
+	 * aren't stored in the index would come out as NULLs.
 	 */
-	if (use_physical_tlist(root, rel))
+	if (use_physical_tlist(root, rel) &&
+		!(IsA(best_path, IndexPath) &&
+		  ((IndexPath *) best_path)->indexonly))
 	{
 		tlist = build_physical_tlist(root, rel);
 		/* if fail because of dropped cols, use regular method */
@@ -973,7 +977,8 @@ create_indexscan_plan(PlannerInfo *root,
 							   indexoid,
 							   fixed_indexquals,
 							   stripped_indexquals,
-							   best_path->indexscandir);
+							   best_path->indexscandir,
+							   best_path->indexonly);
 
 	copy_path_costsize(&scan_plan->scan.plan, &best_path->path);
 	/* use the indexscan-specific rows estimate, not the parent rel's */
@@ -2424,7 +2429,8 @@ make_indexscan(List *qptlist,
 			   Oid indexid,
 			   List *indexqual,
 			   List *indexqualorig,
-			   ScanDirection indexscandir)
+			   ScanDirection indexscandir,
+			   bool indexonly)
 {
 	IndexScan  *node = makeNode(IndexScan);
 	Plan	   *plan = &node->scan.plan;
@@ -2439,6 +2445,7 @@ make_indexscan(List *qptlist,
 	node->indexqual = indexqual;
 	node->indexqualorig = indexqualorig;
 	node->indexorderdir = indexscandir;
+	node->indexonly = indexonly;
 
 	return node;
 }
@@ -3133,6 +3140,66 @@ make_sort_from_pathkeys(PlannerInfo *root, Plan *lefttree, List *pathkeys,
 					 sortColIdx, sortOperators, nullsFirst, limit_tuples);
 }
 
+/*
+ * make_incrementalsort_from_pathkeys
+ *	  Create a plan to sort according to given pathkeys, where the input is
+ *	  known to be sorted by the first 'presortedKeys' of them already
+ *
+ * Arguments are as for make_sort_from_pathkeys.  We build the sort key
+ * arrays the same way, then return an IncrementalSort node using them.
+ * The caller has already decided that an incremental sort is cheaper than
+ * a full one (see grouping_planner).
+ */
+Plan *
+make_incrementalsort_from_pathkeys(PlannerInfo *root, Plan *lefttree,
+								   List *pathkeys, int presortedKeys,
+								   double limit_tuples)
+{
+	Sort	   *sort;
+	IncrementalSort *node;
+	Plan	   *plan;
+	Path		incrsort_path;	/* dummy for result of cost_incremental_sort */
+
+	sort = make_sort_from_pathkeys(root, lefttree, pathkeys, limit_tuples);
+
+	/* make_sort_from_pathkeys might have added a Result node */
+	lefttree = sort->plan.lefttree;
+
+	Assert(presortedKeys > 0 && presortedKeys < list_length(pathkeys));
+
+	/*
+	 * If duplicate pathkeys were folded together, the sort columns no longer
+	 * line up with the pathkeys, so the presorted prefix can't be expressed
+	 * as a column count; just do a full sort in that case.
+	 */
+	if (sort->numCols != list_length(pathkeys))
+		return (Plan *) sort;
+
+	cost_incremental_sort(&incrsort_path, root, pathkeys, presortedKeys,
+						  lefttree->startup_cost, lefttree->total_cost,
+						  lefttree->plan_rows, lefttree->plan_width,
+						  limit_tuples);
+
+	node = makeNode(IncrementalSort);
+	plan = &node->sort.plan;
+	copy_plan_costsize(plan, lefttree); /* only care about copying size */
+	plan->startup_cost = incrsort_path.startup_cost;
+	plan->total_cost = incrsort_path.total_cost;
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+	node->sort.numCols = sort->numCols;
+	node->sort.sortColIdx = sort->sortColIdx;
+	node->sort.sortOperators = sort->sortOperators;
+	node->sort.nullsFirst = sort->nullsFirst;
+	node->presortedCols = presortedKeys;
+
+	pfree(sort);
+
+	return (Plan *) node;
+}
+
 /*
  * make_sort_from_sortclauses
  *	  Create sort plan to sort according to given sortclauses
@@ -3829,6 +3896,7 @@ is_projection_capable_plan(Plan *plan)
 		case T_Hash:
 		case T_Material:
 		case T_Sort:
+		case T_IncrementalSort:
 		case T_Unique:
 		case T_SetOp:
 		case T_LockRows:
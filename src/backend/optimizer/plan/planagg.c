@@ -406,6 +406,7 @@ build_minmax_path(PlannerInfo *root, RelOptInfo *rel, MinMaxAggInfo *info)
 									 restrictclauses,
 									 NIL,
 									 indexscandir,
+									 check_index_only(rel, index),
 									 NULL);
 
 		/*
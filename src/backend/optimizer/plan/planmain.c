@@ -401,6 +401,81 @@ query_planner(PlannerInfo *root, List *tlist,
 		}
 	}
 
+	/*
+	 * For a plain ORDER BY query, a path that is sorted by only a leading
+	 * part of the requested pathkeys can be finished off by an incremental
+	 * sort (see grouping_planner), which may well beat sorting the
+	 * cheapest-total path at the tuple fraction point.  If so, return the
+	 * best such path as the presorted path.
+	 */
+	if (sortedpath == NULL &&
+		root->query_pathkeys != NIL &&
+		root->query_pathkeys == root->sort_pathkeys &&
+		!parse->groupClause && !parse->hasAggs && !root->hasHavingQual &&
+		!parse->hasWindowFuncs && !parse->distinctClause &&
+		!pathkeys_contained_in(root->query_pathkeys, cheapestpath->pathkeys))
+	{
+		Path		best_path;	/* dummy for costs of the best choice */
+		int			presorted_keys;
+		ListCell   *l;
+
+		/*
+		 * The baseline is whatever it takes to sort the cheapest path: a full
+		 * sort, or an incremental one if that is cheaper, as
+		 * grouping_planner will decide when it adds the sort step.
+		 */
+		cost_sort(&best_path, root, root->query_pathkeys,
+				  cheapestpath->total_cost,
+				  final_rel->rows, final_rel->width,
+				  limit_tuples);
+		presorted_keys = pathkeys_common(root->query_pathkeys,
+										 cheapestpath->pathkeys);
+		if (presorted_keys > 0)
+		{
+			Path		incrsort_path;	/* dummy for cost_incremental_sort */
+
+			cost_incremental_sort(&incrsort_path, root, root->query_pathkeys,
+								  presorted_keys,
+								  cheapestpath->startup_cost,
+								  cheapestpath->total_cost,
+								  final_rel->rows, final_rel->width,
+								  limit_tuples);
+			if (compare_fractional_path_costs(&incrsort_path, &best_path,
+											  tuple_fraction) < 0)
+			{
+				best_path.startup_cost = incrsort_path.startup_cost;
+				best_path.total_cost = incrsort_path.total_cost;
+			}
+		}
+
+		foreach(l, final_rel->pathlist)
+		{
+			Path	   *path = (Path *) lfirst(l);
+			Path		incrsort_path;	/* dummy for cost_incremental_sort */
+
+			if (path == cheapestpath)
+				continue;
+			presorted_keys = pathkeys_common(root->query_pathkeys,
+											 path->pathkeys);
+			if (presorted_keys == 0)
+				continue;
+
+			cost_incremental_sort(&incrsort_path, root, root->query_pathkeys,
+								  presorted_keys,
+								  path->startup_cost, path->total_cost,
+								  final_rel->rows, final_rel->width,
+								  limit_tuples);
+
+			if (compare_fractional_path_costs(&incrsort_path, &best_path,
+											  tuple_fraction) < 0)
+			{
+				sortedpath = path;
+				best_path.startup_cost = incrsort_path.startup_cost;
+				best_path.total_cost = incrsort_path.total_cost;
+			}
+		}
+	}
+
 	*cheapest_path = cheapestpath;
 	*sorted_path = sortedpath;
 }
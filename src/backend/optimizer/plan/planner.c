@@ -81,6 +81,9 @@ static bool choose_hashed_distinct(PlannerInfo *root,
 					   Cost sorted_startup_cost, Cost sorted_total_cost,
 					   List *sorted_pathkeys,
 					   double dNumDistinctRows);
+static bool choose_incremental_sort(PlannerInfo *root, Plan *input_plan,
+						int presorted_keys,
+						double tuple_fraction, double limit_tuples);
 static List *make_subplanTargetList(PlannerInfo *root, List *tlist,
 					   AttrNumber **groupColIdx, bool *need_tlist_eval);
 static void locate_grouping_columns(PlannerInfo *root,
@@ -1644,16 +1647,31 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 
 	/*
 	 * If ORDER BY was given and we were not able to make the plan come out in
-	 * the right order, add an explicit sort step.
+	 * the right order, add an explicit sort step.  If the plan is already
+	 * sorted by a leading part of the ORDER BY keys, an incremental sort
+	 * might do.
 	 */
 	if (parse->sortClause)
 	{
 		if (!pathkeys_contained_in(root->sort_pathkeys, current_pathkeys))
 		{
-			result_plan = (Plan *) make_sort_from_pathkeys(root,
-														   result_plan,
+			int			presorted_keys;
+
+			presorted_keys = pathkeys_common(root->sort_pathkeys,
+											 current_pathkeys);
+			if (presorted_keys > 0 &&
+				choose_incremental_sort(root, result_plan, presorted_keys,
+										tuple_fraction, limit_tuples))
+				result_plan = make_incrementalsort_from_pathkeys(root,
+																 result_plan,
 														 root->sort_pathkeys,
-														   limit_tuples);
+															 presorted_keys,
+															   limit_tuples);
+			else
+				result_plan = (Plan *) make_sort_from_pathkeys(root,
+															   result_plan,
+														 root->sort_pathkeys,
+															   limit_tuples);
 			current_pathkeys = root->sort_pathkeys;
 		}
 	}
@@ -2474,6 +2492,57 @@ choose_hashed_distinct(PlannerInfo *root,
 	return false;
 }
 
+/*
+ * choose_incremental_sort - should we sort by ORDER BY incrementally?
+ *
+ * input_plan is the plan to be sorted by root->sort_pathkeys; it is already
+ * sorted by the first presorted_keys of them.  We compare sorting each group
+ * of tuples with equal presorted keys separately against sorting the whole
+ * input, at the same tuple fraction query_planner used to pick the input
+ * path, so that the two decisions agree.
+ *
+ * Returns TRUE to select an incremental sort, FALSE to select a full sort.
+ */
+static bool
+choose_incremental_sort(PlannerInfo *root, Plan *input_plan,
+						int presorted_keys,
+						double tuple_fraction, double limit_tuples)
+{
+	Path		incrsort_p;
+	Path		sort_p;
+
+	Assert(presorted_keys > 0 &&
+		   presorted_keys < list_length(root->sort_pathkeys));
+
+	/*
+	 * These path variables are dummies that just hold cost fields; we don't
+	 * make actual Paths for these steps.
+	 */
+	cost_incremental_sort(&incrsort_p, root, root->sort_pathkeys,
+						  presorted_keys,
+						  input_plan->startup_cost, input_plan->total_cost,
+						  input_plan->plan_rows, input_plan->plan_width,
+						  limit_tuples);
+	cost_sort(&sort_p, root, root->sort_pathkeys, input_plan->total_cost,
+			  input_plan->plan_rows, input_plan->plan_width,
+			  limit_tuples);
+
+	/*
+	 * Now make the decision using the top-level tuple fraction.  First we
+	 * have to convert an absolute count (LIMIT) into fractional form.
+	 */
+	if (tuple_fraction >= 1.0)
+		tuple_fraction /= input_plan->plan_rows;
+
+	if (compare_fractional_path_costs(&incrsort_p, &sort_p,
+									  tuple_fraction) < 0)
+	{
+		/* Incremental is cheaper, so use it */
+		return true;
+	}
+	return false;
+}
+
 /*
  * make_subplanTargetList
  *	  Generate appropriate target list when grouping is required.
@@ -417,6 +417,7 @@ create_seqscan_path(PlannerInfo *root, RelOptInfo *rel)
  * 'indexscandir' is ForwardScanDirection or BackwardScanDirection
  *			for an ordered index, or NoMovementScanDirection for
  *			an unordered index.
+ * 'indexonly' is true if an index-only scan is wanted.
  * 'outer_rel' is the outer relation if this is a join inner indexscan path.
  *			(pathkeys and indexscandir are ignored if so.)	NULL if not.
  *
@@ -428,6 +429,7 @@ create_index_path(PlannerInfo *root,
 				  List *clause_groups,
 				  List *pathkeys,
 				  ScanDirection indexscandir,
+				  bool indexonly,
 				  RelOptInfo *outer_rel)
 {
 	IndexPath  *pathnode = makeNode(IndexPath);
@@ -464,6 +466,7 @@ create_index_path(PlannerInfo *root,
 	pathnode->indexquals = indexquals;
 
 	pathnode->isjoininner = (outer_rel != NULL);
+	pathnode->indexonly = indexonly;
 	pathnode->indexscandir = indexscandir;
 
 	if (outer_rel != NULL)
@@ -63,6 +63,7 @@ static List *get_relation_constraints(PlannerInfo *root,
  *	indexlist	list of IndexOptInfos for relation's indexes
  *	pages		number of pages
  *	tuples		number of tuples
+ *	allvisfrac	fraction of pages marked all-visible (see below)
  *
  * Also, initialize the attr_needed[] and attr_widths[] arrays.  In most
  * cases these are left as zeroes, but sometimes we need to compute attr
@@ -215,6 +216,7 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 			info->amsearchnulls = indexRelation->rd_am->amsearchnulls;
 			info->amhasgettuple = OidIsValid(indexRelation->rd_am->amgettuple);
 			info->amhasgetbitmap = OidIsValid(indexRelation->rd_am->amgetbitmap);
+			info->amcanreturn = indexRelation->rd_am->amcanreturn;
 
 			/*
 			 * Fetch the ordering operators associated with the index, if any.
@@ -306,6 +308,25 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 
 	rel->indexlist = indexinfos;
 
+	/*
+	 * Estimate the fraction of the table's pages that are marked all-visible,
+	 * since those are the pages whose tuples an index-only scan need not
+	 * visit.  VACUUM and ANALYZE store the count in pg_class next to
+	 * relpages; take it as a fraction of that, and apply the fraction to the
+	 * current size, as estimate_rel_size does for the tuple density.
+	 */
+	rel->allvisfrac = 0;
+	if (relation->rd_rel->relpages > 0)
+	{
+		double		relallvisible = relation->rd_rel->relallvisible;
+		double		relpages = relation->rd_rel->relpages;
+
+		if (relallvisible >= relpages)
+			rel->allvisfrac = 1.0;
+		else
+			rel->allvisfrac = relallvisible / relpages;
+	}
+
 	heap_close(relation, NoLock);
 
 	/*
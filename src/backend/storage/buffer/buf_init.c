@@ -16,10 +16,12 @@
 
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
+#include "storage/fd.h"
 
 
 BufferDesc *BufferDescriptors;
 char	   *BufferBlocks;
+CkptSortItem *CkptBufferIds;
 int32	   *PrivateRefCount;
 
 
@@ -73,20 +75,33 @@ void
 InitBufferPool(void)
 {
 	bool		foundBufs,
-				foundDescs;
+				foundDescs,
+				foundCkpt;
 
 	BufferDescriptors = (BufferDesc *)
 		ShmemInitStruct("Buffer Descriptors",
 						NBuffers * sizeof(BufferDesc), &foundDescs);
 
+	/* Align the buffers as direct I/O requires (see ALIGNOF_DATA_BUFFER) */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
+		TYPEALIGN(ALIGNOF_DATA_BUFFER,
+				  ShmemInitStruct("Buffer Blocks",
+								  NBuffers * (Size) BLCKSZ + ALIGNOF_DATA_BUFFER,
+								  &foundBufs));
 
-	if (foundDescs || foundBufs)
+	/*
+	 * Workspace for sorting the buffers to be written by a checkpoint.  It's
+	 * allocated here, rather than at checkpoint time, so that a checkpoint
+	 * can't fail for lack of memory.  Its contents need no initialization.
+	 */
+	CkptBufferIds = (CkptSortItem *)
+		ShmemInitStruct("Checkpoint BufferIds",
+						NBuffers * sizeof(CkptSortItem), &foundCkpt);
+
+	if (foundDescs || foundBufs || foundCkpt)
 	{
-		/* both should be present or neither */
-		Assert(foundDescs && foundBufs);
+		/* all should be present or neither */
+		Assert(foundDescs && foundBufs && foundCkpt);
 		/* note: this path is only taken in EXEC_BACKEND case */
 	}
 	else
@@ -168,9 +183,13 @@ BufferShmemSize(void)
 	/* size of buffer descriptors */
 	size = add_size(size, mul_size(NBuffers, sizeof(BufferDesc)));
 
-	/* size of data pages */
+	/* size of data pages, plus alignment padding */
+	size = add_size(size, ALIGNOF_DATA_BUFFER);
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
 
+	/* size of checkpoint sort array */
+	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
+
 	/* size of stuff controlled by freelist.c */
 	size = add_size(size, StrategyShmemSize());
 
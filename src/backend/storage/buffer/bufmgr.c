@@ -74,9 +74,49 @@ double		bgwriter_lru_multiplier = 2.0;
  */
 int			target_prefetch_pages = 0;
 
-/* local state for StartBufferIO and related functions */
-static volatile BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+/*
+ * Number of pages a checkpoint writes before asking the kernel to start
+ * writing them back to disk; zero disables that.
+ */
+int			checkpoint_flush_after = DEFAULT_CHECKPOINT_FLUSH_AFTER;
+
+/*
+ * Blocks written out but not yet passed to smgrwriteback, so that they can
+ * be sorted and merged into ranges first.
+ */
+typedef struct WritebackContext
+{
+	int			max_pending;	/* issue when this many are pending */
+	int			nr_pending;		/* # of valid entries in pending[] */
+	BufferTag	pending[WRITEBACK_MAX_PENDING_FLUSHES];
+} WritebackContext;
+
+/*
+ * Per-tablespace progress of the write phase of BufferSync.  Its buffers
+ * are CkptBufferIds[index .. index + num_to_scan - num_scanned - 1].
+ */
+typedef struct CkptTsStatus
+{
+	Oid			tsId;
+	double		progress;		/* num_scanned, scaled to the total */
+	double		progress_slice; /* progress made by each buffer */
+	int			num_to_scan;	/* # of buffers of this tablespace */
+	int			num_scanned;	/* # of those processed so far */
+	int			index;			/* next CkptBufferIds entry to process */
+} CkptTsStatus;
+
+/*
+ * local state for StartBufferIO and related functions
+ *
+ * A multi-block transfer has I/O in progress on up to MAX_BUFFERS_PER_TRANSFER
+ * buffers at once, and allocating one of them may need to write out a dirty
+ * victim buffer meanwhile.
+ */
+#define MAX_IN_PROGRESS_IO	(MAX_BUFFERS_PER_TRANSFER + 1)
+
+static volatile BufferDesc *InProgressBufs[MAX_IN_PROGRESS_IO];
+static bool InProgressForInput[MAX_IN_PROGRESS_IO];
+static int	NumInProgressBufs = 0;
 
 /* local state for LockBufferForCleanup */
 static volatile BufferDesc *PinCountWaitBuf = NULL;
@@ -90,7 +130,18 @@ static bool PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(volatile BufferDesc *buf);
 static void UnpinBuffer(volatile BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
-static int	SyncOneBuffer(int buf_id, bool skip_recently_used);
+static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
+			  WritebackContext *wb_context);
+static int SyncBufferRun(CkptSortItem *items, int nitems,
+			  WritebackContext *wb_context);
+static int FlushBufferRun(volatile BufferDesc **bufHdrs, int nbufs,
+			   WritebackContext *wb_context);
+static int	ckpt_buforder_comparator(const void *a, const void *b);
+static void WritebackContextInit(WritebackContext *context, int max_pending);
+static void ScheduleBufferTagForWriteback(WritebackContext *context,
+							  BufferTag *tag);
+static void IssuePendingWritebacks(WritebackContext *context);
+static int	buffertag_comparator(const void *a, const void *b);
 static void WaitIO(volatile BufferDesc *buf);
 static bool StartBufferIO(volatile BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
@@ -100,6 +151,7 @@ static volatile BufferDesc *BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 			BlockNumber blockNum,
 			BufferAccessStrategy strategy,
 			bool *foundPtr);
+static bool ClaimReadAheadBuffer(volatile BufferDesc *buf);
 static void FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln);
 static void AtProcExit_Buffers(int code, Datum arg);
 
@@ -171,6 +223,90 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 #endif   /* USE_PREFETCH */
 }
 
+/*
+ * ReadAheadInit -- set up read-ahead for a caller reading blocks of a
+ *		relation fork in the order given by next_block
+ *
+ * See ReadAheadState in bufmgr.h.  Nothing is prefetched until the first
+ * ReadAheadAdvance call.
+ */
+void
+ReadAheadInit(ReadAheadState *ra, Relation reln, ForkNumber forkNum,
+			  ReadAheadNextBlock next_block, void *callback_arg)
+{
+	ra->rel = reln;
+	ra->forkNum = forkNum;
+	ra->next_block = next_block;
+	ra->callback_arg = callback_arg;
+	ra->distance = -1;
+	ra->inflight = 0;
+	ra->exhausted = false;
+}
+
+/*
+ * ReadAheadReset -- forget about blocks already prefetched
+ *
+ * Used when the caller has repositioned, so that next_block starts over from
+ * the block the caller is going to read next.  The prefetch distance built
+ * up so far is kept, since the caller evidently reads more than a few blocks.
+ */
+void
+ReadAheadReset(ReadAheadState *ra)
+{
+	ra->inflight = 0;
+	ra->exhausted = false;
+}
+
+/*
+ * ReadAheadAdvance -- note that the caller is reading its next block, and
+ *		prefetch more blocks to stay ahead of it
+ *
+ * The prefetch distance starts small and grows up to target_prefetch_pages,
+ * as in BitmapHeapNext: it becomes zero at the first block read, one at the
+ * second, and doubles after that.  This avoids useless prefetching in scans
+ * that stop after a few tuples.  Caller should call this after reading the
+ * current block, so that the prefetches don't compete with that read.
+ */
+void
+ReadAheadAdvance(ReadAheadState *ra)
+{
+#ifdef USE_PREFETCH
+	if (target_prefetch_pages <= 0)
+		return;
+
+	if (ra->inflight > 0)
+		ra->inflight--;			/* we're reading the oldest prefetched block */
+	else if (!ra->exhausted)
+	{
+		/* the block being read wasn't prefetched; step past it */
+		if (!BlockNumberIsValid(ra->next_block(ra->callback_arg)))
+			ra->exhausted = true;
+	}
+
+	if (ra->distance >= target_prefetch_pages)
+		ra->distance = target_prefetch_pages;
+	else if (ra->distance >= target_prefetch_pages / 2)
+		ra->distance = target_prefetch_pages;
+	else if (ra->distance > 0)
+		ra->distance *= 2;
+	else
+		ra->distance++;
+
+	while (!ra->exhausted && ra->inflight < ra->distance)
+	{
+		BlockNumber blkno = ra->next_block(ra->callback_arg);
+
+		if (!BlockNumberIsValid(blkno))
+		{
+			ra->exhausted = true;
+			break;
+		}
+		PrefetchBuffer(ra->rel, ra->forkNum, blkno);
+		ra->inflight++;
+	}
+#endif   /* USE_PREFETCH */
+}
+
 
 /*
  * ReadBuffer -- a shorthand for ReadBufferExtended, for reading from main
@@ -247,6 +383,216 @@ ReadBufferExtended(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
 }
 
 
+/*
+ * ReadBufferRange -- like ReadBufferExtended in RBM_NORMAL mode, but if the
+ *		block has to be read in, read up to nblocks - 1 following blocks
+ *		with the same system call
+ *
+ * Only the requested block is returned pinned.  The following ones are left
+ * in shared buffers for the caller to find there later.  They are read only
+ * up to the first one that is in shared buffers already, so that nothing is
+ * read twice.  Caller must know that all the nblocks blocks exist.
+ *
+ * Only the requested block is counted as read now.  The following ones are
+ * marked BM_READ_AHEAD, and counted as read rather than hit when they are
+ * first looked up, so the statistics come out as if each had been read by
+ * itself.
+ *
+ * This is meant for sequential scans: reading a run of blocks costs hardly
+ * more than reading one, so it saves system calls, and the kernel sees
+ * larger requests.  Callers reading with the default strategy should not
+ * use it, lest blocks that are never visited push useful ones out, unless
+ * direct I/O is in use: then the kernel does no read-ahead for us.
+ */
+Buffer
+ReadBufferRange(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+				int nblocks, BufferAccessStrategy strategy)
+{
+	SMgrRelation smgr;
+	volatile BufferDesc *bufHdrs[MAX_BUFFERS_PER_TRANSFER];
+	char	   *bufBlocks[MAX_BUFFERS_PER_TRANSFER];
+	bool		found;
+	int			nread;
+	int			i;
+
+	Assert(blockNum != P_NEW);
+
+	/* Local buffers are not worth the trouble; use the regular path */
+	if (reln->rd_istemp || nblocks <= 1)
+		return ReadBufferExtended(reln, forkNum, blockNum, RBM_NORMAL,
+								  strategy);
+
+	nblocks = Min(nblocks, MAX_BUFFERS_PER_TRANSFER);
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+	smgr = reln->rd_smgr;
+
+	/* Make sure we will have room to remember the buffer pin */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNum,
+									   smgr->smgr_rnode.spcNode,
+									   smgr->smgr_rnode.dbNode,
+									   smgr->smgr_rnode.relNode,
+									   false,
+									   false);
+
+	pgstat_count_buffer_read(reln);
+	bufHdrs[0] = BufferAlloc(smgr, forkNum, blockNum, strategy, &found);
+
+	/* if it was already in the buffer pool, we're done */
+	if (found)
+	{
+		if (ClaimReadAheadBuffer(bufHdrs[0]))
+		{
+			pgBufferUsage.shared_blks_read++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageMiss;
+		}
+		else
+		{
+			pgBufferUsage.shared_blks_hit++;
+			pgstat_count_buffer_hit(reln);
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+		}
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
+										  smgr->smgr_rnode.spcNode,
+										  smgr->smgr_rnode.dbNode,
+										  smgr->smgr_rnode.relNode,
+										  false,
+										  false,
+										  found);
+
+		return BufferDescriptorGetBuffer(bufHdrs[0]);
+	}
+
+	/*
+	 * Allocate buffers for the following blocks, in ascending block order
+	 * (see notes at StartBufferIO), and stop at the first one that somebody
+	 * else has brought in already.  Looking it up first saves evicting a
+	 * victim buffer in the common case that the block is there.
+	 */
+	for (nread = 1; nread < nblocks; nread++)
+	{
+		BufferTag	tag;
+		uint32		hash;
+		LWLockId	partitionLock;
+		int			buf_id;
+
+		INIT_BUFFERTAG(tag, smgr->smgr_rnode, forkNum, blockNum + nread);
+		hash = BufTableHashCode(&tag);
+		partitionLock = BufMappingPartitionLock(hash);
+
+		LWLockAcquire(partitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&tag, hash);
+		LWLockRelease(partitionLock);
+		if (buf_id >= 0)
+			break;
+
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		bufHdrs[nread] = BufferAlloc(smgr, forkNum, blockNum + nread,
+									 strategy, &found);
+		if (found)
+		{
+			/* somebody read it in after we looked */
+			UnpinBuffer(bufHdrs[nread], true);
+			break;
+		}
+	}
+
+	/* Only the requested block counts as read yet; see above */
+	pgBufferUsage.shared_blks_read++;
+
+	/* At this point we do NOT hold any locks. */
+
+	for (i = 0; i < nread; i++)
+	{
+		Assert(!(bufHdrs[i]->flags & BM_VALID));	/* spinlock not needed */
+		bufBlocks[i] = (char *) BufHdrGetBlock(bufHdrs[i]);
+	}
+
+	smgrreadv(smgr, forkNum, blockNum, bufBlocks, nread);
+
+	/* check for garbage data */
+	for (i = 0; i < nread; i++)
+	{
+		if (!PageHeaderIsValid((PageHeader) bufBlocks[i]))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page header in block %u of relation %s; zeroing out page",
+								blockNum + i,
+								relpath(smgr->smgr_rnode, forkNum))));
+				MemSet(bufBlocks[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid page header in block %u of relation %s",
+							blockNum + i,
+							relpath(smgr->smgr_rnode, forkNum))));
+		}
+	}
+
+	/*
+	 * Set BM_VALID, terminate IO, and wake up any waiters.  The following
+	 * blocks are also marked BM_READ_AHEAD, for their first lookup to count
+	 * the read.
+	 */
+	TerminateBufferIO(bufHdrs[0], false, BM_VALID);
+	for (i = 1; i < nread; i++)
+		TerminateBufferIO(bufHdrs[i], false, BM_VALID | BM_READ_AHEAD);
+
+	/* the caller only wants the first block pinned */
+	for (i = 1; i < nread; i++)
+		UnpinBuffer(bufHdrs[i], true);
+
+	if (VacuumCostActive)
+		VacuumCostBalance += VacuumCostPageMiss;
+
+	TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
+									  smgr->smgr_rnode.spcNode,
+									  smgr->smgr_rnode.dbNode,
+									  smgr->smgr_rnode.relNode,
+									  false,
+									  false,
+									  false);
+
+	return BufferDescriptorGetBuffer(bufHdrs[0]);
+}
+
+/*
+ * ClaimReadAheadBuffer -- clear the BM_READ_AHEAD flag of a buffer that has
+ *		just been looked up
+ *
+ * Returns true if the flag was set, meaning that this is the first lookup of
+ * a block ReadBufferRange read in without being asked for it.  The caller
+ * then counts the lookup as a read rather than a hit.  Caller must hold a
+ * pin on the buffer.
+ */
+static bool
+ClaimReadAheadBuffer(volatile BufferDesc *buf)
+{
+	bool		result;
+
+	/* The flag is seldom set, so check it without the spinlock first */
+	if (!(buf->flags & BM_READ_AHEAD))
+		return false;
+
+	LockBufHdr(buf);
+	result = (buf->flags & BM_READ_AHEAD) != 0;
+	buf->flags &= ~BM_READ_AHEAD;
+	UnlockBufHdr(buf);
+
+	return result;
+}
+
+
 /*
  * ReadBufferWithoutRelcache -- like ReadBufferExtended, but doesn't require
  *		a relcache entry for the relation.
@@ -280,6 +626,7 @@ ReadBuffer_common(SMgrRelation smgr, bool isLocalBuf, ForkNumber forkNum,
 	volatile BufferDesc *bufHdr;
 	Block		bufBlock;
 	bool		found;
+	bool		readahead = false;
 	bool		isExtend;
 
 	*hit = false;
@@ -315,7 +662,14 @@ ReadBuffer_common(SMgrRelation smgr, bool isLocalBuf, ForkNumber forkNum,
 		 * not currently in memory.
 		 */
 		bufHdr = BufferAlloc(smgr, forkNum, blockNum, strategy, &found);
+
+		/*
+		 * The first lookup of a block that ReadBufferRange read ahead counts
+		 * as its read.
+		 */
 		if (found)
+			readahead = ClaimReadAheadBuffer(bufHdr);
+		if (found && !readahead)
 			pgBufferUsage.shared_blks_hit++;
 		else
 			pgBufferUsage.shared_blks_read++;
@@ -329,10 +683,11 @@ ReadBuffer_common(SMgrRelation smgr, bool isLocalBuf, ForkNumber forkNum,
 		if (!isExtend)
 		{
 			/* Just need to update stats before we exit */
-			*hit = true;
+			*hit = !readahead;
 
 			if (VacuumCostActive)
-				VacuumCostBalance += VacuumCostPageHit;
+				VacuumCostBalance += readahead ?
+					VacuumCostPageMiss : VacuumCostPageHit;
 
 			TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
 											  smgr->smgr_rnode.spcNode,
@@ -568,15 +923,11 @@ BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
 	{
-		bool		lock_held;
-
 		/*
 		 * Select a victim buffer.	The buffer is returned with its header
-		 * spinlock still held!  Also (in most cases) the BufFreelistLock is
-		 * still held, since it would be bad to hold the spinlock while
-		 * possibly waking up other processes.
+		 * spinlock still held!
 		 */
-		buf = StrategyGetBuffer(strategy, &lock_held);
+		buf = StrategyGetBuffer(strategy);
 
 		Assert(buf->refcount == 0);
 
@@ -586,10 +937,6 @@ BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 		/* Pin the buffer and then release the buffer spinlock */
 		PinBuffer_Locked(buf);
 
-		/* Now it's safe to release the freelist lock */
-		if (lock_held)
-			LWLockRelease(BufFreelistLock);
-
 		/*
 		 * If the buffer was dirty, try to write it out.  There is a race
 		 * condition here, in that someone might dirty it after we released it
@@ -792,7 +1139,8 @@ BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 	 * 1 so that the buffer can survive one clock-sweep pass.)
 	 */
 	buf->tag = newTag;
-	buf->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_CHECKPOINT_NEEDED | BM_IO_ERROR);
+	buf->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED |
+					BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_READ_AHEAD);
 	buf->flags |= BM_TAG_VALID;
 	buf->usage_count = 1;
 
@@ -1157,9 +1505,13 @@ static void
 BufferSync(int flags)
 {
 	int			buf_id;
-	int			num_to_scan;
 	int			num_to_write;
+	int			num_processed;
 	int			num_written;
+	CkptTsStatus *per_ts_stat = NULL;
+	int			num_spaces;
+	int			i;
+	WritebackContext wb_context;
 
 	/* Make sure we can handle the pin inside SyncOneBuffer */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
@@ -1167,7 +1519,8 @@ BufferSync(int flags)
 	/*
 	 * Loop over all buffers, and mark the ones that need to be written with
 	 * BM_CHECKPOINT_NEEDED.  Count them as we go (num_to_write), so that we
-	 * can estimate how much work needs to be done.
+	 * can estimate how much work needs to be done, and remember them in
+	 * CkptBufferIds so that we can sort them.
 	 *
 	 * This allows us to write only those pages that were dirty when the
 	 * checkpoint began, and not those that get dirtied while it proceeds.
@@ -1193,8 +1546,16 @@ BufferSync(int flags)
 
 		if (bufHdr->flags & BM_DIRTY)
 		{
+			CkptSortItem *item = &CkptBufferIds[num_to_write++];
+
 			bufHdr->flags |= BM_CHECKPOINT_NEEDED;
-			num_to_write++;
+
+			item->buf_id = buf_id;
+			item->tsId = bufHdr->tag.rnode.spcNode;
+			item->dbId = bufHdr->tag.rnode.dbNode;
+			item->relNode = bufHdr->tag.rnode.relNode;
+			item->forkNum = bufHdr->tag.forkNum;
+			item->blockNum = bufHdr->tag.blockNum;
 		}
 
 		UnlockBufHdr(bufHdr);
@@ -1206,67 +1567,150 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_START(NBuffers, num_to_write);
 
 	/*
-	 * Loop over all buffers again, and write the ones (still) marked with
-	 * BM_CHECKPOINT_NEEDED.  In this loop, we start at the clock sweep point
-	 * since we might as well dump soon-to-be-recycled buffers first.
+	 * Sort the buffers by file and block.  Writing them in that order turns
+	 * the writes into mostly sequential I/O, which the kernel can merge and
+	 * the disks handle much better than writes scattered all over the
+	 * database.  Contiguous writes also make the writeback requests below
+	 * cover larger ranges.
+	 */
+	qsort(CkptBufferIds, num_to_write, sizeof(CkptSortItem),
+		  ckpt_buforder_comparator);
+
+	/*
+	 * Count the buffers of each tablespace.  The sort order puts each
+	 * tablespace's buffers together.
+	 */
+	num_spaces = 0;
+	for (i = 0; i < num_to_write; i++)
+	{
+		CkptTsStatus *s;
+
+		if (i == 0 || CkptBufferIds[i].tsId != CkptBufferIds[i - 1].tsId)
+		{
+			if (per_ts_stat == NULL)
+				per_ts_stat = (CkptTsStatus *) palloc(sizeof(CkptTsStatus));
+			else
+				per_ts_stat = (CkptTsStatus *)
+					repalloc(per_ts_stat,
+							 sizeof(CkptTsStatus) * (num_spaces + 1));
+			s = &per_ts_stat[num_spaces++];
+			s->tsId = CkptBufferIds[i].tsId;
+			s->progress = 0;
+			s->num_to_scan = 0;
+			s->num_scanned = 0;
+			s->index = i;
+		}
+		else
+			s = &per_ts_stat[num_spaces - 1];
+
+		s->num_to_scan++;
+	}
+
+	for (i = 0; i < num_spaces; i++)
+		per_ts_stat[i].progress_slice =
+			(double) num_to_write / per_ts_stat[i].num_to_scan;
+
+	WritebackContextInit(&wb_context, checkpoint_flush_after);
+
+	/*
+	 * Iterate through the sorted buffers, and write the ones (still) marked
+	 * with BM_CHECKPOINT_NEEDED.  The writes are balanced between
+	 * tablespaces, so that all of them are kept busy rather than one after
+	 * the other: each time, we process the next buffer of the tablespace
+	 * that has made the least progress relative to its number of buffers.
+	 * There are normally few tablespaces, so just search for it.
 	 *
 	 * Note that we don't read the buffer alloc count here --- that should be
 	 * left untouched till the next BgBufferSync() call.
 	 */
-	buf_id = StrategySyncStart(NULL, NULL);
-	num_to_scan = NBuffers;
+	num_processed = 0;
 	num_written = 0;
-	while (num_to_scan-- > 0)
+	while (num_processed < num_to_write)
 	{
-		volatile BufferDesc *bufHdr = &BufferDescriptors[buf_id];
+		CkptTsStatus *ts_stat = NULL;
+		CkptSortItem *item;
+		int			nitems;
+		volatile BufferDesc *bufHdr;
+
+		for (i = 0; i < num_spaces; i++)
+		{
+			CkptTsStatus *s = &per_ts_stat[i];
+
+			if (s->num_scanned < s->num_to_scan &&
+				(ts_stat == NULL || s->progress < ts_stat->progress))
+				ts_stat = s;
+		}
+		Assert(ts_stat != NULL);
 
 		/*
-		 * We don't need to acquire the lock here, because we're only looking
-		 * at a single bit. It's possible that someone else writes the buffer
-		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
-		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires lock,
-		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
-		 * write the buffer though we didn't need to.  It doesn't seem worth
-		 * guarding against this, though.
+		 * Take the following buffers of the tablespace along as long as they
+		 * hold consecutive blocks of the same relation fork, so that they can
+		 * be written out with a single system call.
 		 */
-		if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
+		item = &CkptBufferIds[ts_stat->index];
+		nitems = 1;
+		while (nitems < MAX_BUFFERS_PER_TRANSFER &&
+			   ts_stat->num_scanned + nitems < ts_stat->num_to_scan &&
+			   item[nitems].relNode == item[0].relNode &&
+			   item[nitems].dbId == item[0].dbId &&
+			   item[nitems].forkNum == item[0].forkNum &&
+			   item[nitems].blockNum == item[0].blockNum + nitems)
+			nitems++;
+
+		buf_id = item[0].buf_id;
+		bufHdr = &BufferDescriptors[buf_id];
+
+		ts_stat->progress += ts_stat->progress_slice * nitems;
+		ts_stat->num_scanned += nitems;
+		ts_stat->index += nitems;
+		num_processed += nitems;
+
+		if (nitems > 1)
 		{
-			if (SyncOneBuffer(buf_id, false) & BUF_WRITTEN)
-			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				BgWriterStats.m_buf_written_checkpoints++;
-				num_written++;
-
-				/*
-				 * We know there are at most num_to_write buffers with
-				 * BM_CHECKPOINT_NEEDED set; so we can stop scanning if
-				 * num_written reaches num_to_write.
-				 *
-				 * Note that num_written doesn't include buffers written by
-				 * other backends, or by the bgwriter cleaning scan. That
-				 * means that the estimate of how much progress we've made is
-				 * conservative, and also that this test will often fail to
-				 * trigger.  But it seems worth making anyway.
-				 */
-				if (num_written >= num_to_write)
-					break;
+			int			n = SyncBufferRun(item, nitems, &wb_context);
 
-				/*
-				 * Perform normal bgwriter duties and sleep to throttle our
-				 * I/O rate.
-				 */
-				CheckpointWriteDelay(flags,
-									 (double) num_written / num_to_write);
+			BgWriterStats.m_buf_written_checkpoints += n;
+			num_written += n;
+		}
+		else
+		{
+			/*
+			 * We don't need to acquire the lock here, because we're only
+			 * looking at a single bit.  It's possible that someone else writes
+			 * the buffer and clears the flag right after we check, but that
+			 * doesn't matter since SyncOneBuffer will then do nothing.
+			 * However, there is a further race condition: it's conceivable
+			 * that between the time we examine the bit here and the time
+			 * SyncOneBuffer acquires lock, someone else not only wrote the
+			 * buffer but replaced it with another page and dirtied it.  In
+			 * that improbable case, SyncOneBuffer will write the buffer though
+			 * we didn't need to.  It doesn't seem worth guarding against this,
+			 * though.
+			 */
+			if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
+			{
+				if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
+				{
+					TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
+					BgWriterStats.m_buf_written_checkpoints++;
+					num_written++;
+				}
 			}
 		}
 
-		if (++buf_id >= NBuffers)
-			buf_id = 0;
+		/*
+		 * Perform normal bgwriter duties and sleep to throttle our I/O rate.
+		 * Progress is measured by the buffers processed rather than written,
+		 * since buffers written by others since we started count as done.
+		 */
+		CheckpointWriteDelay(flags, (double) num_processed / num_to_write);
 	}
 
+	/* Start writeback of whatever is left pending */
+	IssuePendingWritebacks(&wb_context);
+
+	pfree(per_ts_stat);
+
 	/*
 	 * Update checkpoint statistics. As noted above, this doesn't include
 	 * buffers written by other backends or bgwriter scan.
@@ -1492,7 +1936,7 @@ BgBufferSync(void)
 	/* Execute the LRU scan */
 	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
 	{
-		int			buffer_state = SyncOneBuffer(next_to_clean, true);
+		int			buffer_state = SyncOneBuffer(next_to_clean, true, NULL);
 
 		if (++next_to_clean >= NBuffers)
 		{
@@ -1562,13 +2006,18 @@ BgBufferSync(void)
  * (BUF_WRITTEN could be set in error if FlushBuffers finds the buffer clean
  * after locking it, but we don't care all that much.)
  *
+ * If wb_context isn't NULL, a buffer we write is scheduled for writeback
+ * in it.
+ *
  * Note: caller must have done ResourceOwnerEnlargeBuffers.
  */
 static int
-SyncOneBuffer(int buf_id, bool skip_recently_used)
+SyncOneBuffer(int buf_id, bool skip_recently_used,
+			  WritebackContext *wb_context)
 {
 	volatile BufferDesc *bufHdr = &BufferDescriptors[buf_id];
 	int			result = 0;
+	BufferTag	tag;
 
 	/*
 	 * Check whether buffer needs writing.
@@ -1607,11 +2056,345 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 	FlushBuffer(bufHdr, NULL);
 
 	LWLockRelease(bufHdr->content_lock);
+
+	/* the tag can't change while we hold the pin */
+	tag = bufHdr->tag;
+
 	UnpinBuffer(bufHdr, true);
 
+	if (wb_context)
+		ScheduleBufferTagForWriteback(wb_context, &tag);
+
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * SyncBufferRun -- write out a run of buffers for BufferSync
+ *
+ * items are CkptBufferIds entries for consecutive blocks of one relation
+ * fork.  The buffers that still hold those blocks and still need writing
+ * for the checkpoint are written, consecutive ones with a single system
+ * call, and scheduled for writeback in wb_context.
+ *
+ * Returns the number of buffers written (see notes at SyncOneBuffer).
+ */
+static int
+SyncBufferRun(CkptSortItem *items, int nitems, WritebackContext *wb_context)
+{
+	volatile BufferDesc *bufHdrs[MAX_BUFFERS_PER_TRANSFER];
+	int			nbufs = 0;
+	int			num_written = 0;
+	int			i;
+
+	Assert(nitems <= MAX_BUFFERS_PER_TRANSFER);
+
+	for (i = 0; i < nitems; i++)
+	{
+		volatile BufferDesc *bufHdr = &BufferDescriptors[items[i].buf_id];
+		BufFlags	needed = BM_VALID | BM_DIRTY | BM_CHECKPOINT_NEEDED;
+
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		/*
+		 * Check whether buffer needs writing, as in SyncOneBuffer.  Since we
+		 * are going to write it as part of a run, also make sure that it still
+		 * holds the block it held when we sorted the buffers.  A buffer that
+		 * doesn't qualify ends the current run.
+		 */
+		LockBufHdr(bufHdr);
+		if ((bufHdr->flags & needed) != needed ||
+			bufHdr->tag.rnode.spcNode != items[i].tsId ||
+			bufHdr->tag.rnode.dbNode != items[i].dbId ||
+			bufHdr->tag.rnode.relNode != items[i].relNode ||
+			bufHdr->tag.forkNum != items[i].forkNum ||
+			bufHdr->tag.blockNum != items[i].blockNum)
+		{
+			UnlockBufHdr(bufHdr);
+			num_written += FlushBufferRun(bufHdrs, nbufs, wb_context);
+			nbufs = 0;
+			continue;
+		}
+		PinBuffer_Locked(bufHdr);
+
+		/*
+		 * Share-lock it.  Only the first buffer of a run may wait for the
+		 * lock; waiting while holding the locks of the others could deadlock
+		 * against a backend locking the same buffers in another order.  So if
+		 * the lock isn't free, write out what we have and start a new run.
+		 */
+		if (nbufs > 0 &&
+			!LWLockConditionalAcquire(bufHdr->content_lock, LW_SHARED))
+		{
+			num_written += FlushBufferRun(bufHdrs, nbufs, wb_context);
+			nbufs = 0;
+		}
+		if (nbufs == 0)
+			LWLockAcquire(bufHdr->content_lock, LW_SHARED);
+
+		bufHdrs[nbufs++] = bufHdr;
+	}
+
+	num_written += FlushBufferRun(bufHdrs, nbufs, wb_context);
+
+	return num_written;
+}
+
+/*
+ * FlushBufferRun -- write out buffers holding consecutive blocks of one
+ *		relation fork, for SyncBufferRun
+ *
+ * This is FlushBuffer for several buffers at once: the caller must hold a
+ * pin and a share-lock on each of them.  We release both, and schedule the
+ * buffers for writeback in wb_context.
+ *
+ * Returns the number of buffers written, which leaves out any that somebody
+ * else flushed meanwhile.
+ */
+static int
+FlushBufferRun(volatile BufferDesc **bufHdrs, int nbufs,
+			   WritebackContext *wb_context)
+{
+	SMgrRelation reln;
+	ErrorContextCallback errcontext;
+	int			num_written = 0;
+	int			first;
+	int			i;
+	int			j;
+
+	if (nbufs == 0)
+		return 0;
+
+	/* Setup error traceback support for ereport() */
+	errcontext.callback = buffer_write_error_callback;
+	errcontext.arg = (void *) bufHdrs[0];
+	errcontext.previous = error_context_stack;
+	error_context_stack = &errcontext;
+
+	/* Find smgr relation for buffers */
+	reln = smgropen(bufHdrs[0]->tag.rnode);
+
+	/*
+	 * Acquire the buffers' io_in_progress locks in ascending block order.  A
+	 * buffer that somebody else flushed before we could needs no writing,
+	 * but splits the run; write out the buffers before it at that point.
+	 */
+	first = 0;
+	for (i = 0; i <= nbufs; i++)
+	{
+		char	   *bufBlocks[MAX_BUFFERS_PER_TRANSFER];
+		XLogRecPtr	recptr;
+
+		if (i < nbufs && StartBufferIO(bufHdrs[i], false))
+			continue;
+
+		if (i > first)
+		{
+			/*
+			 * Force XLOG flush up to the buffers' highest LSN, as FlushBuffer
+			 * does for one buffer.
+			 */
+			recptr = BufferGetLSN(bufHdrs[first]);
+			for (j = first + 1; j < i; j++)
+			{
+				XLogRecPtr	lsn = BufferGetLSN(bufHdrs[j]);
+
+				if (XLByteLT(recptr, lsn))
+					recptr = lsn;
+			}
+			XLogFlush(recptr);
+
+			for (j = first; j < i; j++)
+			{
+				volatile BufferDesc *buf = bufHdrs[j];
+
+				TRACE_POSTGRESQL_BUFFER_FLUSH_START(buf->tag.forkNum,
+													buf->tag.blockNum,
+													reln->smgr_rnode.spcNode,
+													reln->smgr_rnode.dbNode,
+													reln->smgr_rnode.relNode);
+
+				LockBufHdr(buf);
+				buf->flags &= ~BM_JUST_DIRTIED;
+				UnlockBufHdr(buf);
+
+				bufBlocks[j - first] = (char *) BufHdrGetBlock(buf);
+			}
+
+			smgrwritev(reln,
+					   bufHdrs[first]->tag.forkNum,
+					   bufHdrs[first]->tag.blockNum,
+					   bufBlocks,
+					   i - first,
+					   false);
+
+			pgBufferUsage.shared_blks_written += i - first;
+			num_written += i - first;
+
+			for (j = first; j < i; j++)
+			{
+				volatile BufferDesc *buf = bufHdrs[j];
+
+				TerminateBufferIO(buf, true, 0);
+
+				TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(buf->tag.forkNum,
+												   buf->tag.blockNum,
+												   reln->smgr_rnode.spcNode,
+												   reln->smgr_rnode.dbNode,
+												   reln->smgr_rnode.relNode);
+				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf->buf_id);
+			}
+		}
+		first = i + 1;
+	}
+
+	/* Pop the error context stack */
+	error_context_stack = errcontext.previous;
+
+	for (i = 0; i < nbufs; i++)
+	{
+		volatile BufferDesc *buf = bufHdrs[i];
+		BufferTag	tag;
+
+		LWLockRelease(buf->content_lock);
+
+		/* the tag can't change while we hold the pin */
+		tag = buf->tag;
+
+		UnpinBuffer(buf, true);
+
+		ScheduleBufferTagForWriteback(wb_context, &tag);
+	}
+
+	return num_written;
+}
+
+/*
+ * ckpt_buforder_comparator -- qsort comparator for CkptSortItems
+ *
+ * Orders the buffers by tablespace, then by file and block within it.
+ */
+static int
+ckpt_buforder_comparator(const void *a, const void *b)
+{
+	const CkptSortItem *ca = (const CkptSortItem *) a;
+	const CkptSortItem *cb = (const CkptSortItem *) b;
+
+	if (ca->tsId != cb->tsId)
+		return (ca->tsId < cb->tsId) ? -1 : 1;
+	if (ca->dbId != cb->dbId)
+		return (ca->dbId < cb->dbId) ? -1 : 1;
+	if (ca->relNode != cb->relNode)
+		return (ca->relNode < cb->relNode) ? -1 : 1;
+	if (ca->forkNum != cb->forkNum)
+		return (ca->forkNum < cb->forkNum) ? -1 : 1;
+	if (ca->blockNum != cb->blockNum)
+		return (ca->blockNum < cb->blockNum) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * WritebackContextInit -- set up a WritebackContext
+ *
+ * max_pending is the number of written blocks to collect before starting
+ * their writeback; zero disables writeback.
+ */
+static void
+WritebackContextInit(WritebackContext *context, int max_pending)
+{
+	Assert(max_pending >= 0 && max_pending <= WRITEBACK_MAX_PENDING_FLUSHES);
+
+	context->max_pending = max_pending;
+	context->nr_pending = 0;
+}
+
+/*
+ * ScheduleBufferTagForWriteback -- remember that a block has been written,
+ *		and start writeback of the pending blocks if there are enough of them
+ *
+ * Issuing the writeback requests in batches lets us sort and merge them,
+ * and leaves the kernel some time to combine the writes itself.
+ */
+static void
+ScheduleBufferTagForWriteback(WritebackContext *context, BufferTag *tag)
+{
+	if (context->max_pending <= 0)
+		return;
+
+	context->pending[context->nr_pending++] = *tag;
+
+	if (context->nr_pending >= context->max_pending)
+		IssuePendingWritebacks(context);
+}
+
+/*
+ * IssuePendingWritebacks -- start writeback of the pending blocks
+ *
+ * The blocks are sorted, and runs of consecutive blocks of the same file
+ * are passed to smgrwriteback as one range.
+ */
+static void
+IssuePendingWritebacks(WritebackContext *context)
+{
+	int			i;
+
+	if (context->nr_pending == 0)
+		return;
+
+	qsort(context->pending, context->nr_pending, sizeof(BufferTag),
+		  buffertag_comparator);
+
+	i = 0;
+	while (i < context->nr_pending)
+	{
+		BufferTag  *first = &context->pending[i];
+		BlockNumber nblocks = 1;
+		SMgrRelation reln;
+
+		/* extend the range over following contiguous blocks, if any */
+		for (i++; i < context->nr_pending; i++)
+		{
+			BufferTag  *next = &context->pending[i];
+
+			if (!RelFileNodeEquals(next->rnode, first->rnode) ||
+				next->forkNum != first->forkNum)
+				break;
+			if (next->blockNum == first->blockNum + nblocks - 1)
+				continue;		/* same block written twice */
+			if (next->blockNum != first->blockNum + nblocks)
+				break;
+			nblocks++;
+		}
+
+		reln = smgropen(first->rnode);
+		smgrwriteback(reln, first->forkNum, first->blockNum, nblocks);
+	}
+
+	context->nr_pending = 0;
+}
+
+/*
+ * buffertag_comparator -- qsort comparator for BufferTags, in file and
+ *		block order
+ */
+static int
+buffertag_comparator(const void *a, const void *b)
+{
+	const BufferTag *ba = (const BufferTag *) a;
+	const BufferTag *bb = (const BufferTag *) b;
+
+	if (ba->rnode.spcNode != bb->rnode.spcNode)
+		return (ba->rnode.spcNode < bb->rnode.spcNode) ? -1 : 1;
+	if (ba->rnode.dbNode != bb->rnode.dbNode)
+		return (ba->rnode.dbNode < bb->rnode.dbNode) ? -1 : 1;
+	if (ba->rnode.relNode != bb->rnode.relNode)
+		return (ba->rnode.relNode < bb->rnode.relNode) ? -1 : 1;
+	if (ba->forkNum != bb->forkNum)
+		return (ba->forkNum < bb->forkNum) ? -1 : 1;
+	if (ba->blockNum != bb->blockNum)
+		return (ba->blockNum < bb->blockNum) ? -1 : 1;
+	return 0;
+}
+
 
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
@@ -2512,8 +3295,11 @@ ConditionalLockBufferForCleanup(Buffer buffer)
 /*
  *	Functions for buffer I/O handling
  *
- *	Note: We assume that nested buffer I/O never occurs.
- *	i.e at most one io_in_progress lock is held per proc.
+ *	Note: a proc may hold io_in_progress locks on several buffers at once,
+ *	up to MAX_IN_PROGRESS_IO, when it transfers a run of blocks with one
+ *	system call.  To avoid deadlocks, a proc that already has I/O in
+ *	progress must only wait for I/O on buffers holding higher-numbered blocks
+ *	of the same relation fork, or on buffers it is about to write out.
  *
  *	Also note that these are used only for shared buffers, not local ones.
  */
@@ -2553,7 +3339,7 @@ WaitIO(volatile BufferDesc *buf)
 /*
  * StartBufferIO: begin I/O on this buffer
  *	(Assumptions)
- *	My process is executing no IO
+ *	My process is not already executing IO on this buffer
  *	The buffer is Pinned
  *
  * In some scenarios there are race conditions in which multiple backends
@@ -2571,7 +3357,7 @@ WaitIO(volatile BufferDesc *buf)
 static bool
 StartBufferIO(volatile BufferDesc *buf, bool forInput)
 {
-	Assert(!InProgressBuf);
+	Assert(NumInProgressBufs < MAX_IN_PROGRESS_IO);
 
 	for (;;)
 	{
@@ -2611,8 +3397,9 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBufs[NumInProgressBufs] = buf;
+	InProgressForInput[NumInProgressBufs] = forInput;
+	NumInProgressBufs++;
 
 	return true;
 }
@@ -2638,7 +3425,7 @@ static void
 TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 				  int set_flag_bits)
 {
-	Assert(buf == InProgressBuf);
+	int			i;
 
 	LockBufHdr(buf);
 
@@ -2650,13 +3437,25 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = NULL;
+	/* forget it; it's usually the most recently started one */
+	for (i = NumInProgressBufs - 1; i >= 0; i--)
+	{
+		if (InProgressBufs[i] == buf)
+			break;
+	}
+	Assert(i >= 0);
+	for (; i < NumInProgressBufs - 1; i++)
+	{
+		InProgressBufs[i] = InProgressBufs[i + 1];
+		InProgressForInput[i] = InProgressForInput[i + 1];
+	}
+	NumInProgressBufs--;
 
 	LWLockRelease(buf->io_in_progress_lock);
 }
 
 /*
- * AbortBufferIO: Clean up any active buffer I/O after an error.
+ * AbortBufferIO: Clean up all active buffer I/O after an error.
  *
  *	All LWLocks we might have held have been released,
  *	but we haven't yet released buffer pins, so the buffer is still pinned.
@@ -2667,10 +3466,10 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 void
 AbortBufferIO(void)
 {
-	volatile BufferDesc *buf = InProgressBuf;
-
-	if (buf)
+	while (NumInProgressBufs > 0)
 	{
+		volatile BufferDesc *buf = InProgressBufs[NumInProgressBufs - 1];
+
 		/*
 		 * Since LWLockReleaseAll has already been called, we're not holding
 		 * the buffer's io_in_progress_lock. We have to re-acquire it so that
@@ -2681,7 +3480,7 @@ AbortBufferIO(void)
 
 		LockBufHdr(buf);
 		Assert(buf->flags & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (InProgressForInput[NumInProgressBufs - 1])
 		{
 			Assert(!(buf->flags & BM_DIRTY));
 			/* We'd better not think buffer is valid yet */
@@ -19,6 +19,7 @@
 #include "executor/instrument.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
@@ -411,12 +412,17 @@ GetLocalBufferStorage(void)
 		num_bufs = Max(num_bufs_in_block * 2, 16);
 		/* But not more than what we need for all remaining local bufs */
 		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
-		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
+		/* And don't overflow MaxAllocSize, either, counting alignment padding */
+		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ - 1);
 
-		/* Allocate space from TopMemoryContext so it never goes away */
+		/*
+		 * Allocate space from TopMemoryContext so it never goes away.  Align
+		 * the buffers as direct I/O requires (see ALIGNOF_DATA_BUFFER).
+		 */
 		cur_block = (char *) MemoryContextAlloc(TopMemoryContext,
-												num_bufs * BLCKSZ);
+												num_bufs * BLCKSZ +
+												ALIGNOF_DATA_BUFFER);
+		cur_block = (char *) TYPEALIGN(ALIGNOF_DATA_BUFFER, cur_block);
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
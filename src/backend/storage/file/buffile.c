@@ -568,6 +568,23 @@ BufFileSeekBlock(BufFile *file, long blknum)
 					   SEEK_SET);
 }
 
+/*
+ * BufFilePrefetchBlock --- initiate asynchronous read of a block
+ *
+ * This is only a hint to the kernel; the logical position of the BufFile
+ * is not affected, and blocks beyond the end of the file are ignored.
+ */
+void
+BufFilePrefetchBlock(BufFile *file, long blknum)
+{
+	int			fileno = (int) (blknum / BUFFILE_SEG_SIZE);
+
+	if (fileno < file->numFiles)
+		(void) FilePrefetch(file->files[fileno],
+							(off_t) (blknum % BUFFILE_SEG_SIZE) * BLCKSZ,
+							BLCKSZ);
+}
+
 #ifdef NOT_USED
 /*
  * BufFileTellBlock --- block-oriented tell
@@ -45,12 +45,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>		/* for getrlimit */
 #endif
 
 #include "miscadmin.h"
 #include "access/xact.h"
+#include "access/xlogdefs.h"
 #include "catalog/catalog.h"
 #include "catalog/pg_tablespace.h"
 #include "storage/fd.h"
@@ -91,6 +95,13 @@
  */
 int			max_files_per_process = 1000;
 
+/*
+ * GUC parameter: which kinds of files to read and write with O_DIRECT; see
+ * DIRECT_IO_* in fd.h.  The flag itself is added by the callers opening
+ * those files, md.c and xlog.c.
+ */
+int			direct_io = DIRECT_IO_OFF;
+
 /*
  * Maximum number of file descriptors to open for either VFD entries or
  * AllocateFile/AllocateDir operations.  This is initialized to a conservative
@@ -498,6 +509,25 @@ set_max_safe_fds(void)
 		 max_safe_fds, usable_fds, already_open);
 }
 
+/*
+ * assign_direct_io --- GUC assign hook for direct_io
+ *
+ * Anything but off needs PG_O_DIRECT, the same flag md.c and xlog.c open
+ * files with; refuse it where that is 0 instead of silently ignoring it.
+ */
+bool
+assign_direct_io(int newval, bool doit, GucSource source)
+{
+	if (PG_O_DIRECT == 0 && newval != DIRECT_IO_OFF)
+	{
+		ereport(GUC_complaint_elevel(source),
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("direct I/O is not supported on this platform")));
+		return false;
+	}
+	return true;
+}
+
 /*
  * BasicOpenFile --- same as open(2) except can free other FDs if needed
  *
@@ -1121,6 +1151,37 @@ FilePrefetch(File file, off_t offset, int amount)
 #endif
 }
 
+/*
+ * FileWriteback - ask the kernel to start writing back dirty data in the
+ * given range of the file.
+ *
+ * This doesn't wait for the writes to complete, and doesn't guarantee
+ * anything about durability; it just spreads the work the next fsync would
+ * otherwise have to do over time.  Only sync_file_range() does this without
+ * side effects, so this is a no-op on platforms that lack it.  Failures are
+ * not reported, since nothing depends on the writeback actually happening.
+ */
+void
+FileWriteback(File file, off_t offset, off_t nbytes)
+{
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileWriteback: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) nbytes));
+
+#if defined(SYNC_FILE_RANGE_WRITE)
+	if (nbytes <= 0)
+		return;
+
+	if (FileAccess(file) < 0)
+		return;
+
+	(void) sync_file_range(VfdCache[file].fd, offset, nbytes,
+						   SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
 int
 FileRead(File file, char *buffer, int amount)
 {
@@ -1232,6 +1293,155 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileReadV - read into several buffers of "amount" bytes each, from
+ * consecutive locations of the file, like nbuffers calls of FileRead.
+ *
+ * This uses a single readv() call where available.  Returns the total
+ * number of bytes read, which is less than nbuffers * amount at EOF, or -1
+ * on error.
+ */
+int
+FileReadV(File file, char **buffers, int nbuffers, int amount)
+{
+	int			returnCode;
+	int			i;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0 && nbuffers <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d*%d",
+			   file, VfdCache[file].fileName,
+			   (int64) VfdCache[file].seekPos,
+			   nbuffers, amount));
+
+#ifdef WIN32
+	{
+		int			total = 0;
+
+		/* no readv() here, so read the buffers one at a time */
+		for (i = 0; i < nbuffers; i++)
+		{
+			returnCode = FileRead(file, buffers[i], amount);
+			if (returnCode < 0)
+				return returnCode;
+			total += returnCode;
+			if (returnCode != amount)
+				break;
+		}
+		return total;
+	}
+#else
+	{
+		struct iovec iov[PG_IOV_MAX];
+
+		returnCode = FileAccess(file);
+		if (returnCode < 0)
+			return returnCode;
+
+		for (i = 0; i < nbuffers; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = amount;
+		}
+
+retry:
+		returnCode = readv(VfdCache[file].fd, iov, nbuffers);
+
+		if (returnCode >= 0)
+			VfdCache[file].seekPos += returnCode;
+		else
+		{
+			/* OK to retry if interrupted */
+			if (errno == EINTR)
+				goto retry;
+
+			/* Trouble, so assume we don't know the file position anymore */
+			VfdCache[file].seekPos = FileUnknownPos;
+		}
+
+		return returnCode;
+	}
+#endif
+}
+
+/*
+ * FileWriteV - write several buffers of "amount" bytes each to consecutive
+ * locations of the file, like nbuffers calls of FileWrite.
+ *
+ * This uses a single writev() call where available.  Returns the total
+ * number of bytes written, or -1 on error; as in FileWrite, errno is set to
+ * ENOSPC on a short write that didn't set it.
+ */
+int
+FileWriteV(File file, char **buffers, int nbuffers, int amount)
+{
+	int			returnCode;
+	int			i;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0 && nbuffers <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileWriteV: %d (%s) " INT64_FORMAT " %d*%d",
+			   file, VfdCache[file].fileName,
+			   (int64) VfdCache[file].seekPos,
+			   nbuffers, amount));
+
+#ifdef WIN32
+	{
+		int			total = 0;
+
+		/* no writev() here, so write the buffers one at a time */
+		for (i = 0; i < nbuffers; i++)
+		{
+			returnCode = FileWrite(file, buffers[i], amount);
+			if (returnCode < 0)
+				return returnCode;
+			total += returnCode;
+			if (returnCode != amount)
+				break;
+		}
+		return total;
+	}
+#else
+	{
+		struct iovec iov[PG_IOV_MAX];
+
+		returnCode = FileAccess(file);
+		if (returnCode < 0)
+			return returnCode;
+
+		for (i = 0; i < nbuffers; i++)
+		{
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = amount;
+		}
+
+retry:
+		errno = 0;
+		returnCode = writev(VfdCache[file].fd, iov, nbuffers);
+
+		/* if write didn't set errno, assume problem is no disk space */
+		if (returnCode != nbuffers * amount && errno == 0)
+			errno = ENOSPC;
+
+		if (returnCode >= 0)
+			VfdCache[file].seekPos += returnCode;
+		else
+		{
+			/* OK to retry if interrupted */
+			if (errno == EINTR)
+				goto retry;
+
+			/* Trouble, so assume we don't know the file position anymore */
+			VfdCache[file].seekPos = FileUnknownPos;
+		}
+
+		return returnCode;
+	}
+#endif
+}
+
 int
 FileSync(File file)
 {
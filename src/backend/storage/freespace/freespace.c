@@ -113,6 +113,7 @@ static int fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 				   uint8 newValue, uint8 minValue);
 static BlockNumber fsm_search(Relation rel, uint8 min_cat);
 static uint8 fsm_vacuum_page(Relation rel, FSMAddress addr, bool *eof);
+static void fsm_raise_upper(Relation rel, FSMAddress addr, uint8 new_cat);
 
 
 /******** Public API ********/
@@ -192,6 +193,54 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * RecordNewPagesWithFreeSpace - update info about a range of pages that
+ *		were just added to the relation.
+ *
+ * Every page from firstBlk to lastBlk, inclusive, is recorded as having
+ * spaceAvail bytes free.  Unlike RecordPageWithFreeSpace, this also updates
+ * the upper levels of the tree right away, so that searchers find the new
+ * pages without waiting for the next FreeSpaceMapVacuum.
+ */
+void
+RecordNewPagesWithFreeSpace(Relation rel, BlockNumber firstBlk,
+							BlockNumber lastBlk, Size spaceAvail)
+{
+	uint8		new_cat = fsm_space_avail_to_cat(spaceAvail);
+	BlockNumber blk = firstBlk;
+
+	while (blk <= lastBlk)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		dirty = false;
+
+		/* Set all the slots on this FSM page that are in the range */
+		addr = fsm_get_location(blk, &slot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+
+		page = BufferGetPage(buf);
+
+		do
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				dirty = true;
+			blk++;
+			slot++;
+		} while (blk <= lastBlk && slot < SlotsPerFSMPage);
+
+		if (dirty)
+			MarkBufferDirty(buf);
+		UnlockReleaseBuffer(buf);
+
+		fsm_raise_upper(rel, addr, new_cat);
+	}
+}
+
 /*
  * XLogRecordPageWithFreeSpace - like RecordPageWithFreeSpace, for use in
  *		WAL replay
@@ -636,6 +685,34 @@ fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 	return newslot;
 }
 
+/*
+ * Make sure the upper level pages above the given FSM page advertise at
+ * least new_cat, after new_cat has been stored on it.
+ */
+static void
+fsm_raise_upper(Relation rel, FSMAddress addr, uint8 new_cat)
+{
+	while (addr.level < FSM_ROOT_LEVEL)
+	{
+		uint16		parentslot;
+		Buffer		buf;
+		Page		page;
+
+		addr = fsm_get_parent(addr, &parentslot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+
+		page = BufferGetPage(buf);
+
+		if (fsm_get_avail(page, parentslot) < new_cat &&
+			fsm_set_avail(page, parentslot, new_cat))
+			MarkBufferDirty(buf);
+
+		UnlockReleaseBuffer(buf);
+	}
+}
+
 /*
  * Search the tree for a heap page with at least min_cat of free space
  */
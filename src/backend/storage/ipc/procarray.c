@@ -138,6 +138,7 @@ static void DisplayXidCache(void);
 #endif   /* XIDCACHE_DEBUG */
 
 /* Primitives for KnownAssignedXids array handling for standby */
+static bool GetSnapshotDataReuse(Snapshot snapshot);
 static int	KnownAssignedXidsGet(TransactionId *xarray, TransactionId xmax);
 static int KnownAssignedXidsGetAndSetXmin(TransactionId *xarray, TransactionId *xmin,
 							   TransactionId xmax);
@@ -204,6 +205,9 @@ CreateSharedProcArray(void)
 		procArray->numKnownAssignedXids = 0;
 		procArray->maxKnownAssignedXids = TOTAL_MAX_CACHED_SUBXIDS;
 		procArray->lastOverflowedXid = InvalidTransactionId;
+
+		/* 0 is reserved to mean "never computed" in snapshots */
+		ShmemVariableCache->xactCompletionCount = 1;
 	}
 
 	if (XLogRequestRecoveryConnections)
@@ -287,6 +291,9 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		/* Same as for ProcArrayEndTransaction */
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -358,6 +365,9 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
 
+		/* Snapshots computed before now no longer match the running set */
+		ShmemVariableCache->xactCompletionCount++;
+
 		LWLockRelease(ProcArrayLock);
 	}
 	else
@@ -394,11 +404,18 @@ void
 ProcArrayClearTransaction(PGPROC *proc)
 {
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But GetSnapshotData omits the
+	 * current transaction's own XID, so a snapshot we computed earlier must
+	 * not be reused from here on, since it would fail to count the prepared
+	 * transaction as running.  Hence we must bump xactCompletionCount, which
+	 * needs ProcArrayLock.
 	 */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+	ShmemVariableCache->xactCompletionCount++;
+
 	proc->xid = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	proc->xmin = InvalidTransactionId;
@@ -411,6 +428,8 @@ ProcArrayClearTransaction(PGPROC *proc)
 	/* Clear the subtransaction-XID cache too */
 	proc->subxids.nxids = 0;
 	proc->subxids.overflowed = false;
+
+	LWLockRelease(ProcArrayLock);
 }
 
 void
@@ -995,6 +1014,49 @@ GetOldestXmin(bool allDbs, bool ignoreVacuum)
 	return result;
 }
 
+/*
+ * GetSnapshotDataReuse -- helper for GetSnapshotData
+ *
+ * A snapshot's contents depend only on the set of running XIDs below its
+ * xmax.  XIDs assigned after it was taken are >= xmax and so are treated as
+ * running anyway; thus the contents can only go stale when a transaction or
+ * subtransaction leaves the running set, which always happens under
+ * exclusive ProcArrayLock and bumps xactCompletionCount.  If the counter
+ * hasn't moved since the snapshot was computed, just refresh the fields that
+ * depend on the calling transaction and return true.
+ *
+ * We don't try this in recovery, since KnownAssignedXids changes without
+ * going through the counter.
+ *
+ * Caller must hold ProcArrayLock (shared is enough).
+ */
+static bool
+GetSnapshotDataReuse(Snapshot snapshot)
+{
+	if (snapshot->takenDuringRecovery)
+		return false;
+
+	if (snapshot->snapXactCompletionCount == 0 ||
+		snapshot->snapXactCompletionCount !=
+		ShmemVariableCache->xactCompletionCount)
+		return false;
+
+	/*
+	 * The snapshot's xmin is still the oldest running XID, so it's what a
+	 * freshly computed snapshot would advertise as well.
+	 */
+	if (!TransactionIdIsValid(MyProc->xmin))
+		MyProc->xmin = TransactionXmin = snapshot->xmin;
+	RecentXmin = snapshot->xmin;
+
+	snapshot->curcid = GetCurrentCommandId(false);
+	snapshot->active_count = 0;
+	snapshot->regd_count = 0;
+	snapshot->copied = false;
+
+	return true;
+}
+
 /*
  * GetSnapshotData -- returns information about running transactions.
  *
@@ -1025,6 +1087,12 @@ GetOldestXmin(bool allDbs, bool ignoreVacuum)
  *			running transactions, except those running LAZY VACUUM).  This is
  *			the same computation done by GetOldestXmin(true, true).
  *
+ * If no transaction has left the set of running XIDs since the snapshot was
+ * last filled in, its contents are still right and we skip rebuilding them
+ * (see GetSnapshotDataReuse).  In that case RecentGlobalXmin is left alone;
+ * the previously computed value is older than the current one would be, and
+ * so still safe to use.
+ *
  * Note: this function should probably not be called with an argument that's
  * not statically allocated (see xip allocation below).
  */
@@ -1039,6 +1107,7 @@ GetSnapshotData(Snapshot snapshot)
 	int			count = 0;
 	int			subcount = 0;
 	bool		suboverflowed = false;
+	uint64		curXactCompletionCount = 0;
 
 	Assert(snapshot != NULL);
 
@@ -1082,6 +1151,16 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	LWLockAcquire(ProcArrayLock, LW_SHARED);
 
+	if (GetSnapshotDataReuse(snapshot))
+	{
+		LWLockRelease(ProcArrayLock);
+		return snapshot;
+	}
+
+	/* Snapshots taken in recovery are never reused, see above */
+	if (!snapshot->takenDuringRecovery)
+		curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
 	/* xmax is always latestCompletedXid + 1 */
 	xmax = ShmemVariableCache->latestCompletedXid;
 	Assert(TransactionIdIsNormal(xmax));
@@ -1225,6 +1304,7 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->xcnt = count;
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
+	snapshot->snapXactCompletionCount = curXactCompletionCount;
 
 	snapshot->curcid = GetCurrentCommandId(false);
 
@@ -2117,6 +2197,9 @@ XidCacheRemoveRunningXids(TransactionId xid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
 
+	/* The subxids just removed are no longer running */
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -166,6 +166,9 @@ NumLWLocks(void)
 	/* bufmgr.c needs two for each shared buffer */
 	numLocks += 2 * NBuffers;
 
+	/* proc.c needs one for each backend or auxiliary process */
+	numLocks += MaxBackends + NUM_AUXILIARY_PROCS;
+
 	/* clog.c needs one per CLOG buffer */
 	numLocks += NUM_CLOG_BUFFERS;
 
@@ -423,7 +426,7 @@ LWLockAcquire(LWLockId lockid, LWLockMode mode)
 			elog(PANIC, "cannot wait without a PGPROC structure");
 
 		proc->lwWaiting = true;
-		proc->lwExclusive = (mode == LW_EXCLUSIVE);
+		proc->lwWaitMode = mode;
 		proc->lwWaitLink = NULL;
 		if (lock->head == NULL)
 			lock->head = proc;
@@ -557,6 +560,215 @@ LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode)
 	return !mustwait;
 }
 
+/*
+ * LWLockWaitForVar - wait until lock is free, or a variable is updated
+ *
+ * If the lock is held and *valptr equals oldval, waits until the lock is
+ * either freed, or the lock holder updates *valptr by calling
+ * LWLockUpdateVar.  If the lock is free on exit (immediately or after
+ * waiting), returns true.  If the lock is still held, but *valptr no longer
+ * matches oldval, returns false and sets *newval to the current value in
+ * *valptr.
+ *
+ * The lock is never acquired, so unlike LWLockAcquire this can't be blocked
+ * by a backend that has merely queued up for the lock behind the current
+ * holder.  Note: this function ignores shared lock holders; if the lock is
+ * held in shared mode, returns 'true'.
+ */
+bool
+LWLockWaitForVar(LWLockId lockid, uint64 *valptr, uint64 oldval,
+				 uint64 *newval)
+{
+	volatile LWLock *lock = &(LWLockArray[lockid].lock);
+	volatile uint64 *valp = valptr;
+	PGPROC	   *proc = MyProc;
+	int			extraWaits = 0;
+	bool		result = false;
+
+	PRINT_LWDEBUG("LWLockWaitForVar", lockid, lock);
+
+	/*
+	 * Lock out cancel/die interrupts while we sleep on the lock.  There is
+	 * no cleanup mechanism to remove us from the wait queue if we got
+	 * interrupted.
+	 */
+	HOLD_INTERRUPTS();
+
+	/*
+	 * Loop here to check the lock's status after each time we are signaled.
+	 */
+	for (;;)
+	{
+		bool		mustwait;
+		uint64		value;
+
+		/* Acquire mutex.  Time spent holding mutex should be short! */
+		SpinLockAcquire(&lock->mutex);
+
+		/* Is the lock now free, and if not, does the value match? */
+		if (lock->exclusive == 0)
+		{
+			result = true;
+			mustwait = false;
+		}
+		else
+		{
+			value = *valp;
+			if (value != oldval)
+			{
+				result = false;
+				mustwait = false;
+				*newval = value;
+			}
+			else
+				mustwait = true;
+		}
+
+		if (!mustwait)
+			break;				/* the lock was free or value didn't match */
+
+		/*
+		 * Add myself to wait queue.  Waiters in LW_WAIT_UNTIL_FREE mode are
+		 * awakened by every release of the lock and every LWLockUpdateVar,
+		 * wherever they are in the queue.
+		 */
+		if (proc == NULL)
+			elog(PANIC, "cannot wait without a PGPROC structure");
+
+		proc->lwWaiting = true;
+		proc->lwWaitMode = LW_WAIT_UNTIL_FREE;
+		proc->lwWaitLink = NULL;
+		if (lock->head == NULL)
+			lock->head = proc;
+		else
+			lock->tail->lwWaitLink = proc;
+		lock->tail = proc;
+
+		/* Can release the mutex now */
+		SpinLockRelease(&lock->mutex);
+
+		/*
+		 * Wait until awakened.  As in LWLockAcquire, absorb and later
+		 * re-deliver any wakeups that were meant for somebody else.
+		 */
+		LOG_LWDEBUG("LWLockWaitForVar", lockid, "waiting");
+
+#ifdef LWLOCK_STATS
+		block_counts[lockid]++;
+#endif
+
+		TRACE_POSTGRESQL_LWLOCK_WAIT_START(lockid, LW_EXCLUSIVE);
+
+		for (;;)
+		{
+			/* "false" means cannot accept cancel/die interrupt here. */
+			PGSemaphoreLock(&proc->sem, false);
+			if (!proc->lwWaiting)
+				break;
+			extraWaits++;
+		}
+
+		TRACE_POSTGRESQL_LWLOCK_WAIT_DONE(lockid, LW_EXCLUSIVE);
+
+		LOG_LWDEBUG("LWLockWaitForVar", lockid, "awakened");
+
+		/* Now loop back and check the status of the lock again. */
+	}
+
+	/* We are done looking at the shared state of the lock. */
+	SpinLockRelease(&lock->mutex);
+
+	/*
+	 * Fix the process wait semaphore's count for any absorbed wakeups.
+	 */
+	while (extraWaits-- > 0)
+		PGSemaphoreUnlock(&proc->sem);
+
+	/*
+	 * Now okay to allow cancel/die interrupts.
+	 */
+	RESUME_INTERRUPTS();
+
+	return result;
+}
+
+/*
+ * LWLockUpdateVar - update a variable and wake up waiters atomically
+ *
+ * Sets *valptr to 'val', and wakes up all processes waiting for us with
+ * LWLockWaitForVar().  Setting the value and waking up the processes happen
+ * atomically so that any process calling LWLockWaitForVar() on the same
+ * lock is guaranteed to see the new value, and act accordingly.
+ *
+ * The caller must be holding the lock in exclusive mode.
+ */
+void
+LWLockUpdateVar(LWLockId lockid, uint64 *valptr, uint64 val)
+{
+	volatile LWLock *lock = &(LWLockArray[lockid].lock);
+	volatile uint64 *valp = valptr;
+	PGPROC	   *head = NULL;
+	PGPROC	   *tail = NULL;
+	PGPROC	   *prev = NULL;
+	PGPROC	   *proc;
+	PGPROC	   *next;
+
+	PRINT_LWDEBUG("LWLockUpdateVar", lockid, lock);
+
+	/* Acquire mutex.  Time spent holding mutex should be short! */
+	SpinLockAcquire(&lock->mutex);
+
+	Assert(lock->exclusive == 1);
+
+	/* Update the lock's value */
+	*valp = val;
+
+	/*
+	 * Remove all the LW_WAIT_UNTIL_FREE waiters from the queue, wherever
+	 * they are in it.  Waiters for the lock itself stay where they are.
+	 */
+	for (proc = lock->head; proc != NULL; proc = next)
+	{
+		next = proc->lwWaitLink;
+		if (proc->lwWaitMode != LW_WAIT_UNTIL_FREE)
+		{
+			prev = proc;
+			continue;
+		}
+
+		/* unlink it from the lock's queue ... */
+		if (prev == NULL)
+			lock->head = next;
+		else
+			prev->lwWaitLink = next;
+		if (lock->tail == proc)
+			lock->tail = prev;
+
+		/* ... and add it to our list of procs to wake */
+		proc->lwWaitLink = NULL;
+		if (head == NULL)
+			head = proc;
+		else
+			tail->lwWaitLink = proc;
+		tail = proc;
+	}
+
+	/* We are done updating shared state of the lock itself. */
+	SpinLockRelease(&lock->mutex);
+
+	/*
+	 * Awaken any waiters I removed from the queue.
+	 */
+	while (head != NULL)
+	{
+		proc = head;
+		head = proc->lwWaitLink;
+		proc->lwWaitLink = NULL;
+		proc->lwWaiting = false;
+		PGSemaphoreUnlock(&proc->sem);
+	}
+}
+
 /*
  * LWLockRelease - release a previously acquired lock
  */
@@ -599,38 +811,68 @@ LWLockRelease(LWLockId lockid)
 
 	/*
 	 * See if I need to awaken any waiters.  If I released a non-last shared
-	 * hold, there cannot be anything to do.  Also, do not awaken any waiters
-	 * if someone has already awakened waiters that haven't yet acquired the
-	 * lock.
+	 * hold, there cannot be anything to do.  Waiters in LW_WAIT_UNTIL_FREE
+	 * mode don't acquire the lock, so all of them are awakened.  Otherwise,
+	 * do not awaken any waiters if someone has already awakened waiters that
+	 * haven't yet acquired the lock.
 	 */
-	head = lock->head;
-	if (head != NULL)
+	head = NULL;
+	if (lock->head != NULL && lock->exclusive == 0 && lock->shared == 0)
 	{
-		if (lock->exclusive == 0 && lock->shared == 0 && lock->releaseOK)
+		PGPROC	   *tail = NULL;
+		PGPROC	   *prev = NULL;
+		PGPROC	   *next;
+		bool		grant = lock->releaseOK;
+		bool		granted = false;
+		bool		grantedExclusive = false;
+
+		/*
+		 * Remove the to-be-awakened PGPROCs from the queue.  If the front
+		 * waiter (ignoring LW_WAIT_UNTIL_FREE ones) wants exclusive lock,
+		 * awaken him only.  Otherwise awaken as many waiters as want shared
+		 * access.
+		 */
+		for (proc = lock->head; proc != NULL; proc = next)
 		{
-			/*
-			 * Remove the to-be-awakened PGPROCs from the queue.  If the front
-			 * waiter wants exclusive lock, awaken him only. Otherwise awaken
-			 * as many waiters as want shared access.
-			 */
-			proc = head;
-			if (!proc->lwExclusive)
+			next = proc->lwWaitLink;
+			if (proc->lwWaitMode != LW_WAIT_UNTIL_FREE)
 			{
-				while (proc->lwWaitLink != NULL &&
-					   !proc->lwWaitLink->lwExclusive)
-					proc = proc->lwWaitLink;
+				if (grant &&
+					(!granted ||
+					 (!grantedExclusive && proc->lwWaitMode == LW_SHARED)))
+				{
+					granted = true;
+					grantedExclusive = (proc->lwWaitMode == LW_EXCLUSIVE);
+				}
+				else
+				{
+					/* no more waiters can be granted the lock */
+					grant = false;
+					prev = proc;
+					continue;
+				}
 			}
-			/* proc is now the last PGPROC to be released */
-			lock->head = proc->lwWaitLink;
+
+			/* unlink it from the lock's queue ... */
+			if (prev == NULL)
+				lock->head = next;
+			else
+				prev->lwWaitLink = next;
+			if (lock->tail == proc)
+				lock->tail = prev;
+
+			/* ... and add it to our list of procs to wake */
 			proc->lwWaitLink = NULL;
-			/* prevent additional wakeups until retryer gets to run */
-			lock->releaseOK = false;
-		}
-		else
-		{
-			/* lock is still held, can't awaken anything */
-			head = NULL;
+			if (head == NULL)
+				head = proc;
+			else
+				tail->lwWaitLink = proc;
+			tail = proc;
 		}
+
+		/* prevent additional wakeups until retryer gets to run */
+		if (granted)
+			lock->releaseOK = false;
 	}
 
 	/* We are done updating shared state of the lock itself. */
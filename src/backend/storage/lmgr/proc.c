@@ -67,7 +67,7 @@ PGPROC	   *MyProc = NULL;
 NON_EXEC_STATIC slock_t *ProcStructLock = NULL;
 
 /* Pointers to shared-memory structures */
-NON_EXEC_STATIC PROC_HDR *ProcGlobal = NULL;
+PROC_HDR   *ProcGlobal = NULL;
 NON_EXEC_STATIC PGPROC *AuxiliaryProcs = NULL;
 
 /* If we are waiting for a lock, this points to the associated LOCALLOCK */
@@ -108,6 +108,9 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGPROC)));
 	/* MyProcs, including autovacuum workers and launcher */
 	size = add_size(size, mul_size(MaxBackends, sizeof(PGPROC)));
+	/* allProcs pointer array */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS,
+								   sizeof(PGPROC *)));
 	/* ProcStructLock */
 	size = add_size(size, sizeof(slock_t));
 	/* startupBufferPinWaitBufId */
@@ -180,6 +183,19 @@ InitProcGlobal(void)
 	ProcGlobal->freeProcs = NULL;
 	ProcGlobal->autovacFreeProcs = NULL;
 
+	/*
+	 * The allProcs array lets the lock manager find every PGPROC that might
+	 * be holding fast-path relation locks.  Prepared-transaction dummy procs
+	 * are not included, since they never hold fast-path locks.
+	 */
+	ProcGlobal->allProcs = (PGPROC **)
+		ShmemAlloc((MaxBackends + NUM_AUXILIARY_PROCS) * sizeof(PGPROC *));
+	if (!ProcGlobal->allProcs)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory")));
+	ProcGlobal->allProcCount = 0;
+
 	ProcGlobal->spins_per_delay = DEFAULT_SPINS_PER_DELAY;
 
 	/*
@@ -194,8 +210,10 @@ InitProcGlobal(void)
 	for (i = 0; i < MaxConnections; i++)
 	{
 		PGSemaphoreCreate(&(procs[i].sem));
+		procs[i].backendLock = LWLockAssign();
 		procs[i].links.next = (SHM_QUEUE *) ProcGlobal->freeProcs;
 		ProcGlobal->freeProcs = &procs[i];
+		ProcGlobal->allProcs[ProcGlobal->allProcCount++] = &procs[i];
 	}
 
 	/*
@@ -212,8 +230,10 @@ InitProcGlobal(void)
 	for (i = 0; i < autovacuum_max_workers + 1; i++)
 	{
 		PGSemaphoreCreate(&(procs[i].sem));
+		procs[i].backendLock = LWLockAssign();
 		procs[i].links.next = (SHM_QUEUE *) ProcGlobal->autovacFreeProcs;
 		ProcGlobal->autovacFreeProcs = &procs[i];
+		ProcGlobal->allProcs[ProcGlobal->allProcCount++] = &procs[i];
 	}
 
 	/*
@@ -224,6 +244,8 @@ InitProcGlobal(void)
 	{
 		AuxiliaryProcs[i].pid = 0;		/* marks auxiliary proc as not in use */
 		PGSemaphoreCreate(&(AuxiliaryProcs[i].sem));
+		AuxiliaryProcs[i].backendLock = LWLockAssign();
+		ProcGlobal->allProcs[ProcGlobal->allProcCount++] = &AuxiliaryProcs[i];
 	}
 
 	/* Create ProcStructLock spinlock, too */
@@ -323,12 +345,14 @@ InitProcess(void)
 	if (IsAutoVacuumWorkerProcess())
 		MyProc->vacuumFlags |= PROC_IS_AUTOVACUUM;
 	MyProc->lwWaiting = false;
-	MyProc->lwExclusive = false;
+	MyProc->lwWaitMode = 0;
 	MyProc->lwWaitLink = NULL;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
 	for (i = 0; i < NUM_LOCK_PARTITIONS; i++)
 		SHMQueueInit(&(MyProc->myProcLocks[i]));
+	MyProc->fpLockBits = 0;
+	MemSet(MyProc->fpRelId, 0, sizeof(MyProc->fpRelId));
 	MyProc->recoveryConflictPending = false;
 
 	/*
@@ -458,12 +482,14 @@ InitAuxiliaryProcess(void)
 	MyProc->inCommit = false;
 	MyProc->vacuumFlags = 0;
 	MyProc->lwWaiting = false;
-	MyProc->lwExclusive = false;
+	MyProc->lwWaitMode = 0;
 	MyProc->lwWaitLink = NULL;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
 	for (i = 0; i < NUM_LOCK_PARTITIONS; i++)
 		SHMQueueInit(&(MyProc->myProcLocks[i]));
+	MyProc->fpLockBits = 0;
+	MemSet(MyProc->fpRelId, 0, sizeof(MyProc->fpRelId));
 
 	/*
 	 * We might be reusing a semaphore that belonged to a failed process. So
@@ -578,6 +604,9 @@ LockWaitCancel(void)
 {
 	LWLockId	partitionLock;
 
+	/* If we were acquiring a strong relation lock, give back its count */
+	AbortStrongLockAcquire();
+
 	/* Nothing to do if we weren't waiting for a lock */
 	if (lockAwaited == NULL)
 		return;
@@ -38,6 +38,20 @@
 #define FORGET_DATABASE_FSYNC	(InvalidBlockNumber-1)
 #define UNLINK_RELATION_REQUEST (InvalidBlockNumber-2)
 
+/*
+ * Flags for opening segment files.  With direct I/O, the buffers we read
+ * into and write from must be aligned (see ALIGNOF_DATA_BUFFER).  Shared and
+ * local buffers are, but some callers pass palloc'd pages; those are copied
+ * through md_bounce_buffer.
+ */
+#define MD_DIRECT_IO			((direct_io & DIRECT_IO_DATA) != 0)
+#define MD_OPEN_FLAGS			(O_RDWR | PG_BINARY | \
+								 (MD_DIRECT_IO ? PG_O_DIRECT : 0))
+#define MD_BUFFER_IS_ALIGNED(buf) \
+	((char *) TYPEALIGN(ALIGNOF_DATA_BUFFER, (buf)) == (char *) (buf))
+
+static char *md_bounce_buffer = NULL;
+
 /*
  * On Windows, we have to interpret EACCES as possibly meaning the same as
  * ENOENT, because if a file is unlinked-but-not-yet-gone on that platform,
@@ -160,6 +174,8 @@ static void register_dirty_segment(SMgrRelation reln, ForkNumber forknum,
 					   MdfdVec *seg);
 static void register_unlink(RelFileNode rnode);
 static MdfdVec *_fdvec_alloc(void);
+static char *md_get_iobuf(char *buffer, bool forWrite);
+static bool md_buffers_aligned(char **buffers, BlockNumber nbuffers);
 static char *_mdfd_segpath(SMgrRelation reln, ForkNumber forknum,
 			  BlockNumber segno);
 static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
@@ -255,7 +271,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 
 	if (fd < 0)
 	{
@@ -268,7 +284,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		 * already, even if isRedo is not set.	(See also mdopen)
 		 */
 		if (isRedo || IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -421,6 +437,7 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 {
 	off_t		seekpos;
 	int			nbytes;
+	char	   *iobuf;
 	MdfdVec    *v;
 
 	/* This assert is too expensive to have on normally ... */
@@ -461,7 +478,8 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	if ((nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ)) != BLCKSZ)
+	iobuf = md_get_iobuf(buffer, true);
+	if ((nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ)) != BLCKSZ)
 	{
 		if (nbytes < 0)
 			ereport(ERROR,
@@ -507,7 +525,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 
 	if (fd < 0)
 	{
@@ -518,7 +536,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 		 * substitute for mdcreate() in bootstrap mode only. (See mdcreate)
 		 */
 		if (IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 		if (fd < 0)
 		{
 			if (behavior == EXTENSION_RETURN_NULL &&
@@ -582,6 +600,13 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 	off_t		seekpos;
 	MdfdVec    *v;
 
+	/*
+	 * With direct I/O, the kernel would read the block into its cache, which
+	 * our read doesn't use.
+	 */
+	if (MD_DIRECT_IO)
+		return;
+
 	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
 
 	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
@@ -602,6 +627,7 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 {
 	off_t		seekpos;
 	int			nbytes;
+	char	   *iobuf;
 	MdfdVec    *v;
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
@@ -621,7 +647,10 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ);
+	iobuf = md_get_iobuf(buffer, false);
+	nbytes = FileRead(v->mdfd_vfd, iobuf, BLCKSZ);
+	if (iobuf != buffer && nbytes == BLCKSZ)
+		memcpy(buffer, iobuf, BLCKSZ);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.spcNode,
@@ -670,6 +699,7 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 {
 	off_t		seekpos;
 	int			nbytes;
+	char	   *iobuf;
 	MdfdVec    *v;
 
 	/* This assert is too expensive to have on normally ... */
@@ -694,7 +724,8 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ);
+	iobuf = md_get_iobuf(buffer, true);
+	nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ);
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
 										reln->smgr_rnode.spcNode,
@@ -724,6 +755,226 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	mdreadv() -- Read the specified consecutive blocks of a relation.
+ *
+ *		Equivalent to mdread() on each block, but reads each run of up to
+ *		PG_IOV_MAX blocks within a segment with a single system call.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	/* unaligned buffers need to go through mdread's bounce buffer */
+	if (MD_DIRECT_IO && !md_buffers_aligned(buffers, nblocks))
+	{
+		for (; nblocks > 0; nblocks--)
+			mdread(reln, forknum, blocknum++, *buffers++);
+		return;
+	}
+
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		int			nthis;
+		int			i;
+		MdfdVec    *v;
+
+		/* don't cross a segment boundary, nor exceed PG_IOV_MAX */
+		nthis = Min(nblocks,
+					RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+		nthis = Min(nthis, PG_IOV_MAX);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+											reln->smgr_rnode.spcNode,
+											reln->smgr_rnode.dbNode,
+											reln->smgr_rnode.relNode);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		nbytes = FileReadV(v->mdfd_vfd, buffers, nthis, BLCKSZ);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+										   reln->smgr_rnode.spcNode,
+										   reln->smgr_rnode.dbNode,
+										   reln->smgr_rnode.relNode,
+										   nbytes,
+										   BLCKSZ * nthis);
+
+		if (nbytes != BLCKSZ * nthis)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+								blocknum, blocknum + nthis - 1,
+								FilePathName(v->mdfd_vfd))));
+
+			/*
+			 * Short read.  The blocks read completely are fine; for the rest,
+			 * do what mdread does: zero them if zero_damaged_pages is ON or
+			 * we are InRecovery, else complain about the first one.
+			 */
+			i = nbytes / BLCKSZ;
+			if (zero_damaged_pages || InRecovery)
+			{
+				for (; i < nthis; i++)
+					MemSet(buffers[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								blocknum + i, FilePathName(v->mdfd_vfd),
+								nbytes - i * BLCKSZ, BLCKSZ)));
+		}
+
+		buffers += nthis;
+		blocknum += nthis;
+		nblocks -= nthis;
+	}
+}
+
+/*
+ *	mdwritev() -- Write the supplied consecutive blocks of a relation.
+ *
+ *		Equivalent to mdwrite() on each block, but writes each run of up to
+ *		PG_IOV_MAX blocks within a segment with a single system call.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, BlockNumber nblocks, bool isTemp)
+{
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum + nblocks <= mdnblocks(reln, forknum));
+#endif
+
+	/* unaligned buffers need to go through mdwrite's bounce buffer */
+	if (MD_DIRECT_IO && !md_buffers_aligned(buffers, nblocks))
+	{
+		for (; nblocks > 0; nblocks--)
+			mdwrite(reln, forknum, blocknum++, *buffers++, isTemp);
+		return;
+	}
+
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		int			nthis;
+		MdfdVec    *v;
+
+		/* don't cross a segment boundary, nor exceed PG_IOV_MAX */
+		nthis = Min(nblocks,
+					RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+		nthis = Min(nthis, PG_IOV_MAX);
+
+		TRACE_POSTGRESQL_SMGR_MD_WRITE_START(forknum, blocknum,
+											 reln->smgr_rnode.spcNode,
+											 reln->smgr_rnode.dbNode,
+											 reln->smgr_rnode.relNode);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, isTemp, EXTENSION_FAIL);
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		nbytes = FileWriteV(v->mdfd_vfd, buffers, nthis, BLCKSZ);
+
+		TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
+											reln->smgr_rnode.spcNode,
+											reln->smgr_rnode.dbNode,
+											reln->smgr_rnode.relNode,
+											nbytes,
+											BLCKSZ * nthis);
+
+		if (nbytes != BLCKSZ * nthis)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not write blocks %u..%u in file \"%s\": %m",
+								blocknum, blocknum + nthis - 1,
+								FilePathName(v->mdfd_vfd))));
+			/* short write: complain appropriately */
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not write blocks %u..%u in file \"%s\": wrote only %d of %d bytes",
+							blocknum, blocknum + nthis - 1,
+							FilePathName(v->mdfd_vfd),
+							nbytes, BLCKSZ * nthis),
+					 errhint("Check free disk space.")));
+		}
+
+		if (!isTemp)
+			register_dirty_segment(reln, forknum, v);
+
+		buffers += nthis;
+		blocknum += nthis;
+		nblocks -= nthis;
+	}
+}
+
+/*
+ *	mdwriteback() -- Start writeback of a range of blocks of a relation.
+ *
+ *		The blocks have been written already; this just asks the kernel to
+ *		start sending them to disk.  The relation may have been truncated or
+ *		dropped since the blocks were written, so missing segments are
+ *		silently ignored.
+ */
+void
+mdwriteback(SMgrRelation reln, ForkNumber forknum,
+			BlockNumber blocknum, BlockNumber nblocks)
+{
+	/* with direct I/O, the data is not left in the kernel's cache */
+	if (MD_DIRECT_IO)
+		return;
+
+	while (nblocks > 0)
+	{
+		BlockNumber nflush = nblocks;
+		off_t		seekpos;
+		MdfdVec    *v;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_RETURN_NULL);
+		if (v == NULL)
+			return;
+
+		/* don't cross a segment boundary */
+		if (blocknum / ((BlockNumber) RELSEG_SIZE) !=
+			(blocknum + nblocks - 1) / ((BlockNumber) RELSEG_SIZE))
+			nflush = RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		FileWriteback(v->mdfd_vfd, seekpos, (off_t) BLCKSZ * nflush);
+
+		nblocks -= nflush;
+		blocknum += nflush;
+	}
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
@@ -1458,6 +1709,50 @@ _fdvec_alloc(void)
 	return (MdfdVec *) MemoryContextAlloc(MdCxt, sizeof(MdfdVec));
 }
 
+/*
+ *	md_get_iobuf() -- Get a buffer suitable for reading or writing a block.
+ *
+ * Returns the caller's buffer, unless we use direct I/O and it isn't aligned
+ * suitably; then the bounce buffer is returned instead, holding a copy of the
+ * caller's data if forWrite.  After a read, the caller must copy the data
+ * from the bounce buffer to its own.
+ */
+static char *
+md_get_iobuf(char *buffer, bool forWrite)
+{
+	if (!MD_DIRECT_IO || MD_BUFFER_IS_ALIGNED(buffer))
+		return buffer;
+
+	if (md_bounce_buffer == NULL)
+	{
+		char	   *space;
+
+		space = MemoryContextAlloc(MdCxt, BLCKSZ + ALIGNOF_DATA_BUFFER);
+		md_bounce_buffer = (char *) TYPEALIGN(ALIGNOF_DATA_BUFFER, space);
+	}
+
+	if (forWrite)
+		memcpy(md_bounce_buffer, buffer, BLCKSZ);
+
+	return md_bounce_buffer;
+}
+
+/*
+ *	md_buffers_aligned() -- Are all the buffers suitable for direct I/O?
+ */
+static bool
+md_buffers_aligned(char **buffers, BlockNumber nbuffers)
+{
+	BlockNumber i;
+
+	for (i = 0; i < nbuffers; i++)
+	{
+		if (!MD_BUFFER_IS_ALIGNED(buffers[i]))
+			return false;
+	}
+	return true;
+}
+
 /*
  * Return the filename for the specified segment of the relation. The
  * returned string is palloc'd.
@@ -1498,7 +1793,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags, 0600);
+	fd = PathNameOpenFile(fullpath, MD_OPEN_FLAGS | oflags, 0600);
 
 	pfree(fullpath);
 
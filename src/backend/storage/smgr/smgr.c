@@ -55,6 +55,14 @@ typedef struct f_smgr
 										  BlockNumber blocknum, char *buffer);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 							BlockNumber blocknum, char *buffer, bool isTemp);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+								   BlockNumber blocknum, char **buffers,
+								   BlockNumber nblocks);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, char **buffers,
+								BlockNumber nblocks, bool isTemp);
+	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_truncate) (SMgrRelation reln, ForkNumber forknum,
 										   BlockNumber nblocks, bool isTemp);
@@ -68,8 +76,8 @@ typedef struct f_smgr
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
 	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdnblocks, mdtruncate, mdimmedsync,
-		mdpreckpt, mdsync, mdpostckpt
+		mdprefetch, mdread, mdwrite, mdreadv, mdwritev, mdwriteback,
+		mdnblocks, mdtruncate, mdimmedsync, mdpreckpt, mdsync, mdpostckpt
 	}
 };
 
@@ -438,6 +446,51 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											  buffer, isTemp);
 }
 
+/*
+ *	smgrreadv() -- read a run of consecutive blocks of a relation into the
+ *				   supplied buffers.
+ *
+ *		Equivalent to smgrread() on each of the blocks, but the storage
+ *		manager may transfer them with fewer system calls.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_readv)) (reln, forknum, blocknum,
+											  buffers, nblocks);
+}
+
+/*
+ *	smgrwritev() -- Write the supplied buffers out to a run of consecutive
+ *					blocks of a relation.
+ *
+ *		Equivalent to smgrwrite() on each of the blocks, but the storage
+ *		manager may transfer them with fewer system calls.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char **buffers, BlockNumber nblocks, bool isTemp)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writev)) (reln, forknum, blocknum,
+											   buffers, nblocks, isTemp);
+}
+
+/*
+ *	smgrwriteback() -- Start writeback of the specified blocks.
+ *
+ *		The blocks must have been written with smgrwrite() already.  This
+ *		only asks the kernel to begin writing them to disk, so that the
+ *		eventual fsync has less to do; it gives no durability guarantee.
+ */
+void
+smgrwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  BlockNumber nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writeback)) (reln, forknum, blocknum,
+												  nblocks);
+}
+
 /*
  *	smgrnblocks() -- Calculate the number of blocks in the
  *					 supplied relation.
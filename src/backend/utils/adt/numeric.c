@@ -34,6 +34,7 @@
 #include "utils/builtins.h"
 #include "utils/int8.h"
 #include "utils/numeric.h"
+#include "utils/sortsupport.h"
 
 /* ----------
  * Uncomment the following to enable compilation of dump_numeric()
@@ -1105,6 +1106,121 @@ numeric_cmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(result);
 }
 
+/*
+ * Sort support for numeric.
+ *
+ * The comparator avoids the fmgr overhead of numeric_cmp.  Where Datums are
+ * 64 bits wide we also supply abbreviated keys: the weight and the first
+ * four NBASE digits of the value, packed into a signed integer so that
+ * comparing two keys gives the same answer as comparing the values, except
+ * that values agreeing on those digits compare equal.  Only digits beyond
+ * the first 16 decimal digits are lost, so the abbreviation is hardly ever
+ * a bad bet, and we never abandon it.
+ */
+static int
+numeric_fast_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	Numeric		nx = DatumGetNumeric(x);
+	Numeric		ny = DatumGetNumeric(y);
+	int			result;
+
+	result = cmp_numerics(nx, ny);
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(nx) != x)
+		pfree(nx);
+	if (PointerGetDatum(ny) != y)
+		pfree(ny);
+
+	return result;
+}
+
+#if SIZEOF_DATUM == 8 && NBASE == 10000
+
+/*
+ * Layout of an abbreviated key's magnitude: 7 bits of offset weight, then
+ * four 14-bit digits.  Weights outside the representable range are clamped,
+ * which loses nothing but ordering among values that are all enormous or
+ * all tiny.
+ */
+#define NUMERIC_ABBREV_WEIGHT_OFFSET	44
+#define NUMERIC_ABBREV_MAX_WEIGHT		83
+#define NUMERIC_ABBREV_MAX				INT64CONST(0x7FFFFFFFFFFFFFFF)
+
+static Datum
+numeric_abbrev_convert(Datum original, SortSupport ssup)
+{
+	Numeric		value = DatumGetNumeric(original);
+	int			ndigits = NUMERIC_NDIGITS(value);
+	NumericDigit *digits = NUMERIC_DIGITS(value);
+	int			weight = value->n_weight;
+	int64		result;
+
+	if (NUMERIC_IS_NAN(value))
+		result = NUMERIC_ABBREV_MAX;	/* NaN sorts after everything */
+	else if (ndigits == 0)
+		result = 0;
+	else
+	{
+		if (weight > NUMERIC_ABBREV_MAX_WEIGHT)
+			result = NUMERIC_ABBREV_MAX;
+		else if (weight < -NUMERIC_ABBREV_WEIGHT_OFFSET)
+			result = 0;
+		else
+		{
+			result = ((int64) (weight + NUMERIC_ABBREV_WEIGHT_OFFSET)) << 56;
+			result |= ((int64) digits[0]) << 42;
+			if (ndigits > 1)
+				result |= ((int64) digits[1]) << 28;
+			if (ndigits > 2)
+				result |= ((int64) digits[2]) << 14;
+			if (ndigits > 3)
+				result |= (int64) digits[3];
+		}
+
+		if (NUMERIC_SIGN(value) == NUMERIC_NEG)
+			result = -result;
+	}
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(value) != original)
+		pfree(value);
+
+	return (Datum) result;
+}
+
+static int
+numeric_cmp_abbrev(Datum x, Datum y, SortSupport ssup)
+{
+	int64		a = (int64) x;
+	int64		b = (int64) y;
+
+	if (a > b)
+		return 1;
+	else if (a == b)
+		return 0;
+	else
+		return -1;
+}
+#endif   /* SIZEOF_DATUM == 8 && NBASE == 10000 */
+
+void
+numeric_sortsupport(SortSupport ssup)
+{
+#if SIZEOF_DATUM == 8 && NBASE == 10000
+	if (ssup->abbreviate)
+	{
+		ssup->comparator = numeric_cmp_abbrev;
+		ssup->abbrev_converter = numeric_abbrev_convert;
+		ssup->abbrev_abort = NULL;
+		ssup->abbrev_full_comparator = numeric_fast_cmp;
+		return;
+	}
+#endif
+
+	ssup->comparator = numeric_fast_cmp;
+}
+
 
 Datum
 numeric_eq(PG_FUNCTION_ARGS)
@@ -15,7 +15,9 @@
 #include "postgres.h"
 
 #include <ctype.h>
+#include <math.h>
 
+#include "access/hash.h"
 #include "access/tuptoaster.h"
 #include "catalog/pg_type.h"
 #include "libpq/md5.h"
@@ -27,6 +29,7 @@
 #include "utils/bytea.h"
 #include "utils/lsyscache.h"
 #include "utils/pg_locale.h"
+#include "utils/sortsupport.h"
 
 
 /* GUC variable */
@@ -1562,6 +1565,199 @@ bttextcmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(result);
 }
 
+/*
+ * Sort support for text.
+ *
+ * The comparators avoid the fmgr overhead of bttextcmp, and in the C locale
+ * also the locale-aware varstr_cmp.  In the C locale we also supply
+ * abbreviated keys: the first sizeof(Datum) bytes of the string, packed
+ * most-significant-first into a Datum that compares as an unsigned integer
+ * (shorter strings are padded with zeroes, which sort first since text
+ * can't contain NULs).  We don't abbreviate in other locales, since that
+ * would require strxfrm(), which isn't reliably consistent with strcoll()
+ * on all platforms.
+ *
+ * To decide whether the abbreviation is paying off, we keep rough distinct
+ * counts of both the abbreviated keys and the full strings, using linear
+ * counting over a small bitmap.  If the abbreviated keys are a lot less
+ * distinct than the strings, most comparisons would end in a tie on the
+ * abbreviated key and need a full comparison anyway, so we give up.
+ */
+#define TEXT_ABBREV_CARD_BITS	4096
+
+typedef struct
+{
+	uint32		abbr_seen[TEXT_ABBREV_CARD_BITS / 32];	/* abbreviated keys */
+	uint32		full_seen[TEXT_ABBREV_CARD_BITS / 32];	/* full strings */
+} TextSortSupport;
+
+static int
+bttextfastcmp_c(Datum x, Datum y, SortSupport ssup)
+{
+	text	   *arg1 = DatumGetTextPP(x);
+	text	   *arg2 = DatumGetTextPP(y);
+	int			len1,
+				len2;
+	int			result;
+
+	len1 = VARSIZE_ANY_EXHDR(arg1);
+	len2 = VARSIZE_ANY_EXHDR(arg2);
+
+	result = memcmp(VARDATA_ANY(arg1), VARDATA_ANY(arg2), Min(len1, len2));
+	if ((result == 0) && (len1 != len2))
+		result = (len1 < len2) ? -1 : 1;
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(arg1) != x)
+		pfree(arg1);
+	if (PointerGetDatum(arg2) != y)
+		pfree(arg2);
+
+	return result;
+}
+
+static int
+bttextfastcmp_locale(Datum x, Datum y, SortSupport ssup)
+{
+	text	   *arg1 = DatumGetTextPP(x);
+	text	   *arg2 = DatumGetTextPP(y);
+	int			result;
+
+	result = text_cmp(arg1, arg2);
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(arg1) != x)
+		pfree(arg1);
+	if (PointerGetDatum(arg2) != y)
+		pfree(arg2);
+
+	return result;
+}
+
+static int
+bttextcmp_abbrev(Datum x, Datum y, SortSupport ssup)
+{
+	/* abbreviated keys compare as unsigned integers */
+	if (x > y)
+		return 1;
+	else if (x == y)
+		return 0;
+	else
+		return -1;
+}
+
+/* Mark a hash value as seen in a linear-counting bitmap */
+static void
+bttext_card_add(uint32 *bitmap, uint32 hash)
+{
+	hash %= TEXT_ABBREV_CARD_BITS;
+	bitmap[hash / 32] |= ((uint32) 1) << (hash % 32);
+}
+
+/* Estimate the number of distinct values added to the bitmap */
+static double
+bttext_card_estimate(uint32 *bitmap)
+{
+	int			zeroes = 0;
+	int			i;
+
+	for (i = 0; i < TEXT_ABBREV_CARD_BITS / 32; i++)
+	{
+		uint32		w = bitmap[i];
+
+		/* count the unset bits */
+		w = ~w;
+		while (w)
+		{
+			zeroes++;
+			w &= w - 1;
+		}
+	}
+
+	/* a full bitmap only tells us the count is beyond what we can estimate */
+	if (zeroes == 0)
+		zeroes = 1;
+
+	return (double) TEXT_ABBREV_CARD_BITS *
+		log((double) TEXT_ABBREV_CARD_BITS / zeroes);
+}
+
+static Datum
+bttext_abbrev_convert(Datum original, SortSupport ssup)
+{
+	TextSortSupport *tss = (TextSortSupport *) ssup->ssup_extra;
+	text	   *authoritative = DatumGetTextPP(original);
+	const unsigned char *s = (const unsigned char *) VARDATA_ANY(authoritative);
+	int			len = VARSIZE_ANY_EXHDR(authoritative);
+	Datum		res = 0;
+	uint32		hash;
+	int			i;
+
+	for (i = 0; i < (int) sizeof(Datum); i++)
+	{
+		res <<= 8;
+		if (i < len)
+			res |= s[i];
+	}
+
+	/* Keep track of the distinctness of the keys and of the strings */
+#if SIZEOF_DATUM == 8
+	hash = DatumGetUInt32(hash_uint32((uint32) res ^ (uint32) (res >> 32)));
+#else
+	hash = DatumGetUInt32(hash_uint32((uint32) res));
+#endif
+	bttext_card_add(tss->abbr_seen, hash);
+	hash = DatumGetUInt32(hash_any(s, len));
+	bttext_card_add(tss->full_seen, hash);
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(authoritative) != original)
+		pfree(authoritative);
+
+	return res;
+}
+
+static bool
+bttext_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	TextSortSupport *tss = (TextSortSupport *) ssup->ssup_extra;
+	double		abbr_card;
+	double		key_card;
+
+	/* too early to tell */
+	if (memtupcount < 100)
+		return false;
+
+	abbr_card = bttext_card_estimate(tss->abbr_seen);
+	key_card = bttext_card_estimate(tss->full_seen);
+
+	/* keep going as long as the abbreviation keeps most of the distinctness */
+	return abbr_card < key_card * 0.5;
+}
+
+void
+bttextsortsupport(SortSupport ssup)
+{
+	if (!lc_collate_is_c())
+	{
+		ssup->comparator = bttextfastcmp_locale;
+		return;
+	}
+
+	if (!ssup->abbreviate)
+	{
+		ssup->comparator = bttextfastcmp_c;
+		return;
+	}
+
+	ssup->ssup_extra = MemoryContextAllocZero(ssup->ssup_cxt,
+											  sizeof(TextSortSupport));
+	ssup->comparator = bttextcmp_abbrev;
+	ssup->abbrev_converter = bttext_abbrev_convert;
+	ssup->abbrev_abort = bttext_abbrev_abort;
+	ssup->abbrev_full_comparator = bttextfastcmp_c;
+}
+
 
 Datum
 text_larger(PG_FUNCTION_ARGS)
@@ -1453,6 +1453,7 @@ formrdesc(const char *relationName, Oid relationReltype,
 
 	relation->rd_rel->relpages = 1;
 	relation->rd_rel->reltuples = 1;
+	relation->rd_rel->relallvisible = 0;
 	relation->rd_rel->relkind = RELKIND_RELATION;
 	relation->rd_rel->relhasoids = hasoids;
 	relation->rd_rel->relnatts = (int16) natts;
@@ -2662,6 +2663,7 @@ RelationSetNewRelfilenode(Relation relation, TransactionId freezeXid)
 	/* These changes are safe even for a mapped relation */
 	classform->relpages = 0;	/* it's empty until further notice */
 	classform->reltuples = 0;
+	classform->relallvisible = 0;
 	classform->relfrozenxid = freezeXid;
 
 	simple_heap_update(pg_class, &tuple->t_self, tuple);
@@ -3662,10 +3664,10 @@ RelationGetIndexAttrBitmap(Relation relation)
 		}
 
 		/* Collect all attributes used in expressions, too */
-		pull_varattnos((Node *) indexInfo->ii_Expressions, &indexattrs);
+		pull_varattnos((Node *) indexInfo->ii_Expressions, 1, &indexattrs);
 
 		/* Collect all attributes in the index predicate, too */
-		pull_varattnos((Node *) indexInfo->ii_Predicate, &indexattrs);
+		pull_varattnos((Node *) indexInfo->ii_Predicate, 1, &indexattrs);
 
 		index_close(indexDesc, AccessShareLock);
 	}
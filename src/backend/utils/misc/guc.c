@@ -337,6 +337,18 @@ static const struct config_enum_entry constraint_exclusion_options[] = {
 	{NULL, 0, false}
 };
 
+/*
+ * All values are always accepted here; assign_direct_io rejects the ones
+ * that need direct I/O where the platform can't do it.
+ */
+static const struct config_enum_entry direct_io_options[] = {
+	{"off", DIRECT_IO_OFF, false},
+	{"data", DIRECT_IO_DATA, false},
+	{"wal", DIRECT_IO_WAL, false},
+	{"all", DIRECT_IO_ALL, false},
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
@@ -611,6 +623,14 @@ static struct config_bool ConfigureNamesBool[] =
 		&enable_indexscan,
 		true, NULL, NULL
 	},
+	{
+		{"enable_indexonlyscan", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of index-only-scan plans."),
+			NULL
+		},
+		&enable_indexonlyscan,
+		true, NULL, NULL
+	},
 	{
 		{"enable_bitmapscan", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of bitmap-scan plans."),
@@ -635,6 +655,14 @@ static struct config_bool ConfigureNamesBool[] =
 		&enable_sort,
 		true, NULL, NULL
 	},
+	{
+		{"enable_incrementalsort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of incremental sort steps."),
+			NULL
+		},
+		&enable_incrementalsort,
+		true, NULL, NULL
+	},
 	{
 		{"enable_hashagg", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of hashed aggregation plans."),
@@ -1679,6 +1707,19 @@ static struct config_int ConfigureNamesInt[] =
 		30, 0, INT_MAX, NULL, NULL
 	},
 
+	{
+		{"checkpoint_flush_after", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
+			gettext_noop("During a checkpoint, ask the kernel to start writing "
+						 "back the written pages whenever this many have "
+						 "been written.  Zero disables this."),
+			GUC_UNIT_BLOCKS
+		},
+		&checkpoint_flush_after,
+		DEFAULT_CHECKPOINT_FLUSH_AFTER, 0, WRITEBACK_MAX_PENDING_FLUSHES,
+		NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -2679,6 +2720,15 @@ static struct config_enum ConfigureNamesEnum[] =
 		XACT_READ_COMMITTED, isolation_level_options, NULL, NULL
 	},
 
+	{
+		{"direct_io", PGC_POSTMASTER, RESOURCES_KERNEL,
+			gettext_noop("Selects the files read and written bypassing the kernel's cache."),
+			gettext_noop("Valid values are OFF, DATA (relation data files), WAL, and ALL.")
+		},
+		&direct_io,
+		DIRECT_IO_OFF, direct_io_options, assign_direct_io, NULL
+	},
+
 	{
 		{"IntervalStyle", PGC_USERSET, CLIENT_CONN_LOCALE,
 			gettext_noop("Sets the display format for interval values."),
@@ -59,6 +59,12 @@
  * of releasing many blocks followed by re-using many blocks, due to
  * tuplesort.c's "preread" behavior.
  *
+ * Since the blocks of a tape being read are scattered around the file, the
+ * kernel's own read-ahead can't help us much while merging.  So if the
+ * caller asks for it, we look ahead in the tape's indirect block and issue
+ * prefetch requests for the next few data blocks of each tape being read,
+ * so that the I/O for them can overlap with the merge processing.
+ *
  * Since all the bookkeeping and buffer memory is allocated with palloc(),
  * and the underlying file(s) are made with OpenTemporaryFile, all resources
  * for a logical tape set are certain to be cleaned up even if processing
@@ -134,6 +140,9 @@ typedef struct LogicalTape
 	long		curBlockNumber; /* this block's logical blk# within tape */
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
+
+	/* logical blk# of the next block not yet prefetched while reading */
+	long		prefetchBlockNumber;
 } LogicalTape;
 
 /*
@@ -166,6 +175,8 @@ struct LogicalTapeSet
 	int			nFreeBlocks;	/* # of currently free blocks */
 	int			freeBlocksLen;	/* current allocated length of freeBlocks[] */
 
+	int			prefetchDistance;	/* # of blocks to prefetch when reading */
+
 	/*
 	 * tapes[] is declared size 1 since C wants a fixed size, but actually it
 	 * is of length nTapes.
@@ -191,6 +202,7 @@ static long ltsRecallNextBlockNum(LogicalTapeSet *lts,
 static long ltsRecallPrevBlockNum(LogicalTapeSet *lts,
 					  IndirectBlock *indirect);
 static void ltsDumpBuffer(LogicalTapeSet *lts, LogicalTape *lt);
+static void ltsPrefetch(LogicalTapeSet *lts, LogicalTape *lt);
 
 
 /*
@@ -233,6 +245,40 @@ ltsReadBlock(LogicalTapeSet *lts, long blocknum, void *buffer)
 						blocknum)));
 }
 
+/*
+ * Issue prefetch requests for the data blocks following the current one of
+ * a tape being read, up to lts->prefetchDistance blocks ahead.
+ *
+ * We only look ahead within the tape's current bottom-level indirect block;
+ * once reading moves on to the next one, we catch up from there.  Since the
+ * block numbers are recalled only by ltsRecallNextBlockNum, this must be
+ * called just after a block has been read, while indirect->nextSlot points
+ * at the next block of the tape.
+ */
+static void
+ltsPrefetch(LogicalTapeSet *lts, LogicalTape *lt)
+{
+	IndirectBlock *indirect = lt->indirect;
+
+	if (lts->prefetchDistance <= 0 || indirect == NULL)
+		return;
+
+	if (lt->prefetchBlockNumber <= lt->curBlockNumber)
+		lt->prefetchBlockNumber = lt->curBlockNumber + 1;
+
+	while (lt->prefetchBlockNumber <= lt->curBlockNumber + lts->prefetchDistance &&
+		   lt->prefetchBlockNumber <= lt->numFullBlocks)
+	{
+		int			slot = indirect->nextSlot +
+		(int) (lt->prefetchBlockNumber - lt->curBlockNumber - 1);
+
+		if (slot >= BLOCKS_PER_INDIR_BLOCK || indirect->ptrs[slot] == -1L)
+			break;
+		BufFilePrefetchBlock(lts->pfile, indirect->ptrs[slot]);
+		lt->prefetchBlockNumber++;
+	}
+}
+
 /*
  * qsort comparator for sorting freeBlocks[] into decreasing order.
  */
@@ -535,6 +581,7 @@ LogicalTapeSetCreate(int ntapes)
 	lts->freeBlocksLen = 32;	/* reasonable initial guess */
 	lts->freeBlocks = (long *) palloc(lts->freeBlocksLen * sizeof(long));
 	lts->nFreeBlocks = 0;
+	lts->prefetchDistance = 0;
 	lts->nTapes = ntapes;
 
 	/*
@@ -556,6 +603,7 @@ LogicalTapeSetCreate(int ntapes)
 		lt->curBlockNumber = 0L;
 		lt->pos = 0;
 		lt->nbytes = 0;
+		lt->prefetchBlockNumber = 0L;
 	}
 	return lts;
 }
@@ -602,6 +650,20 @@ LogicalTapeSetForgetFreeSpace(LogicalTapeSet *lts)
 	lts->forgetFreeSpace = true;
 }
 
+/*
+ * Set the number of blocks to prefetch ahead of the read position of each
+ * tape being read.  Zero (the initial setting) disables prefetching.
+ *
+ * The caller should allow for the prefetched data in its memory budget, in
+ * the sense that it is expected to consume that much data from each tape
+ * soon; the prefetched blocks themselves live in the kernel's cache.
+ */
+void
+LogicalTapeSetPrefetch(LogicalTapeSet *lts, int nblocks)
+{
+	lts->prefetchDistance = Max(nblocks, 0);
+}
+
 /*
  * Dump the dirty buffer of a logical tape.
  */
@@ -720,6 +782,7 @@ LogicalTapeRewind(LogicalTapeSet *lts, int tapenum, bool forWrite)
 		lt->curBlockNumber = 0L;
 		lt->pos = 0;
 		lt->nbytes = 0;
+		lt->prefetchBlockNumber = 0L;
 		if (datablocknum != -1L)
 		{
 			ltsReadBlock(lts, datablocknum, (void *) lt->buffer);
@@ -727,6 +790,7 @@ LogicalTapeRewind(LogicalTapeSet *lts, int tapenum, bool forWrite)
 				ltsReleaseBlock(lts, datablocknum);
 			lt->nbytes = (lt->curBlockNumber < lt->numFullBlocks) ?
 				BLCKSZ : lt->lastBlockBytes;
+			ltsPrefetch(lts, lt);
 		}
 	}
 	else
@@ -800,6 +864,7 @@ LogicalTapeRead(LogicalTapeSet *lts, int tapenum,
 				BLCKSZ : lt->lastBlockBytes;
 			if (lt->nbytes <= 0)
 				break;			/* EOF (possible here?) */
+			ltsPrefetch(lts, lt);
 		}
 
 		nthistime = lt->nbytes - lt->pos;
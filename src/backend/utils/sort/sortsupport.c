@@ -0,0 +1,228 @@
+/*-------------------------------------------------------------------------
+ *
+ * sortsupport.c
+ *	  Support routines for accelerated sorting.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/sortsupport.h"
+
+
+/* Info needed to use an old-style comparison function as a sort comparator */
+typedef struct
+{
+	FunctionCallInfoData fcinfo;	/* reusable callinfo structure */
+	FmgrInfo	flinfo;			/* lookup data for comparison function */
+} SortShimExtra;
+
+/*
+ * Sort support functions of built-in btree opclasses, indexed by the OID of
+ * the opclass's comparison (BTORDER_PROC) function.  Opclasses not listed
+ * here are sorted by calling their comparison function through the shim.
+ */
+typedef struct
+{
+	Oid			cmpFunc;		/* btree comparison function */
+	void		(*sortsupport) (SortSupport ssup);
+} SortSupportFuncEntry;
+
+static const SortSupportFuncEntry sortsupport_funcs[] =
+{
+	{F_BTINT2CMP, btint2sortsupport},
+	{F_BTINT4CMP, btint4sortsupport},
+	{F_BTINT8CMP, btint8sortsupport},
+	{F_BTOIDCMP, btoidsortsupport},
+	{F_BTFLOAT4CMP, btfloat4sortsupport},
+	{F_BTFLOAT8CMP, btfloat8sortsupport},
+	{F_BTTEXTCMP, bttextsortsupport},
+	{F_NUMERIC_CMP, numeric_sortsupport}
+};
+
+
+/*
+ * sortsupport.h defines inline versions of these functions if allowed by the
+ * compiler; in which case the definitions below are skipped.
+ */
+#ifndef USE_INLINE
+
+/*
+ * Apply a sort comparator function and return a 3-way comparison result.
+ * This takes care of handling reverse-sort and NULLs-ordering properly.
+ */
+int
+ApplySortComparator(Datum datum1, bool isNull1,
+					Datum datum2, bool isNull2,
+					SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		compare = (*ssup->comparator) (datum1, datum2, ssup);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+
+/*
+ * Like ApplySortComparator, but compares original values with the
+ * abbrev_full_comparator.  Used to break ties between abbreviated keys.
+ */
+int
+ApplySortAbbrevFullComparator(Datum datum1, bool isNull1,
+							  Datum datum2, bool isNull2,
+							  SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		compare = (*ssup->abbrev_full_comparator) (datum1, datum2, ssup);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+#endif   /* ! USE_INLINE */
+
+/*
+ * Shim function for calling an old-style comparator
+ *
+ * This is essentially an inlined version of FunctionCall2(), except
+ * we assume that the FunctionCallInfoData was already mostly set up by
+ * PrepareSortSupportComparisonShim.
+ */
+static int
+comparison_shim(Datum x, Datum y, SortSupport ssup)
+{
+	SortShimExtra *extra = (SortShimExtra *) ssup->ssup_extra;
+	Datum		result;
+
+	extra->fcinfo.arg[0] = x;
+	extra->fcinfo.arg[1] = y;
+
+	/* just for paranoia's sake, we reset isnull each time */
+	extra->fcinfo.isnull = false;
+
+	result = FunctionCallInvoke(&extra->fcinfo);
+
+	/* Check for null result, since caller is clearly not expecting one */
+	if (extra->fcinfo.isnull)
+		elog(ERROR, "function %u returned NULL", extra->flinfo.fn_oid);
+
+	return DatumGetInt32(result);
+}
+
+/*
+ * Set up a shim function to allow use of an old-style btree comparison
+ * function as if it were a sort support comparator.
+ */
+void
+PrepareSortSupportComparisonShim(Oid cmpFunc, SortSupport ssup)
+{
+	SortShimExtra *extra;
+
+	extra = (SortShimExtra *) MemoryContextAlloc(ssup->ssup_cxt,
+												 sizeof(SortShimExtra));
+
+	/* Lookup the comparison function */
+	fmgr_info_cxt(cmpFunc, &extra->flinfo, ssup->ssup_cxt);
+
+	/* We can initialize the callinfo just once and re-use it */
+	InitFunctionCallInfoData(extra->fcinfo, &extra->flinfo, 2, NULL, NULL);
+	extra->fcinfo.argnull[0] = false;
+	extra->fcinfo.argnull[1] = false;
+
+	ssup->ssup_extra = extra;
+	ssup->comparator = comparison_shim;
+}
+
+/*
+ * Fill in SortSupport given an ordering operator (btree "<" or ">" operator).
+ *
+ * Caller must previously have zeroed the SortSupportData structure and then
+ * filled in ssup_cxt, ssup_nulls_first, and abbreviate.  This will fill in
+ * ssup_reverse as well as the comparator function pointer, and the
+ * abbreviated key functions if any.
+ */
+void
+PrepareSortSupportFromOrderingOp(Oid orderingOp, SortSupport ssup)
+{
+	Oid			sortFunction;
+	bool		issue_reverse;
+	int			i;
+
+	if (!get_compare_function_for_ordering_op(orderingOp,
+											  &sortFunction, &issue_reverse))
+		elog(ERROR, "operator %u is not a valid ordering operator",
+			 orderingOp);
+	ssup->ssup_reverse = issue_reverse;
+
+	for (i = 0; i < lengthof(sortsupport_funcs); i++)
+	{
+		if (sortsupport_funcs[i].cmpFunc == sortFunction)
+		{
+			(*sortsupport_funcs[i].sortsupport) (ssup);
+			break;
+		}
+	}
+
+	if (ssup->comparator == NULL)
+	{
+		/* no sort support function, or it declined; use the shim */
+		ssup->abbrev_converter = NULL;
+		PrepareSortSupportComparisonShim(sortFunction, ssup);
+	}
+
+	/* tell the caller whether we're really going to abbreviate */
+	if (ssup->abbrev_converter == NULL)
+		ssup->abbreviate = false;
+}
@@ -11,24 +11,22 @@
  * algorithm.
  *
  * See Knuth, volume 3, for more than you want to know about the external
- * sorting algorithm.  We divide the input into sorted runs using replacement
- * selection, in the form of a priority tree implemented as a heap
- * (essentially his Algorithm 5.2.3H), then merge the runs using polyphase
- * merge, Knuth's Algorithm 5.4.2D.  The logical "tapes" used by Algorithm D
- * are implemented by logtape.c, which avoids space wastage by recycling
- * disk space as soon as each block is read from its "tape".
+ * sorting algorithm.  We divide the input into sorted runs, each of them
+ * formed by filling sort memory and sorting it with qsort(), then merge the
+ * runs using polyphase merge, Knuth's Algorithm 5.4.2D.  The logical "tapes"
+ * used by Algorithm D are implemented by logtape.c, which avoids space
+ * wastage by recycling disk space as soon as each block is read from its
+ * "tape".
  *
- * We do not form the initial runs using Knuth's recommended replacement
- * selection data structure (Algorithm 5.4.1R), because it uses a fixed
- * number of records in memory at all times.  Since we are dealing with
- * tuples that may vary considerably in size, we want to be able to vary
- * the number of records kept in memory to ensure full utilization of the
- * allowed sort memory space.  So, we keep the tuples in a variable-size
- * heap, with the next record to go out at the top of the heap.  Like
- * Algorithm 5.4.1R, each record is stored with the run number that it
- * must go into, and we use (run number, key) as the ordering key for the
- * heap.  When the run number at the top of the heap changes, we know that
- * no more records of the prior run are left in the heap.
+ * Historically, the initial runs were formed using replacement selection,
+ * with the tuples kept in a heap (essentially Knuth's Algorithm 5.2.3H)
+ * ordered by (run number, key).  That produces runs averaging twice the
+ * size of memory, but the heap's comparisons have terrible cache behavior
+ * once memory is large, so that run building became CPU-bound long before
+ * the merge.  Quicksorting a memory-load at a time is much faster, and with
+ * a decent amount of memory the extra runs are cheap to merge.  It also
+ * makes each run independent of the others, since a run is just a sorted
+ * batch of input tuples.
  *
  * The approximate amount of memory allowed for any one sort operation
  * is specified in kilobytes by the caller (most pass work_mem).  Initially,
@@ -36,13 +34,11 @@
  * we haven't exceeded workMem.  If we reach the end of the input without
  * exceeding workMem, we sort the array using qsort() and subsequently return
  * tuples just by scanning the tuple array sequentially.  If we do exceed
- * workMem, we construct a heap using Algorithm H and begin to emit tuples
- * into sorted runs in temporary tapes, emitting just enough tuples at each
- * step to get back within the workMem limit.  Whenever the run number at
- * the top of the heap changes, we begin a new run with a new output tape
- * (selected per Algorithm D).	After the end of the input is reached,
- * we dump out remaining tuples in memory into a final run (or two),
- * then merge the runs using Algorithm D.
+ * workMem, we sort the array and write it out to a temporary tape as one
+ * run, then go back to filling the array with further tuples.  Each run
+ * goes to a new output tape (selected per Algorithm D).  After the end of
+ * the input is reached, we dump out remaining tuples in memory into a final
+ * run, then merge the runs using Algorithm D.
  *
  * When merging runs, we use a heap containing just the frontmost tuple from
  * each source run; we repeatedly output the smallest tuple and insert the
@@ -84,7 +80,21 @@
  * code we determine the number of tapes M on the basis of workMem: we want
  * workMem/M to be large enough that we read a fair amount of data each time
  * we preread from a tape, so as to maintain the locality of access described
- * above.  Nonetheless, with large workMem we can have many tapes.
+ * above.  Nonetheless, with large workMem we can have many tapes, up to
+ * MAXORDER; beyond that, extra memory goes into larger preread buffers.
+ * While merging we also ask logtape.c to prefetch the next blocks of each
+ * input tape, so that the reads for the next preread cycle are already
+ * under way while we merge the current one.
+ *
+ * Comparisons are done through the SortSupport API (see sortsupport.h),
+ * which lets common datatypes supply a comparator that is called directly
+ * rather than through fmgr.  For heap tuple sorts, the leading key may
+ * additionally be "abbreviated": datum1 then holds a cheap-to-compare
+ * pass-by-value proxy for the leading column, and only ties on it require
+ * the full comparison.  The datatype can ask us to abandon abbreviation
+ * while we are still collecting tuples, if it turns out not to discriminate
+ * well; after that, and for all tuples read back from tape, datum1 holds the
+ * original value.
  *
  *
  * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
@@ -113,6 +123,7 @@
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/rel.h"
+#include "utils/sortsupport.h"
 #include "utils/syscache.h"
 #include "utils/tuplesort.h"
 
@@ -151,11 +162,10 @@ bool		optimize_bounded_sort = true;
  * then datum1 points to a separately palloc'd data value that is also pointed
  * to by the "tuple" pointer; otherwise "tuple" is NULL.
  *
- * While building initial runs, tupindex holds the tuple's run number.  During
- * merge passes, we re-use it to hold the input tape number that each tuple in
- * the heap was read from, or to hold the index of the next tuple pre-read
- * from the same tape in the case of pre-read entries.	tupindex goes unused
- * if the sort occurs entirely in memory.
+ * During merge passes, tupindex holds the input tape number that each tuple
+ * in the heap was read from, or the index of the next tuple pre-read from
+ * the same tape in the case of pre-read entries.  tupindex goes unused
+ * while building initial runs, and if the sort occurs entirely in memory.
  */
 typedef struct
 {
@@ -190,8 +200,18 @@ typedef enum
  *
  * MERGE_BUFFER_SIZE is how much data we'd like to read from each input
  * tape during a preread cycle (see discussion at top of file).
+ *
+ * MAXORDER caps the merge order when workMem is large.  Beyond a few hundred
+ * input tapes, a wider merge saves little, while each extra tape means a
+ * smaller share of memory to preread into and so shorter, more scattered
+ * reads; it's better to spend the memory on big per-tape reads instead.
+ *
+ * MERGE_PREFETCH_BLOCKS is the maximum number of blocks of each input tape
+ * we ask the kernel to read ahead while merging (see logtape.c).
  */
 #define MINORDER		6		/* minimum merge order */
+#define MAXORDER		500		/* maximum merge order */
+#define MERGE_PREFETCH_BLOCKS	32
 #define TAPE_BUFFER_OVERHEAD		(BLCKSZ * 3)
 #define MERGE_BUFFER_SIZE			(BLCKSZ * 32)
 
@@ -340,7 +360,13 @@ struct Tuplesortstate
 	 * tuplesort_begin_heap and used only by the MinimalTuple routines.
 	 */
 	TupleDesc	tupDesc;
-	ScanKey		scanKeys;		/* array of length nKeys */
+	SortSupport sortKeys;		/* array of length nKeys */
+
+	/*
+	 * While the leading key is abbreviated, this is the memtupcount at which
+	 * we next ask the datatype whether abbreviation is still worthwhile.
+	 */
+	int			abbrevNext;
 
 	/*
 	 * These variables are specific to the IndexTuple case; they are set by
@@ -360,8 +386,7 @@ struct Tuplesortstate
 	 * tuplesort_begin_datum and used only by the DatumTuple routines.
 	 */
 	Oid			datumType;
-	FmgrInfo	sortOpFn;		/* cached lookup data for sortOperator */
-	int			sortFnFlags;	/* equivalent to sk_flags */
+	SortSupport onlyKey;		/* sort support for the datum */
 	/* we need typelen and byval in order to know how to copy the Datums. */
 	int			datumTypeLen;
 	bool		datumTypeByVal;
@@ -438,8 +463,8 @@ static void dumptuples(Tuplesortstate *state, bool alltuples);
 static void make_bounded_heap(Tuplesortstate *state);
 static void sort_bounded_heap(Tuplesortstate *state);
 static void tuplesort_heap_insert(Tuplesortstate *state, SortTuple *tuple,
-					  int tupleindex, bool checkIndex);
-static void tuplesort_heap_siftup(Tuplesortstate *state, bool checkIndex);
+					  int tupleindex);
+static void tuplesort_heap_siftup(Tuplesortstate *state);
 static unsigned int getlen(Tuplesortstate *state, int tapenum, bool eofOK);
 static void markrunend(Tuplesortstate *state, int tapenum);
 static int comparetup_heap(const SortTuple *a, const SortTuple *b,
@@ -450,6 +475,7 @@ static void writetup_heap(Tuplesortstate *state, int tapenum,
 static void readtup_heap(Tuplesortstate *state, SortTuple *stup,
 			 int tapenum, unsigned int len);
 static void reversedirection_heap(Tuplesortstate *state);
+static bool consider_abort_abbrev(Tuplesortstate *state);
 static int comparetup_index_btree(const SortTuple *a, const SortTuple *b,
 					   Tuplesortstate *state);
 static int comparetup_index_hash(const SortTuple *a, const SortTuple *b,
@@ -590,36 +616,25 @@ tuplesort_begin_heap(TupleDesc tupDesc,
 	state->reversedirection = reversedirection_heap;
 
 	state->tupDesc = tupDesc;	/* assume we need not copy tupDesc */
-	state->scanKeys = (ScanKey) palloc0(nkeys * sizeof(ScanKeyData));
+	state->abbrevNext = 10;
+
+	/* Prepare SortSupport data for each column */
+	state->sortKeys = (SortSupport) palloc0(nkeys * sizeof(SortSupportData));
 
 	for (i = 0; i < nkeys; i++)
 	{
-		Oid			sortFunction;
-		bool		reverse;
+		SortSupport sortKey = state->sortKeys + i;
 
 		AssertArg(attNums[i] != 0);
 		AssertArg(sortOperators[i] != 0);
 
-		if (!get_compare_function_for_ordering_op(sortOperators[i],
-												  &sortFunction, &reverse))
-			elog(ERROR, "operator %u is not a valid ordering operator",
-				 sortOperators[i]);
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_nulls_first = nullsFirstFlags[i];
+		sortKey->ssup_attno = attNums[i];
+		/* only the leading key can be abbreviated */
+		sortKey->abbreviate = (i == 0);
 
-		/*
-		 * We needn't fill in sk_strategy or sk_subtype since these scankeys
-		 * will never be passed to an index.
-		 */
-		ScanKeyInit(&state->scanKeys[i],
-					attNums[i],
-					InvalidStrategy,
-					sortFunction,
-					(Datum) 0);
-
-		/* However, we use btree's conventions for encoding directionality */
-		if (reverse)
-			state->scanKeys[i].sk_flags |= SK_BT_DESC;
-		if (nullsFirstFlags[i])
-			state->scanKeys[i].sk_flags |= SK_BT_NULLS_FIRST;
+		PrepareSortSupportFromOrderingOp(sortOperators[i], sortKey);
 	}
 
 	MemoryContextSwitchTo(oldcontext);
@@ -710,8 +725,6 @@ tuplesort_begin_datum(Oid datumType,
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, randomAccess);
 	MemoryContext oldcontext;
-	Oid			sortFunction;
-	bool		reverse;
 	int16		typlen;
 	bool		typbyval;
 
@@ -740,17 +753,19 @@ tuplesort_begin_datum(Oid datumType,
 
 	state->datumType = datumType;
 
-	/* lookup the ordering function */
-	if (!get_compare_function_for_ordering_op(sortOperator,
-											  &sortFunction, &reverse))
-		elog(ERROR, "operator %u is not a valid ordering operator",
-			 sortOperator);
-	fmgr_info(sortFunction, &state->sortOpFn);
+	/* Prepare SortSupport data */
+	state->onlyKey = (SortSupport) palloc0(sizeof(SortSupportData));
+
+	state->onlyKey->ssup_cxt = CurrentMemoryContext;
+	state->onlyKey->ssup_nulls_first = nullsFirstFlag;
+
+	/*
+	 * No abbreviation here: a pass-by-reference datum is stored only as
+	 * datum1, so there would be nowhere to keep the original value.
+	 */
+	state->onlyKey->abbreviate = false;
 
-	/* set ordering flags */
-	state->sortFnFlags = reverse ? SK_BT_DESC : 0;
-	if (nullsFirstFlag)
-		state->sortFnFlags |= SK_BT_NULLS_FIRST;
+	PrepareSortSupportFromOrderingOp(sortOperator, state->onlyKey);
 
 	/* lookup necessary attributes of the datum type */
 	get_typlenbyval(datumType, &typlen, &typbyval);
@@ -859,6 +874,65 @@ tuplesort_end(Tuplesortstate *state)
 	MemoryContextDelete(state->sortcontext);
 }
 
+/*
+ * tuplesort_reset
+ *
+ *	Discard all tuples and temporary files, so that the sort can be loaded
+ *	again with the same sort keys.  This saves the setup work of
+ *	tuplesort_begin_xxx for callers that sort many small sets of tuples one
+ *	after another.  Any bound set by tuplesort_set_bound is forgotten.
+ *
+ * The sort's output should have been read to the end (or not at all):
+ * tuples pre-read during an unfinished on-the-fly merge are not released
+ * until tuplesort_end.
+ */
+void
+tuplesort_reset(Tuplesortstate *state)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(state->sortcontext);
+	int			i;
+
+	/* A bounded heap is kept in reverse order; put the keys back */
+	if (state->status == TSS_BOUNDED)
+		REVERSEDIRECTION(state);
+
+	for (i = 0; i < state->memtupcount; i++)
+	{
+		if (state->memtuples[i].tuple != NULL)
+			pfree(state->memtuples[i].tuple);
+	}
+	state->memtupcount = 0;
+
+	if (state->tapeset)
+	{
+		LogicalTapeSetClose(state->tapeset);
+		state->tapeset = NULL;
+
+		pfree(state->mergeactive);
+		pfree(state->mergenext);
+		pfree(state->mergelast);
+		pfree(state->mergeavailslots);
+		pfree(state->mergeavailmem);
+		pfree(state->tp_fib);
+		pfree(state->tp_runs);
+		pfree(state->tp_dummy);
+		pfree(state->tp_tapenum);
+	}
+
+	state->status = TSS_INITIAL;
+	state->bounded = false;
+	state->boundUsed = false;
+	state->availMem = state->allowedMem -
+		GetMemoryChunkSpace(state->memtuples);
+	state->currentRun = 0;
+	state->result_tape = -1;
+	state->current = 0;
+	state->eof_reached = false;
+	state->abbrevNext = 10;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
 /*
  * Grow the memtuples[] array, if possible within our memory constraint.
  * Return TRUE if able to enlarge the array, FALSE if not.
@@ -1041,7 +1115,7 @@ puttuple_common(Tuplesortstate *state, SortTuple *tuple)
 			inittapes(state);
 
 			/*
-			 * Dump tuples until we are back under the limit.
+			 * Sort the tuples in memory and dump them as the first run.
 			 */
 			dumptuples(state, false);
 			break;
@@ -1065,34 +1139,23 @@ puttuple_common(Tuplesortstate *state, SortTuple *tuple)
 			{
 				/* discard top of heap, sift up, insert new tuple */
 				free_sort_tuple(state, &state->memtuples[0]);
-				tuplesort_heap_siftup(state, false);
-				tuplesort_heap_insert(state, tuple, 0, false);
+				tuplesort_heap_siftup(state);
+				tuplesort_heap_insert(state, tuple, 0);
 			}
 			break;
 
 		case TSS_BUILDRUNS:
 
 			/*
-			 * Insert the tuple into the heap, with run number currentRun if
-			 * it can go into the current run, else run number currentRun+1.
-			 * The tuple can go into the current run if it is >= the first
-			 * not-yet-output tuple.  (Actually, it could go into the current
-			 * run if it is >= the most recently output tuple ... but that
-			 * would require keeping around the tuple we last output, and it's
-			 * simplest to let writetup free each tuple as soon as it's
-			 * written.)
-			 *
-			 * Note there will always be at least one tuple in the heap at
-			 * this point; see dumptuples.
+			 * Save the tuple into the unsorted array, which will become part
+			 * of the next run.  The array is never grown here; dumptuples
+			 * empties it whenever it fills up.
 			 */
-			Assert(state->memtupcount > 0);
-			if (COMPARETUP(state, tuple, &state->memtuples[0]) >= 0)
-				tuplesort_heap_insert(state, tuple, state->currentRun, true);
-			else
-				tuplesort_heap_insert(state, tuple, state->currentRun + 1, true);
+			Assert(state->memtupcount < state->memtupsize);
+			state->memtuples[state->memtupcount++] = *tuple;
 
 			/*
-			 * If we are over the memory limit, dump tuples till we're under.
+			 * If we are over the memory limit, dump all the tuples as a run.
 			 */
 			dumptuples(state, false);
 			break;
@@ -1354,7 +1417,7 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 					state->availMem += tuplen;
 					state->mergeavailmem[srcTape] += tuplen;
 				}
-				tuplesort_heap_siftup(state, false);
+				tuplesort_heap_siftup(state);
 				if ((tupIndex = state->mergenext[srcTape]) == 0)
 				{
 					/*
@@ -1376,7 +1439,7 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 				state->mergenext[srcTape] = newtup->tupindex;
 				if (state->mergenext[srcTape] == 0)
 					state->mergelast[srcTape] = 0;
-				tuplesort_heap_insert(state, newtup, srcTape, false);
+				tuplesort_heap_insert(state, newtup, srcTape);
 				/* put the now-unused memtuples entry on the freelist */
 				newtup->tupindex = state->mergefreelist;
 				state->mergefreelist = tupIndex;
@@ -1505,8 +1568,13 @@ tuplesort_merge_order(long allowedMem)
 	mOrder = (allowedMem - TAPE_BUFFER_OVERHEAD) /
 		(MERGE_BUFFER_SIZE + TAPE_BUFFER_OVERHEAD);
 
-	/* Even in minimum memory, use at least a MINORDER merge */
+	/*
+	 * Even in minimum memory, use at least a MINORDER merge.  On the other
+	 * hand, even when we have lots of memory, do not use more than a
+	 * MAXORDER merge, so that each input tape gets a large preread buffer.
+	 */
 	mOrder = Max(mOrder, MINORDER);
+	mOrder = Min(mOrder, MAXORDER);
 
 	return mOrder;
 }
@@ -1520,7 +1588,6 @@ static void
 inittapes(Tuplesortstate *state)
 {
 	int			maxTapes,
-				ntuples,
 				j;
 	long		tapeSpace;
 
@@ -1578,24 +1645,9 @@ inittapes(Tuplesortstate *state)
 	state->tp_tapenum = (int *) palloc0(maxTapes * sizeof(int));
 
 	/*
-	 * Convert the unsorted contents of memtuples[] into a heap. Each tuple is
-	 * marked as belonging to run number zero.
-	 *
-	 * NOTE: we pass false for checkIndex since there's no point in comparing
-	 * indexes in this step, even though we do intend the indexes to be part
-	 * of the sort key...
+	 * The unsorted contents of memtuples[] will become the first run; see
+	 * dumptuples.
 	 */
-	ntuples = state->memtupcount;
-	state->memtupcount = 0;		/* make the heap empty */
-	for (j = 0; j < ntuples; j++)
-	{
-		/* Must copy source tuple to avoid possible overwrite */
-		SortTuple	stup = state->memtuples[j];
-
-		tuplesort_heap_insert(state, &stup, 0, false);
-	}
-	Assert(state->memtupcount == ntuples);
-
 	state->currentRun = 0;
 
 	/*
@@ -1669,6 +1721,19 @@ mergeruns(Tuplesortstate *state)
 	Assert(state->status == TSS_BUILDRUNS);
 	Assert(state->memtupcount == 0);
 
+	/*
+	 * Tuples read back from tape carry the original leading key value in
+	 * datum1, not the abbreviated key, so from here on we must compare them
+	 * in full.
+	 */
+	if (state->sortKeys != NULL && state->sortKeys->abbrev_converter != NULL)
+	{
+		state->sortKeys->comparator = state->sortKeys->abbrev_full_comparator;
+		state->sortKeys->abbrev_converter = NULL;
+		state->sortKeys->abbrev_abort = NULL;
+		state->sortKeys->abbrev_full_comparator = NULL;
+	}
+
 	/*
 	 * If we produced only one initial run (quite likely if the total data
 	 * volume is between 1X and 2X workMem), we can just use that tape as the
@@ -1823,7 +1888,7 @@ mergeonerun(Tuplesortstate *state)
 		spaceFreed = state->availMem - priorAvail;
 		state->mergeavailmem[srcTape] += spaceFreed;
 		/* compact the heap */
-		tuplesort_heap_siftup(state, false);
+		tuplesort_heap_siftup(state);
 		if ((tupIndex = state->mergenext[srcTape]) == 0)
 		{
 			/* out of preloaded data on this tape, try to read more */
@@ -1837,7 +1902,7 @@ mergeonerun(Tuplesortstate *state)
 		state->mergenext[srcTape] = tup->tupindex;
 		if (state->mergenext[srcTape] == 0)
 			state->mergelast[srcTape] = 0;
-		tuplesort_heap_insert(state, tup, srcTape, false);
+		tuplesort_heap_insert(state, tup, srcTape);
 		/* put the now-unused memtuples entry on the freelist */
 		tup->tupindex = state->mergefreelist;
 		state->mergefreelist = tupIndex;
@@ -1922,6 +1987,15 @@ beginmerge(Tuplesortstate *state)
 		}
 	}
 
+	/*
+	 * Have logtape.c prefetch about one preread cycle's worth of blocks
+	 * ahead on each input tape, so that reading the next cycle's data can
+	 * overlap with merging the current one.
+	 */
+	LogicalTapeSetPrefetch(state->tapeset,
+						   (int) Min(spacePerTape / BLCKSZ,
+									 MERGE_PREFETCH_BLOCKS));
+
 	/*
 	 * Preread as many tuples as possible (and at least one) from each active
 	 * tape
@@ -1940,7 +2014,7 @@ beginmerge(Tuplesortstate *state)
 			state->mergenext[srcTape] = tup->tupindex;
 			if (state->mergenext[srcTape] == 0)
 				state->mergelast[srcTape] = 0;
-			tuplesort_heap_insert(state, tup, srcTape, false);
+			tuplesort_heap_insert(state, tup, srcTape);
 			/* put the now-unused memtuples entry on the freelist */
 			tup->tupindex = state->mergefreelist;
 			state->mergefreelist = tupIndex;
@@ -2037,67 +2111,66 @@ mergeprereadone(Tuplesortstate *state, int srcTape)
 }
 
 /*
- * dumptuples - remove tuples from heap and write to tape
+ * dumptuples - remove tuples from memtuples and write to tape
  *
  * This is used during initial-run building, but not during merging.
  *
- * When alltuples = false, dump only enough tuples to get under the
- * availMem limit (and leave at least one tuple in the heap in any case,
- * since puttuple assumes it always has a tuple to compare to).  We also
- * insist there be at least one free slot in the memtuples[] array.
+ * When alltuples = false, do nothing unless we are over the availMem limit
+ * or the memtuples[] array is full; when alltuples = true, always dump
+ * everything currently in memory.  (The latter case is only used at end of
+ * input data.)
  *
- * When alltuples = true, dump everything currently in memory.
- * (This case is only used at end of input data.)
- *
- * If we empty the heap, close out the current run and return (this should
- * only happen at end of input data).  If we see that the tuple run number
- * at the top of the heap has changed, start a new run.
+ * Dumping means sorting memtuples[] and writing all of it out to the
+ * current destination tape as one complete run.  Each run after the first
+ * goes to a newly selected tape.
  */
 static void
 dumptuples(Tuplesortstate *state, bool alltuples)
 {
-	while (alltuples ||
-		   (LACKMEM(state) && state->memtupcount > 1) ||
-		   state->memtupcount >= state->memtupsize)
+	int			i;
+
+	if (state->memtupcount < state->memtupsize && !LACKMEM(state) &&
+		!alltuples)
+		return;
+
+	/*
+	 * Final call might find no tuples in memory, if the last dump happened
+	 * to consume the last input tuple; there's no need for an empty run.
+	 */
+	if (state->memtupcount == 0)
 	{
-		/*
-		 * Dump the heap's frontmost entry, and sift up to remove it from the
-		 * heap.
-		 */
-		Assert(state->memtupcount > 0);
+		Assert(alltuples && state->currentRun > 0);
+		return;
+	}
+
+	/* Every run but the first starts on a new tape, per Algorithm D */
+	if (state->currentRun > 0)
+		selectnewtape(state);
+
+	if (state->memtupcount > 1)
+		qsort_arg((void *) state->memtuples,
+				  state->memtupcount,
+				  sizeof(SortTuple),
+				  (qsort_arg_comparator) state->comparetup,
+				  (void *) state);
+
+	for (i = 0; i < state->memtupcount; i++)
 		WRITETUP(state, state->tp_tapenum[state->destTape],
-				 &state->memtuples[0]);
-		tuplesort_heap_siftup(state, true);
+				 &state->memtuples[i]);
+	state->memtupcount = 0;
 
-		/*
-		 * If the heap is empty *or* top run number has changed, we've
-		 * finished the current run.
-		 */
-		if (state->memtupcount == 0 ||
-			state->currentRun != state->memtuples[0].tupindex)
-		{
-			markrunend(state, state->tp_tapenum[state->destTape]);
-			state->currentRun++;
-			state->tp_runs[state->destTape]++;
-			state->tp_dummy[state->destTape]--; /* per Alg D step D2 */
+	markrunend(state, state->tp_tapenum[state->destTape]);
+	state->currentRun++;
+	state->tp_runs[state->destTape]++;
+	state->tp_dummy[state->destTape]--; /* per Alg D step D2 */
 
 #ifdef TRACE_SORT
-			if (trace_sort)
-				elog(LOG, "finished writing%s run %d to tape %d: %s",
-					 (state->memtupcount == 0) ? " final" : "",
-					 state->currentRun, state->destTape,
-					 pg_rusage_show(&state->ru_start));
+	if (trace_sort)
+		elog(LOG, "finished writing%s run %d to tape %d: %s",
+			 alltuples ? " final" : "",
+			 state->currentRun, state->destTape,
+			 pg_rusage_show(&state->ru_start));
 #endif
-
-			/*
-			 * Done if heap is empty, else prepare for new run.
-			 */
-			if (state->memtupcount == 0)
-				break;
-			Assert(state->currentRun == state->memtuples[0].tupindex);
-			selectnewtape(state);
-		}
-	}
 }
 
 /*
@@ -2256,14 +2329,10 @@ tuplesort_get_stats(Tuplesortstate *state,
 /*
  * Heap manipulation routines, per Knuth's Algorithm 5.2.3H.
  *
- * Compare two SortTuples.	If checkIndex is true, use the tuple index
- * as the front of the sort key; otherwise, no.
+ * Compare two SortTuples.
  */
 
-#define HEAPCOMPARE(tup1,tup2) \
-	(checkIndex && ((tup1)->tupindex != (tup2)->tupindex) ? \
-	 ((tup1)->tupindex) - ((tup2)->tupindex) : \
-	 COMPARETUP(state, tup1, tup2))
+#define HEAPCOMPARE(tup1,tup2) COMPARETUP(state, tup1, tup2)
 
 /*
  * Convert the existing unordered array of SortTuples to a bounded heap,
@@ -2273,10 +2342,6 @@ tuplesort_get_stats(Tuplesortstate *state,
  * at the root (array entry zero), instead of the smallest as in the normal
  * sort case.  This allows us to discard the largest entry cheaply.
  * Therefore, we temporarily reverse the sort direction.
- *
- * We assume that all entries in a bounded heap will always have tupindex
- * zero; it therefore doesn't matter that HEAPCOMPARE() doesn't reverse
- * the direction of comparison for tupindexes.
  */
 static void
 make_bounded_heap(Tuplesortstate *state)
@@ -2306,13 +2371,13 @@ make_bounded_heap(Tuplesortstate *state)
 			/* Must copy source tuple to avoid possible overwrite */
 			SortTuple	stup = state->memtuples[i];
 
-			tuplesort_heap_insert(state, &stup, 0, false);
+			tuplesort_heap_insert(state, &stup, 0);
 
 			/* If heap too full, discard largest entry */
 			if (state->memtupcount > state->bound)
 			{
 				free_sort_tuple(state, &state->memtuples[0]);
-				tuplesort_heap_siftup(state, false);
+				tuplesort_heap_siftup(state);
 			}
 		}
 	}
@@ -2343,7 +2408,7 @@ sort_bounded_heap(Tuplesortstate *state)
 		SortTuple	stup = state->memtuples[0];
 
 		/* this sifts-up the next-largest entry and decreases memtupcount */
-		tuplesort_heap_siftup(state, false);
+		tuplesort_heap_siftup(state);
 		state->memtuples[state->memtupcount] = stup;
 	}
 	state->memtupcount = tupcount;
@@ -2370,7 +2435,7 @@ sort_bounded_heap(Tuplesortstate *state)
  */
 static void
 tuplesort_heap_insert(Tuplesortstate *state, SortTuple *tuple,
-					  int tupleindex, bool checkIndex)
+					  int tupleindex)
 {
 	SortTuple  *memtuples;
 	int			j;
@@ -2408,7 +2473,7 @@ tuplesort_heap_insert(Tuplesortstate *state, SortTuple *tuple,
  * Decrement memtupcount, and sift up to maintain the heap invariant.
  */
 static void
-tuplesort_heap_siftup(Tuplesortstate *state, bool checkIndex)
+tuplesort_heap_siftup(Tuplesortstate *state)
 {
 	SortTuple  *memtuples = state->memtuples;
 	SortTuple  *tuple;
@@ -2575,20 +2640,25 @@ ApplySortFunction(FmgrInfo *sortFunction, int sortFlags,
 static int
 comparetup_heap(const SortTuple *a, const SortTuple *b, Tuplesortstate *state)
 {
-	ScanKey		scanKey = state->scanKeys;
+	SortSupport sortKey = state->sortKeys;
 	HeapTupleData ltup;
 	HeapTupleData rtup;
 	TupleDesc	tupDesc;
 	int			nkey;
 	int32		compare;
+	AttrNumber	attno;
+	Datum		datum1,
+				datum2;
+	bool		isnull1,
+				isnull2;
 
 	/* Allow interrupting long sorts */
 	CHECK_FOR_INTERRUPTS();
 
 	/* Compare the leading sort key */
-	compare = inlineApplySortFunction(&scanKey->sk_func, scanKey->sk_flags,
-									  a->datum1, a->isnull1,
-									  b->datum1, b->isnull1);
+	compare = ApplySortComparator(a->datum1, a->isnull1,
+								  b->datum1, b->isnull1,
+								  sortKey);
 	if (compare != 0)
 		return compare;
 
@@ -2598,21 +2668,33 @@ comparetup_heap(const SortTuple *a, const SortTuple *b, Tuplesortstate *state)
 	rtup.t_len = ((MinimalTuple) b->tuple)->t_len + MINIMAL_TUPLE_OFFSET;
 	rtup.t_data = (HeapTupleHeader) ((char *) b->tuple - MINIMAL_TUPLE_OFFSET);
 	tupDesc = state->tupDesc;
-	scanKey++;
-	for (nkey = 1; nkey < state->nKeys; nkey++, scanKey++)
+
+	/* If the leading key was abbreviated, the tie must be resolved in full */
+	if (sortKey->abbrev_converter)
 	{
-		AttrNumber	attno = scanKey->sk_attno;
-		Datum		datum1,
-					datum2;
-		bool		isnull1,
-					isnull2;
+		attno = sortKey->ssup_attno;
 
 		datum1 = heap_getattr(&ltup, attno, tupDesc, &isnull1);
 		datum2 = heap_getattr(&rtup, attno, tupDesc, &isnull2);
 
-		compare = inlineApplySortFunction(&scanKey->sk_func, scanKey->sk_flags,
-										  datum1, isnull1,
-										  datum2, isnull2);
+		compare = ApplySortAbbrevFullComparator(datum1, isnull1,
+												datum2, isnull2,
+												sortKey);
+		if (compare != 0)
+			return compare;
+	}
+
+	sortKey++;
+	for (nkey = 1; nkey < state->nKeys; nkey++, sortKey++)
+	{
+		attno = sortKey->ssup_attno;
+
+		datum1 = heap_getattr(&ltup, attno, tupDesc, &isnull1);
+		datum2 = heap_getattr(&rtup, attno, tupDesc, &isnull2);
+
+		compare = ApplySortComparator(datum1, isnull1,
+									  datum2, isnull2,
+									  sortKey);
 		if (compare != 0)
 			return compare;
 	}
@@ -2628,8 +2710,10 @@ copytup_heap(Tuplesortstate *state, SortTuple *stup, void *tup)
 	 * MinimalTuple using the exported interface for that.
 	 */
 	TupleTableSlot *slot = (TupleTableSlot *) tup;
+	SortSupport sortKey = state->sortKeys;
 	MinimalTuple tuple;
 	HeapTupleData htup;
+	Datum		original;
 
 	/* copy the tuple into sort storage */
 	tuple = ExecCopySlotMinimalTuple(slot);
@@ -2638,10 +2722,51 @@ copytup_heap(Tuplesortstate *state, SortTuple *stup, void *tup)
 	/* set up first-column key value */
 	htup.t_len = tuple->t_len + MINIMAL_TUPLE_OFFSET;
 	htup.t_data = (HeapTupleHeader) ((char *) tuple - MINIMAL_TUPLE_OFFSET);
-	stup->datum1 = heap_getattr(&htup,
-								state->scanKeys[0].sk_attno,
-								state->tupDesc,
-								&stup->isnull1);
+	original = heap_getattr(&htup,
+							sortKey->ssup_attno,
+							state->tupDesc,
+							&stup->isnull1);
+
+	if (!sortKey->abbrev_converter || stup->isnull1)
+	{
+		/*
+		 * Store the ordinary Datum representation, or NULL value.  If there
+		 * is a converter it won't expect NULL values, and the full comparator
+		 * has to deal with NULLs anyway.
+		 */
+		stup->datum1 = original;
+	}
+	else if (!consider_abort_abbrev(state))
+	{
+		/* Store the abbreviated key representation */
+		stup->datum1 = sortKey->abbrev_converter(original, sortKey);
+	}
+	else
+	{
+		int			i;
+
+		/*
+		 * The datatype asked us to stop abbreviating.  Set datum1 back to the
+		 * original value in every tuple collected so far, as well as this
+		 * one.
+		 */
+		stup->datum1 = original;
+
+		for (i = 0; i < state->memtupcount; i++)
+		{
+			SortTuple  *mtup = &state->memtuples[i];
+
+			htup.t_len = ((MinimalTuple) mtup->tuple)->t_len +
+				MINIMAL_TUPLE_OFFSET;
+			htup.t_data = (HeapTupleHeader) ((char *) mtup->tuple -
+											 MINIMAL_TUPLE_OFFSET);
+
+			mtup->datum1 = heap_getattr(&htup,
+										sortKey->ssup_attno,
+										state->tupDesc,
+										&mtup->isnull1);
+		}
+	}
 }
 
 static void
@@ -2694,7 +2819,7 @@ readtup_heap(Tuplesortstate *state, SortTuple *stup,
 	htup.t_len = tuple->t_len + MINIMAL_TUPLE_OFFSET;
 	htup.t_data = (HeapTupleHeader) ((char *) tuple - MINIMAL_TUPLE_OFFSET);
 	stup->datum1 = heap_getattr(&htup,
-								state->scanKeys[0].sk_attno,
+								state->sortKeys[0].ssup_attno,
 								state->tupDesc,
 								&stup->isnull1);
 }
@@ -2702,15 +2827,56 @@ readtup_heap(Tuplesortstate *state, SortTuple *stup,
 static void
 reversedirection_heap(Tuplesortstate *state)
 {
-	ScanKey		scanKey = state->scanKeys;
+	SortSupport sortKey = state->sortKeys;
 	int			nkey;
 
-	for (nkey = 0; nkey < state->nKeys; nkey++, scanKey++)
+	for (nkey = 0; nkey < state->nKeys; nkey++, sortKey++)
 	{
-		scanKey->sk_flags ^= (SK_BT_DESC | SK_BT_NULLS_FIRST);
+		sortKey->ssup_reverse = !sortKey->ssup_reverse;
+		sortKey->ssup_nulls_first = !sortKey->ssup_nulls_first;
 	}
 }
 
+/*
+ * Decide whether to stop abbreviating the leading key.
+ *
+ * We ask the datatype at geometrically increasing intervals while still
+ * collecting tuples in memory.  Once we start building runs on tape it's
+ * too late to bother, since the tuples already written can't be updated.
+ * If the answer is to stop, the leading key reverts to comparing original
+ * values; the caller must put those back into datum1.
+ */
+static bool
+consider_abort_abbrev(Tuplesortstate *state)
+{
+	SortSupport sortKey = state->sortKeys;
+
+	Assert(sortKey->abbrev_converter != NULL);
+
+	if (sortKey->abbrev_abort == NULL ||
+		state->status != TSS_INITIAL ||
+		state->memtupcount < state->abbrevNext)
+		return false;
+
+	state->abbrevNext *= 2;
+
+	if (!sortKey->abbrev_abort(state->memtupcount, sortKey))
+		return false;
+
+	sortKey->comparator = sortKey->abbrev_full_comparator;
+	sortKey->abbrev_converter = NULL;
+	sortKey->abbrev_abort = NULL;
+	sortKey->abbrev_full_comparator = NULL;
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG, "abandoning abbreviated keys after %d tuples: %s",
+			 state->memtupcount, pg_rusage_show(&state->ru_start));
+#endif
+
+	return true;
+}
+
 
 /*
  * Routines specialized for IndexTuple case
@@ -2978,9 +3144,9 @@ comparetup_datum(const SortTuple *a, const SortTuple *b, Tuplesortstate *state)
 	/* Allow interrupting long sorts */
 	CHECK_FOR_INTERRUPTS();
 
-	return inlineApplySortFunction(&state->sortOpFn, state->sortFnFlags,
-								   a->datum1, a->isnull1,
-								   b->datum1, b->isnull1);
+	return ApplySortComparator(a->datum1, a->isnull1,
+							   b->datum1, b->isnull1,
+							   state->onlyKey);
 }
 
 static void
@@ -3075,7 +3241,8 @@ readtup_datum(Tuplesortstate *state, SortTuple *stup,
 static void
 reversedirection_datum(Tuplesortstate *state)
 {
-	state->sortFnFlags ^= (SK_BT_DESC | SK_BT_NULLS_FIRST);
+	state->onlyKey->ssup_reverse = !state->onlyKey->ssup_reverse;
+	state->onlyKey->ssup_nulls_first = !state->onlyKey->ssup_nulls_first;
 }
 
 /*
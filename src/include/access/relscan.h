@@ -16,6 +16,8 @@
 
 #include "access/genam.h"
 #include "access/heapam.h"
+#include "access/itup.h"
+#include "storage/bufmgr.h"
 
 
 typedef struct HeapScanDescData
@@ -27,6 +29,7 @@ typedef struct HeapScanDescData
 	ScanKey		rs_key;			/* array of scan key descriptors */
 	bool		rs_bitmapscan;	/* true if this is really a bitmap scan */
 	bool		rs_pageatatime; /* verify visibility page-at-a-time? */
+	MemoryContext rs_keycxt;	/* context for scan key tests, or NULL */
 	bool		rs_allow_strat; /* allow or disallow use of access strategy */
 	bool		rs_allow_sync;	/* allow or disallow use of syncscan */
 
@@ -44,6 +47,11 @@ typedef struct HeapScanDescData
 	/* NB: if rs_cbuf is not InvalidBuffer, we hold a pin on that buffer */
 	ItemPointerData rs_mctid;	/* marked scan position, if any */
 
+	/* read-ahead state, used by forward seqscans */
+	ReadAheadState rs_readahead;
+	BlockNumber rs_prefetch_block;	/* next block to prefetch */
+	BlockNumber rs_prefetch_left;	/* # of blocks left to prefetch */
+
 	/* these fields only used in page-at-a-time mode and for bitmap scans */
 	int			rs_cindex;		/* current tuple's index in vistuples */
 	int			rs_mindex;		/* marked tuple's saved index */
@@ -71,6 +79,9 @@ typedef struct IndexScanDescData
 	bool		xactStartedInRecovery;	/* prevents killing/seeing killed
 										 * tuples */
 
+	/* set by caller of an amcanreturn AM to have it return index tuples */
+	bool		xs_want_itup;	/* caller requests index tuples */
+
 	/* index access method's private state */
 	void	   *opaque;			/* access-method-specific info */
 
@@ -80,6 +91,9 @@ typedef struct IndexScanDescData
 	/* NB: if xs_cbuf is not InvalidBuffer, we hold a pin on that buffer */
 	bool		xs_recheck;		/* T means scan keys must be rechecked */
 
+	/* in an index-only scan, this is valid after a successful amgettuple */
+	IndexTuple	xs_itup;		/* index tuple returned by AM */
+
 	/* state data for traversing HOT chains in index_getnext */
 	bool		xs_hot_dead;	/* T if all members of HOT chain are dead */
 	OffsetNumber xs_next_hot;	/* next member of HOT chain, if any */
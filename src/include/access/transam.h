@@ -119,6 +119,8 @@ typedef struct VariableCacheData
 	 */
 	TransactionId latestCompletedXid;	/* newest XID that has committed or
 										 * aborted */
+	uint64		xactCompletionCount;	/* # of times the set of running
+										 * XIDs shrank; see GetSnapshotData */
 } VariableCacheData;
 
 typedef VariableCacheData *VariableCache;
@@ -72,6 +72,32 @@ typedef struct HashJoinTupleData
 #define HJTUPLE_MINTUPLE(hjtup)  \
 	((MinimalTuple) ((char *) (hjtup) + HJTUPLE_OVERHEAD))
 
+/*
+ * To avoid per-tuple palloc overhead, the tuples of the main hash table are
+ * packed densely into large chunks of memory, which are kept in a list.
+ * Besides saving space, this lets ExecHashIncreaseNumBatches walk the tuples
+ * sequentially in memory rather than chasing the bucket chains, and compact
+ * the survivors as it goes.  Tuples larger than HASH_CHUNK_THRESHOLD get a
+ * chunk of their own, so that we don't waste much of a chunk on them.
+ * Skew-table tuples are still palloc'd individually, since they can be
+ * freed one at a time.
+ */
+typedef struct HashMemoryChunkData
+{
+	int			ntuples;		/* number of tuples stored in this chunk */
+	Size		maxlen;			/* size of the data area */
+	Size		used;			/* number of data bytes already used */
+	struct HashMemoryChunkData *next;	/* next chunk in list */
+	char		data[1];		/* VARIABLE LENGTH ARRAY, MAXALIGN'd */
+} HashMemoryChunkData;
+
+typedef struct HashMemoryChunkData *HashMemoryChunk;
+
+#define HASH_CHUNK_SIZE			(32 * 1024L)
+#define HASH_CHUNK_HEADER_SIZE	MAXALIGN(offsetof(HashMemoryChunkData, data))
+#define HASH_CHUNK_DATA(chunk)	((char *) (chunk) + HASH_CHUNK_HEADER_SIZE)
+#define HASH_CHUNK_THRESHOLD	(HASH_CHUNK_SIZE / 4)
+
 /*
  * If the outer relation's distribution is sufficiently nonuniform, we attempt
  * to optimize the join by treating the hash values corresponding to the outer
@@ -102,6 +128,21 @@ typedef struct HashSkewBucket
 #define SKEW_WORK_MEM_PERCENT  2
 #define SKEW_MIN_OUTER_FRACTION  0.01
 
+/*
+ * When the join is expected to need more than one batch, we also build a
+ * bloom filter over the hash values of all the inner tuples while reading
+ * the inner relation.  An outer tuple whose hash value is not in the filter
+ * can't have a match in any batch, so we needn't probe the hash table for
+ * it, nor write it out to an outer batch file.  Each inner tuple sets two
+ * bits.  The filter's size is limited to BLOOM_WORK_MEM_PERCENT of the
+ * memory allowed for the join.  If too many bits are set once the inner
+ * relation has been read, the filter would reject too few tuples to pay
+ * for itself, so we throw it away.
+ */
+#define BLOOM_BITS_PER_TUPLE	8
+#define BLOOM_MIN_BITS			(8 * 1024)
+#define BLOOM_WORK_MEM_PERCENT	10
+
 
 typedef struct HashJoinTableData
 {
@@ -153,8 +194,15 @@ typedef struct HashJoinTableData
 	Size		spaceUsedSkew;	/* skew hash table's current space usage */
 	Size		spaceAllowedSkew;		/* upper limit for skew hashtable */
 
+	uint32	   *bloomFilter;	/* bloom filter bitmap, or NULL if none */
+	uint32		bloomMask;		/* number of bits in the filter, less 1 */
+	Size		bloomBitsSet;	/* number of bits currently set */
+
 	MemoryContext hashCxt;		/* context for whole-hash-join storage */
 	MemoryContext batchCxt;		/* context for this-batch-only storage */
+
+	/* used for dense allocation of tuples (in this batch) */
+	HashMemoryChunk chunks;		/* list of memory chunks, newest first */
 } HashJoinTableData;
 
 #endif   /* HASHJOIN_H */
@@ -45,5 +45,6 @@ extern void ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 						int *numbatches,
 						int *num_skew_mcvs);
 extern int	ExecHashGetSkewBucket(HashJoinTable hashtable, uint32 hashvalue);
+extern bool ExecHashBloomTest(HashJoinTable hashtable, uint32 hashvalue);
 
 #endif   /* NODEHASH_H */
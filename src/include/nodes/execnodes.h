@@ -1163,6 +1163,9 @@ typedef struct
  *		RuntimeContext	   expr context for evaling runtime Skeys
  *		RelationDesc	   index relation descriptor
  *		ScanDesc		   index scan descriptor
+ *		IndexOnly		   true if returning index tuples for all-visible pages
+ *		VMBuffer		   buffer in use for visibility map testing, if any
+ *		HeapFetches		   number of tuples we were forced to fetch from heap
  * ----------------
  */
 typedef struct IndexScanState
@@ -1177,6 +1180,9 @@ typedef struct IndexScanState
 	ExprContext *iss_RuntimeContext;
 	Relation	iss_RelationDesc;
 	IndexScanDesc iss_ScanDesc;
+	bool		iss_IndexOnly;
+	Buffer		iss_VMBuffer;
+	long		iss_HeapFetches;
 } IndexScanState;
 
 /* ----------------
@@ -1523,6 +1529,26 @@ typedef struct SortState
 	void	   *tuplesortstate; /* private state of tuplesort.c */
 } SortState;
 
+/* ----------------
+ *	 IncrementalSortState information
+ *
+ *		The scan tuple slot holds the first tuple of the next group, which
+ *		has been read from the outer plan but not yet passed to tuplesort.
+ * ----------------
+ */
+typedef struct IncrementalSortState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	bool		bounded;		/* is the result set bounded? */
+	int64		bound;			/* if bounded, how many tuples are needed */
+	FmgrInfo   *eqfunctions;	/* equality fns for presorted columns */
+	bool		group_Done;		/* current group sorted, being returned? */
+	bool		outer_Done;		/* outer plan exhausted? */
+	int64		tuples_returned;	/* # of tuples returned since rescan */
+	long		groups_sorted;	/* # of groups sorted (for EXPLAIN) */
+	void	   *tuplesortstate; /* tuplesort.c state for the current group */
+} IncrementalSortState;
+
 /* ---------------------
  *	GroupState information
  * -------------------------
@@ -1549,6 +1575,7 @@ typedef struct GroupState
 /* these structs are private in nodeAgg.c: */
 typedef struct AggStatePerAggData *AggStatePerAgg;
 typedef struct AggStatePerGroupData *AggStatePerGroup;
+typedef struct AggHashSpillData *AggHashSpill;
 
 typedef struct AggState
 {
@@ -1570,6 +1597,9 @@ typedef struct AggState
 	List	   *hash_needed;	/* list of columns needed in hash table */
 	bool		table_filled;	/* hash table filled yet? */
 	TupleHashIterator hashiter; /* for iterating through hash table */
+	AggHashSpill hashspill;		/* state for spilling groups to disk */
+	int			hash_batches_used;	/* # of hash table fills, for EXPLAIN */
+	int			hash_spill_levels;	/* deepest repartitioning level reached */
 } AggState;
 
 /* ----------------
@@ -264,6 +264,12 @@ typedef Scan SeqScan;
  * table).	This is a bit hokey ... would be cleaner to use a special-purpose
  * node type that could not be mistaken for a regular Var.	But it will do
  * for now.
+ *
+ * If indexonly is true, every column of the base table referenced by the
+ * targetlist and quals is a plain index column.  For heap pages marked
+ * all-visible in the visibility map, the executor then fills in those
+ * columns from the index tuple instead of fetching the heap tuple; the
+ * other columns are left NULL.
  * ----------------
  */
 typedef struct IndexScan
@@ -273,6 +279,7 @@ typedef struct IndexScan
 	List	   *indexqual;		/* list of index quals (OpExprs) */
 	List	   *indexqualorig;	/* the same in original form */
 	ScanDirection indexorderdir;	/* forward or backward or don't care */
+	bool		indexonly;		/* return index tuples for all-visible pages? */
 } IndexScan;
 
 /* ----------------
@@ -492,6 +499,19 @@ typedef struct Sort
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
 } Sort;
 
+/* ----------------
+ *		incremental sort node
+ *
+ * The input is already sorted on the first presortedCols sort columns; we
+ * need only sort each group of tuples that are equal on those columns.
+ * ----------------
+ */
+typedef struct IncrementalSort
+{
+	Sort		sort;
+	int			presortedCols;	/* number of presorted sort-key columns */
+} IncrementalSort;
+
 /* ---------------
  *	 group node -
  *		Used for queries with GROUP BY (but no aggregates) specified.
@@ -295,6 +295,7 @@ typedef struct PlannerInfo
  *					(always NIL if it's not a table)
  *		pages - number of disk pages in relation (zero if not a table)
  *		tuples - number of tuples in relation (not considering restrictions)
+ *		allvisfrac - fraction of disk pages that are marked all-visible
  *		subplan - plan for subquery (NULL if it's not a subquery)
  *		subrtable - rangetable for subquery (NIL if it's not a subquery)
  *		subrowmark - rowmarks for subquery (NIL if it's not a subquery)
@@ -380,6 +381,7 @@ typedef struct RelOptInfo
 	List	   *indexlist;		/* list of IndexOptInfo */
 	BlockNumber pages;
 	double		tuples;
+	double		allvisfrac;		/* fraction of pages marked all-visible */
 	struct Plan *subplan;		/* if subquery */
 	List	   *subrtable;		/* if subquery */
 	List	   *subrowmark;		/* if subquery */
@@ -464,6 +466,7 @@ typedef struct IndexOptInfo
 	bool		amsearchnulls;	/* can AM search for NULL/NOT NULL entries? */
 	bool		amhasgettuple;	/* does AM have amgettuple interface? */
 	bool		amhasgetbitmap; /* does AM have amgetbitmap interface? */
+	bool		amcanreturn;	/* can AM return index tuples? */
 } IndexOptInfo;
 
 
@@ -629,6 +632,10 @@ typedef struct Path
  * indexscan in this case, and in addition there's a special 'rows' value
  * different from the parent RelOptInfo's (see below).
  *
+ * 'indexonly' is TRUE if every column the query needs from the relation
+ * is available from the index, so that the index tuples can be returned
+ * without visiting the heap for pages marked all-visible.
+ *
  * 'indexscandir' is one of:
  *		ForwardScanDirection: forward scan of an ordered index
  *		BackwardScanDirection: backward scan of an ordered index
@@ -656,6 +663,7 @@ typedef struct IndexPath
 	List	   *indexclauses;
 	List	   *indexquals;
 	bool		isjoininner;
+	bool		indexonly;
 	ScanDirection indexscandir;
 	Cost		indextotalcost;
 	Selectivity indexselectivity;
@@ -37,6 +37,7 @@
 #define BM_JUST_DIRTIED			(1 << 5)		/* dirtied since write started */
 #define BM_PIN_COUNT_WAITER		(1 << 6)		/* have waiter for sole pin */
 #define BM_CHECKPOINT_NEEDED	(1 << 7)		/* must write for checkpoint */
+#define BM_READ_AHEAD			(1 << 8)		/* read ahead, not looked up yet */
 
 typedef bits16 BufFlags;
 
@@ -109,9 +110,9 @@ typedef struct buftag
  * Note: buf_hdr_lock must be held to examine or change the tag, flags,
  * usage_count, refcount, or wait_backend_pid fields.  buf_id field never
  * changes after initialization, so does not need locking.	freeNext is
- * protected by the BufFreelistLock not buf_hdr_lock.  The LWLocks can take
- * care of themselves.	The buf_hdr_lock is *not* used to control access to
- * the data in the buffer!
+ * protected by freelist.c's buffer_strategy_lock not buf_hdr_lock.  The
+ * LWLocks can take care of themselves.  The buf_hdr_lock is *not* used to
+ * control access to the data in the buffer!
  *
  * An exception is that if we have the buffer pinned, its tag can't change
  * underneath us, so we can examine the tag without locking the spinlock.
@@ -167,8 +168,23 @@ typedef struct sbufdesc
 #define UnlockBufHdr(bufHdr)	SpinLockRelease(&(bufHdr)->buf_hdr_lock)
 
 
+/*
+ * BufferSync sorts the buffers a checkpoint has to write into file and block
+ * order, using an array of these.
+ */
+typedef struct CkptSortItem
+{
+	Oid			tsId;			/* tablespace */
+	Oid			dbId;			/* database */
+	Oid			relNode;		/* relation */
+	ForkNumber	forkNum;
+	BlockNumber blockNum;
+	int			buf_id;			/* buffer holding the block */
+} CkptSortItem;
+
 /* in buf_init.c */
 extern PGDLLIMPORT BufferDesc *BufferDescriptors;
+extern CkptSortItem *CkptBufferIds;
 
 /* in localbuf.c */
 extern BufferDesc *LocalBufferDescriptors;
@@ -179,8 +195,7 @@ extern BufferDesc *LocalBufferDescriptors;
  */
 
 /* freelist.c */
-extern volatile BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy,
-				  bool *lock_held);
+extern volatile BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy);
 extern void StrategyFreeBuffer(volatile BufferDesc *buf);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 					 volatile BufferDesc *buf);
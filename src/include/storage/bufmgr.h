@@ -41,6 +41,27 @@ typedef enum
 	RBM_ZERO_ON_ERROR			/* Read, but return an all-zeros page on error */
 } ReadBufferMode;
 
+/*
+ * Read-ahead state, for callers that read a relation's blocks in an order
+ * known in advance.  Successive calls of next_block return the blocks the
+ * caller is going to read, in order, starting with the first one; then
+ * InvalidBlockNumber.  ReadAheadAdvance, called whenever the caller reads
+ * the next of those blocks, keeps up to target_prefetch_pages of the
+ * following ones prefetched.  The fields are private to bufmgr.c.
+ */
+typedef BlockNumber (*ReadAheadNextBlock) (void *callback_arg);
+
+typedef struct ReadAheadState
+{
+	Relation	rel;			/* relation being read */
+	ForkNumber	forkNum;		/* fork being read */
+	ReadAheadNextBlock next_block;	/* supplies blocks to prefetch */
+	void	   *callback_arg;	/* passed to next_block */
+	int			distance;		/* current prefetch distance */
+	int			inflight;		/* # of blocks prefetched but not yet read */
+	bool		exhausted;		/* has next_block run out of blocks? */
+} ReadAheadState;
+
 /* in globals.c ... this duplicates miscadmin.h */
 extern PGDLLIMPORT int NBuffers;
 
@@ -49,6 +70,26 @@ extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
 extern int	target_prefetch_pages;
+extern int	checkpoint_flush_after;
+
+/*
+ * Upper limit for checkpoint_flush_after, and its default.  Writeback is
+ * only implemented with Linux's sync_file_range(), so it's off by default
+ * elsewhere.
+ */
+#define WRITEBACK_MAX_PENDING_FLUSHES	256
+#ifdef __linux__
+#define DEFAULT_CHECKPOINT_FLUSH_AFTER	32
+#else
+#define DEFAULT_CHECKPOINT_FLUSH_AFTER	0
+#endif
+
+/*
+ * Maximum number of consecutive blocks ReadBufferRange and the checkpointer
+ * transfer with a single system call.  md.c splits longer transfers at
+ * PG_IOV_MAX anyway.
+ */
+#define MAX_BUFFERS_PER_TRANSFER	16
 
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
@@ -156,10 +197,18 @@ extern PGDLLIMPORT int32 *LocalRefCount;
  */
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 			   BlockNumber blockNum);
+extern void ReadAheadInit(ReadAheadState *ra, Relation reln,
+			  ForkNumber forkNum, ReadAheadNextBlock next_block,
+			  void *callback_arg);
+extern void ReadAheadReset(ReadAheadState *ra);
+extern void ReadAheadAdvance(ReadAheadState *ra);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 				   BlockNumber blockNum, ReadBufferMode mode,
 				   BufferAccessStrategy strategy);
+extern Buffer ReadBufferRange(Relation reln, ForkNumber forkNum,
+				BlockNumber blockNum, int nblocks,
+				BufferAccessStrategy strategy);
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode, bool isTemp,
 						  ForkNumber forkNum, BlockNumber blockNum,
 						  ReadBufferMode mode, BufferAccessStrategy strategy);
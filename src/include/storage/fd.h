@@ -39,6 +39,7 @@
 #define FD_H
 
 #include <dirent.h>
+#include <fcntl.h>
 
 
 /*
@@ -49,9 +50,36 @@ typedef char *FileName;
 
 typedef int File;
 
+/*
+ * Maximum number of buffers FileReadV and FileWriteV accept; every platform's
+ * IOV_MAX is at least this large.
+ */
+#define PG_IOV_MAX	16
+
+/*
+ * Values of direct_io: a bitmask of the kinds of files that are read and
+ * written with O_DIRECT, bypassing the kernel's cache.
+ */
+#define DIRECT_IO_OFF	0
+#define DIRECT_IO_DATA	0x01		/* relation data files */
+#define DIRECT_IO_WAL	0x02		/* WAL segment files */
+#define DIRECT_IO_ALL	(DIRECT_IO_DATA | DIRECT_IO_WAL)
+
+/*
+ * Alignment of the buffers used for I/O on relation data files.  Limitation
+ * of buffer-alignment for direct I/O depends on OS and filesystem, but as
+ * for WAL buffers (see ALIGNOF_XLOG_BUFFER), BLCKSZ is assumed to be enough.
+ */
+#ifdef O_DIRECT
+#define ALIGNOF_DATA_BUFFER		BLCKSZ
+#else
+#define ALIGNOF_DATA_BUFFER		ALIGNOF_BUFFER
+#endif
+
 
-/* GUC parameter */
+/* GUC parameters */
 extern int	max_files_per_process;
+extern int	direct_io;
 
 
 /*
@@ -63,8 +91,11 @@ extern File PathNameOpenFile(FileName fileName, int fileFlags, int fileMode);
 extern File OpenTemporaryFile(bool interXact);
 extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, int amount);
+extern void FileWriteback(File file, off_t offset, off_t nbytes);
 extern int	FileRead(File file, char *buffer, int amount);
 extern int	FileWrite(File file, char *buffer, int amount);
+extern int	FileReadV(File file, char **buffers, int nbuffers, int amount);
+extern int	FileWriteV(File file, char **buffers, int nbuffers, int amount);
 extern int	FileSync(File file);
 extern off_t FileSeek(File file, off_t offset, int whence);
 extern int	FileTruncate(File file, off_t offset);
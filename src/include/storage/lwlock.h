@@ -15,9 +15,10 @@
 #define LWLOCK_H
 
 /*
- * It's a bit odd to declare NUM_BUFFER_PARTITIONS and NUM_LOCK_PARTITIONS
- * here, but we need them to set up enum LWLockId correctly, and having
- * this file include lock.h or bufmgr.h would be backwards.
+ * It's a bit odd to declare NUM_BUFFER_PARTITIONS, NUM_LOCK_PARTITIONS and
+ * NUM_XLOGINSERT_SLOTS here, but we need them to set up enum LWLockId
+ * correctly, and having this file include lock.h, bufmgr.h or xlog.h would
+ * be backwards.
  */
 
 /* Number of partitions of the shared buffer mapping hashtable */
@@ -27,6 +28,9 @@
 #define LOG2_NUM_LOCK_PARTITIONS  4
 #define NUM_LOCK_PARTITIONS  (1 << LOG2_NUM_LOCK_PARTITIONS)
 
+/* Number of slots for copying WAL records into the buffers concurrently */
+#define NUM_XLOGINSERT_SLOTS  8
+
 /*
  * We have a number of predefined LWLocks, plus a bunch of LWLocks that are
  * dynamically assigned (e.g., for shared buffers).  The LWLock structures
@@ -42,7 +46,7 @@
  */
 typedef enum LWLockId
 {
-	BufFreelistLock,
+	UnusedLock0,				/* formerly BufFreelistLock */
 	ShmemIndexLock,
 	OidGenLock,
 	XidGenLock,
@@ -73,9 +77,10 @@ typedef enum LWLockId
 	/* Individual lock IDs end here */
 	FirstBufMappingLock,
 	FirstLockMgrLock = FirstBufMappingLock + NUM_BUFFER_PARTITIONS,
+	FirstXLogInsertSlotLock = FirstLockMgrLock + NUM_LOCK_PARTITIONS,
 
 	/* must be last except for MaxDynamicLWLock: */
-	NumFixedLWLocks = FirstLockMgrLock + NUM_LOCK_PARTITIONS,
+	NumFixedLWLocks = FirstXLogInsertSlotLock + NUM_XLOGINSERT_SLOTS,
 
 	MaxDynamicLWLock = 1000000000
 } LWLockId;
@@ -84,7 +89,10 @@ typedef enum LWLockId
 typedef enum LWLockMode
 {
 	LW_EXCLUSIVE,
-	LW_SHARED
+	LW_SHARED,
+	LW_WAIT_UNTIL_FREE			/* A special mode used in PGPROC->lwWaitMode,
+								 * when waiting for lock to become free. Not
+								 * to be used as LWLockAcquire argument */
 } LWLockMode;
 
 
@@ -96,6 +104,9 @@ extern LWLockId LWLockAssign(void);
 extern void LWLockAcquire(LWLockId lockid, LWLockMode mode);
 extern bool LWLockConditionalAcquire(LWLockId lockid, LWLockMode mode);
 extern void LWLockRelease(LWLockId lockid);
+extern bool LWLockWaitForVar(LWLockId lockid, uint64 *valptr, uint64 oldval,
+				 uint64 *newval);
+extern void LWLockUpdateVar(LWLockId lockid, uint64 *valptr, uint64 val);
 extern void LWLockReleaseAll(void);
 extern bool LWLockHeldByMe(LWLockId lockid);
 
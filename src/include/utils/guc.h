@@ -314,4 +314,7 @@ extern const char *assign_search_path(const char *newval,
 extern bool assign_xlog_sync_method(int newval,
 						bool doit, GucSource source);
 
+/* in storage/file/fd.c */
+extern bool assign_direct_io(int newval, bool doit, GucSource source);
+
 #endif   /* GUC_H */
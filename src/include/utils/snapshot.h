@@ -62,6 +62,12 @@ typedef struct SnapshotData
 	uint32		active_count;	/* refcount on ActiveSnapshot stack */
 	uint32		regd_count;		/* refcount on RegisteredSnapshotList */
 	bool		copied;			/* false if it's a static snapshot */
+
+	/*
+	 * xactCompletionCount when this snapshot was computed, or 0 if it can't
+	 * be reused; see GetSnapshotData.
+	 */
+	uint64		snapXactCompletionCount;
 } SnapshotData;
 
 /*
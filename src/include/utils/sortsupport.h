@@ -0,0 +1,207 @@
+/*-------------------------------------------------------------------------
+ *
+ * sortsupport.h
+ *	  Framework for accelerated sorting.
+ *
+ * Traditionally, PostgreSQL has implemented sorting by repeatedly invoking
+ * an SQL-callable comparison function "cmp(x, y) returns int" on pairs of
+ * values to be compared, where the comparison function is the BTORDER_PROC
+ * pg_amproc support function of the appropriate btree index opclass.
+ *
+ * This file defines alternative APIs that allow sorting to be performed with
+ * reduced overhead.  To support lower-overhead sorting, a btree opclass may
+ * provide a C function that fills in a SortSupport struct with a direct
+ * comparator, avoiding the fmgr call overhead and detoasting setup of the
+ * SQL-callable comparison function.  Such functions are registered in the
+ * table in sortsupport.c, keyed by the OID of the opclass's comparison
+ * function.  Datatypes that don't provide one are still supported, via
+ * a shim that calls the regular comparison function.
+ *
+ * A sort support function may additionally provide "abbreviated keys":
+ * a conversion of each value into a pass-by-value Datum that can be
+ * compared cheaply, and that sorts consistently with the full value but
+ * may compare equal where the full values don't.  Ties on the abbreviated
+ * key must then be resolved by comparing the full values.  Since whether
+ * this pays off depends on the data, the abbreviation can be abandoned
+ * part-way through; see abbrev_abort.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SORTSUPPORT_H
+#define SORTSUPPORT_H
+
+#include "access/attnum.h"
+
+typedef struct SortSupportData *SortSupport;
+
+typedef struct SortSupportData
+{
+	/*
+	 * These fields are initialized before calling the sort support function
+	 * and should not be changed later.
+	 */
+	MemoryContext ssup_cxt;		/* Context containing sort info */
+	bool		ssup_reverse;	/* descending-order sort? */
+	bool		ssup_nulls_first;		/* sort nulls first? */
+
+	/*
+	 * These fields are workspace for callers, and should not be touched by
+	 * sort support functions.
+	 */
+	AttrNumber	ssup_attno;		/* column number to sort */
+
+	/*
+	 * ssup_extra is zeroed before calling the sort support function, and is
+	 * not touched subsequently by callers.
+	 */
+	void	   *ssup_extra;		/* Workspace for opclass functions */
+
+	/*
+	 * Function pointers are zeroed before calling the sort support function,
+	 * and must be set by it for any acceleration methods it wants to supply.
+	 * The comparator pointer must be set, others are optional.
+	 */
+
+	/*
+	 * Comparator function has the same API as the traditional btree
+	 * comparison function, ie, return <0, 0, or >0 according as x is less
+	 * than, equal to, or greater than y.  Note that x and y are guaranteed
+	 * not null, and there is no way to return null either.  Do not return
+	 * INT_MIN, as callers are allowed to negate the result before using it.
+	 *
+	 * While abbreviated keys are in use, this compares abbreviated keys.
+	 */
+	int			(*comparator) (Datum x, Datum y, SortSupport ssup);
+
+	/*
+	 * The caller sets "abbreviate" if it is able to cope with abbreviated
+	 * keys (it is only considered for the leading sort key).  If the sort
+	 * support function supports them, it sets abbrev_converter,
+	 * abbrev_abort and abbrev_full_comparator, and makes comparator compare
+	 * abbreviated keys; otherwise the caller resets "abbreviate" to false.
+	 *
+	 * abbrev_converter turns an original, non-null value into its
+	 * abbreviated key.  abbrev_full_comparator compares two original values
+	 * and is used to break ties between abbreviated keys.  abbrev_abort is
+	 * called from time to time during the conversion with the number of
+	 * values converted so far; if it returns true the caller stops
+	 * abbreviating, switches comparator to abbrev_full_comparator and
+	 * goes back to using the original values.
+	 */
+	bool		abbreviate;
+
+	Datum		(*abbrev_converter) (Datum original, SortSupport ssup);
+	bool		(*abbrev_abort) (int memtupcount, SortSupport ssup);
+	int			(*abbrev_full_comparator) (Datum x, Datum y, SortSupport ssup);
+} SortSupportData;
+
+
+/*
+ * ApplySortComparator and friends should be inlined if possible; if the
+ * compiler can't, sortsupport.c provides out-of-line versions.
+ */
+#if defined(USE_INLINE)
+
+/*
+ * Apply a sort comparator function and return a 3-way comparison result.
+ * This takes care of handling reverse-sort and NULLs-ordering properly.
+ */
+static inline int
+ApplySortComparator(Datum datum1, bool isNull1,
+					Datum datum2, bool isNull2,
+					SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		compare = (*ssup->comparator) (datum1, datum2, ssup);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+
+/*
+ * Like ApplySortComparator, but compares original values with the
+ * abbrev_full_comparator.  Used to break ties between abbreviated keys.
+ */
+static inline int
+ApplySortAbbrevFullComparator(Datum datum1, bool isNull1,
+							  Datum datum2, bool isNull2,
+							  SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		compare = (*ssup->abbrev_full_comparator) (datum1, datum2, ssup);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+#else
+
+extern int ApplySortComparator(Datum datum1, bool isNull1,
+					Datum datum2, bool isNull2,
+					SortSupport ssup);
+extern int ApplySortAbbrevFullComparator(Datum datum1, bool isNull1,
+							  Datum datum2, bool isNull2,
+							  SortSupport ssup);
+#endif   /* USE_INLINE */
+
+/* Other functions in utils/sort/sortsupport.c */
+extern void PrepareSortSupportComparisonShim(Oid cmpFunc, SortSupport ssup);
+extern void PrepareSortSupportFromOrderingOp(Oid orderingOp, SortSupport ssup);
+
+/* Sort support functions for built-in btree opclasses */
+extern void btint2sortsupport(SortSupport ssup);
+extern void btint4sortsupport(SortSupport ssup);
+extern void btint8sortsupport(SortSupport ssup);
+extern void btoidsortsupport(SortSupport ssup);
+extern void btfloat4sortsupport(SortSupport ssup);
+extern void btfloat8sortsupport(SortSupport ssup);
+extern void bttextsortsupport(SortSupport ssup);
+extern void numeric_sortsupport(SortSupport ssup);
+
+#endif   /* SORTSUPPORT_H */
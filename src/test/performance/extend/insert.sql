@@ -0,0 +1,4 @@
+-- $PostgreSQL$
+--
+-- pgbench script for concurrent bulk inserts into one table; see README
+INSERT INTO extend_test SELECT g, repeat('x', 100) FROM generate_series(1, 1000) g;
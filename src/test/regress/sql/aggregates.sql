@@ -362,3 +362,37 @@ select string_agg(a,',') from (values('aaaa'),('bbbb'),('cccc')) g(a);
 select string_agg(a,',') from (values('aaaa'),(null),('bbbb'),('cccc')) g(a);
 select string_agg(a,',') from (values(null),(null),('bbbb'),('cccc')) g(a);
 select string_agg(a,',') from (values(null),(null)) g(a);
+
+-- hashed aggregation with more groups than fit in work_mem
+set work_mem = '64kB';
+explain (costs off)
+select count(*), sum(n), min(n), max(n)
+  from (select g % 10000 as k, count(*) as n
+          from generate_series(1, 30000) g group by 1) s;
+select count(*), sum(n), min(n), max(n)
+  from (select g % 10000 as k, count(*) as n
+          from generate_series(1, 30000) g group by 1) s;
+
+-- report how deeply the hash aggregate had to repartition its spill files
+create function hashagg_spill_levels(query text) returns int as $$
+declare
+  ln text;
+begin
+  for ln in execute 'explain (analyze, costs off) ' || query loop
+    if ln ~ 'Spill Levels:' then
+      return substring(ln from 'Spill Levels: ([0-9]+)')::int;
+    end if;
+  end loop;
+  return null;
+end;
+$$ language plpgsql;
+
+select hashagg_spill_levels('select count(*) from (select g % 10000 as k, count(*) as n from generate_series(1, 30000) g group by 1) s');
+-- enough groups that each spilled partition overflows again
+select hashagg_spill_levels('select count(*) from (select g % 60000 as k, count(*) as n from generate_series(1, 180000) g group by 1) s');
+select count(*), sum(n), min(n), max(n)
+  from (select g % 60000 as k, count(*) as n
+          from generate_series(1, 180000) g group by 1) s;
+
+drop function hashagg_spill_levels(text);
+reset work_mem;
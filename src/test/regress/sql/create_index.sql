@@ -426,3 +426,51 @@ RESET enable_indexscan;
 RESET enable_bitmapscan;
  
 DROP TABLE onek_with_null;
+
+--
+-- Index-only scans
+--
+CREATE TABLE ios_test (a int, b int, c text);
+INSERT INTO ios_test SELECT g, g % 100, 'x' || g FROM generate_series(1, 2000) g;
+CREATE INDEX ios_test_a_b ON ios_test (a, b);
+CREATE INDEX ios_test_expr ON ios_test ((a % 10), a);
+VACUUM ANALYZE ios_test;
+
+SET enable_seqscan = OFF;
+SET enable_bitmapscan = OFF;
+
+-- every column the query needs is in the index
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM ios_test WHERE a BETWEEN 100 AND 105;
+SELECT a, b FROM ios_test WHERE a BETWEEN 100 AND 105;
+
+-- c is not in the index, so this has to visit the heap
+EXPLAIN (COSTS OFF)
+SELECT a, c FROM ios_test WHERE a BETWEEN 100 AND 105;
+SELECT a, c FROM ios_test WHERE a BETWEEN 100 AND 105;
+
+-- the expression column is not returned, but the plain column is
+EXPLAIN (COSTS OFF)
+SELECT a FROM ios_test WHERE a % 10 = 3 AND a < 100;
+SELECT a FROM ios_test WHERE a % 10 = 3 AND a < 100;
+
+-- scanning the index backward
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM ios_test WHERE a BETWEEN 100 AND 105 ORDER BY a DESC;
+SELECT a, b FROM ios_test WHERE a BETWEEN 100 AND 105 ORDER BY a DESC;
+
+-- duplicate outer keys make the merge join restore the inner scan to its mark
+SET enable_hashjoin = OFF;
+SET enable_nestloop = OFF;
+EXPLAIN (COSTS OFF)
+SELECT count(*), sum(t1.a) FROM ios_test t1
+    WHERE t1.a <= 300 AND NOT EXISTS (SELECT 1 FROM ios_test t2 WHERE t2.a = t1.b);
+SELECT count(*), sum(t1.a) FROM ios_test t1
+    WHERE t1.a <= 300 AND NOT EXISTS (SELECT 1 FROM ios_test t2 WHERE t2.a = t1.b);
+
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+RESET enable_hashjoin;
+RESET enable_nestloop;
+
+DROP TABLE ios_test;
@@ -0,0 +1,44 @@
+--
+-- DIRECT_IO
+-- The suite normally runs with direct_io = off.  To exercise the O_DIRECT
+-- paths (md.c's bounce buffer, read-ahead and write combining, WAL opened
+-- with O_DIRECT), run it with "make check TEMP_CONFIG=file" where file
+-- contains "direct_io = all"; this test then checks the data makes the
+-- round trip through them.
+--
+
+SELECT enumvals FROM pg_settings WHERE name = 'direct_io';
+
+-- can only be set at server start
+SET direct_io = data;
+
+CREATE TABLE direct_io_tbl (id int, payload text);
+
+-- enough pages for read-ahead and write combining to come into play
+INSERT INTO direct_io_tbl
+  SELECT i, repeat(md5(i::text), 4) FROM generate_series(1, 20000) i;
+
+-- index builds write palloc'd pages through smgrextend
+CREATE INDEX direct_io_tbl_id ON direct_io_tbl (id);
+
+SELECT count(*), sum(id), count(DISTINCT payload) FROM direct_io_tbl;
+
+-- CLUSTER rewrites the heap from palloc'd pages too
+CLUSTER direct_io_tbl USING direct_io_tbl_id;
+
+DELETE FROM direct_io_tbl WHERE id % 3 = 0;
+
+VACUUM direct_io_tbl;
+
+SELECT count(*), sum(id), min(id), max(id) FROM direct_io_tbl;
+
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+
+SELECT id, payload = repeat(md5(id::text), 4) AS ok
+  FROM direct_io_tbl WHERE id BETWEEN 9998 AND 10002 ORDER BY id;
+
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+
+DROP TABLE direct_io_tbl;
@@ -0,0 +1,74 @@
+--
+-- HASH_JOIN
+-- Hash joins with a work_mem small enough that the inner side has to be
+-- split into several batches, either as planned or, when the planner
+-- underestimates it, by adding batches while the hash table is loaded.
+--
+
+CREATE TEMP TABLE hj_inner AS
+  SELECT i AS id, i % 100 AS grp, md5(i::text) AS t
+  FROM generate_series(1, 5000) i;
+CREATE TEMP TABLE hj_outer AS
+  SELECT i AS id, md5(i::text) AS t
+  FROM generate_series(1, 20000) i;
+ANALYZE hj_inner;
+ANALYZE hj_outer;
+
+SET work_mem = '64kB';
+SET enable_mergejoin = off;
+SET enable_nestloop = off;
+
+-- planned with several batches
+EXPLAIN (COSTS OFF)
+SELECT count(*), sum(i.id) FROM hj_outer o JOIN hj_inner i ON o.id = i.id;
+SELECT count(*), sum(i.id), sum(CASE WHEN o.t = i.t THEN 1 ELSE 0 END) AS same
+  FROM hj_outer o JOIN hj_inner i ON o.id = i.id;
+
+-- The planner expects 25 inner rows and a single batch, but there are
+-- 1250, so batches are added as the hash table fills up, moving tuples out
+-- of the dense chunks.  Every 25th tuple is larger than a quarter of a
+-- chunk and gets a chunk of its own.  OFFSET 0 keeps the subquery from
+-- being flattened, so that the padding is built below the Hash node.
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+  FROM hj_outer o
+  JOIN (SELECT id, repeat(t, CASE WHEN id % 100 = 0 THEN 300 ELSE 1 END) AS pad
+          FROM hj_inner WHERE grp % 4 = 0 OFFSET 0) i ON o.id = i.id;
+SELECT count(*), sum(length(i.pad)),
+       sum(CASE WHEN i.pad = repeat(o.t, CASE WHEN o.id % 100 = 0 THEN 300
+                                              ELSE 1 END)
+                THEN 1 ELSE 0 END) AS same
+  FROM hj_outer o
+  JOIN (SELECT id, repeat(t, CASE WHEN id % 100 = 0 THEN 300 ELSE 1 END) AS pad
+          FROM hj_inner WHERE grp % 4 = 0 OFFSET 0) i ON o.id = i.id;
+SELECT count(*), count(i.id), sum(length(i.pad))
+  FROM hj_outer o
+  LEFT JOIN (SELECT id, repeat(t, CASE WHEN id % 100 = 0 THEN 300 ELSE 1 END) AS pad
+               FROM hj_inner WHERE grp % 4 = 0 OFFSET 0) i ON o.id = i.id;
+
+-- When several batches are planned, the Hash node also builds a bloom
+-- filter over the inner hash values.  Three quarters of the outer rows have
+-- no match, and the filter lets most of them skip the batch files: they are
+-- dropped by inner joins and semijoins, and emitted at once by outer joins
+-- and antijoins.  A NULL key never matches.
+INSERT INTO hj_outer VALUES (NULL, NULL);
+ANALYZE hj_outer;
+
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM hj_outer o LEFT JOIN hj_inner i ON o.id = i.id;
+SELECT count(*), count(i.id),
+       sum(CASE WHEN i.id IS NULL THEN o.id END) AS unmatched,
+       sum(CASE WHEN o.t = i.t THEN 1 ELSE 0 END) AS same
+  FROM hj_outer o LEFT JOIN hj_inner i ON o.id = i.id;
+SELECT count(*), sum(i.id)
+  FROM hj_outer o JOIN hj_inner i ON o.id = i.id;
+SELECT count(*), sum(o.id)
+  FROM hj_outer o WHERE EXISTS (SELECT 1 FROM hj_inner i WHERE i.id = o.id);
+SELECT count(*), count(o.id), sum(o.id)
+  FROM hj_outer o WHERE NOT EXISTS (SELECT 1 FROM hj_inner i WHERE i.id = o.id);
+
+RESET work_mem;
+RESET enable_mergejoin;
+RESET enable_nestloop;
+
+DROP TABLE hj_inner, hj_outer;
@@ -207,3 +207,35 @@ drop function sillysrf(int);
 -- (see bug #5084)
 select * from (values (2),(null),(1)) v(k) where k = k order by k;
 select * from (values (2),(null),(1)) v(k) where k = k;
+
+-- ORDER BY whose leading key is provided by an index can be done as an
+-- incremental sort; check that the groups come out properly ordered, and
+-- that a LIMIT ending partway through a group is honored
+set enable_seqscan = off;
+set enable_bitmapscan = off;
+explain (costs off)
+select thousand, twothousand, tenthous from tenk1
+  where thousand < 2
+  order by thousand, twothousand desc, tenthous limit 12;
+select thousand, twothousand, tenthous from tenk1
+  where thousand < 2
+  order by thousand, twothousand desc, tenthous limit 12;
+-- rescan of an incremental sort, after reading only part of its output
+select x, (select tenthous from tenk1
+             where thousand < 2 and tenthous >= x
+             order by thousand, twothousand desc, tenthous
+             limit 1 offset 6)
+  from (values (0), (2500), (6000)) v(x);
+reset enable_seqscan;
+reset enable_bitmapscan;
+
+-- Simple quals on a seqscan are tested by the heap scan itself; check that
+-- works for out-of-line values, and with the constant on either side
+create temp table scankey_toast (id int, t text);
+alter table scankey_toast alter column t set storage external;
+insert into scankey_toast
+  select g, repeat('x', 3000) || g from generate_series(1, 200) g;
+select id from scankey_toast where t = repeat('x', 3000) || '150';
+select count(*) from scankey_toast where t > repeat('x', 3000) || '5';
+select count(*) from scankey_toast where repeat('x', 3000) || '5' < t;
+drop table scankey_toast;
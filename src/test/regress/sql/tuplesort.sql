@@ -0,0 +1,118 @@
+--
+-- TUPLESORT
+-- Sorts using abbreviated keys: numeric, and text when lc_collate is C
+-- (as in "make check NO_LOCALE=1"; in other locales the text sorts below
+-- still run, just without abbreviation).  Each bulk sort is done with
+-- work_mem large enough to sort in memory and again small enough to force
+-- an external sort, where tuples read back from tape are merged with the
+-- full comparator.  Sort order is checked against the type's own > operator,
+-- so the results don't depend on the locale.
+--
+
+-- numeric: NaN, signs, values that tie on the first 16 digits, and weights
+-- too large or too small to fit in an abbreviated key
+CREATE TEMP TABLE abbrev_numeric (label text, v numeric);
+INSERT INTO abbrev_numeric VALUES
+  ('nan', 'NaN'), ('null', NULL), ('zero', 0),
+  ('one', 1), ('minus_one', -1), ('half', 0.5), ('minus_half', -0.5),
+  ('tie', 1234567890123456), ('tie_1', 1234567890123456.1),
+  ('tie_2', 1234567890123456.2),
+  ('minus_tie_1', -1234567890123456.1), ('minus_tie_2', -1234567890123456.2),
+  ('e300', 1e300), ('e-100', 1e-100),
+  ('e500', 1e500), ('2e500', 2e500), ('minus_e500', -1e500),
+  ('minus_2e500', -2e500),
+  ('e-500', 1e-500), ('e-501', 1e-501), ('minus_e-500', -1e-500);
+
+SELECT label FROM abbrev_numeric ORDER BY v;
+SELECT label FROM abbrev_numeric ORDER BY v DESC NULLS LAST;
+
+CREATE TEMP TABLE abbrev_numeric_bulk AS
+  SELECT i, CASE
+           WHEN i % 101 = 0 THEN NULL
+           WHEN i % 97 = 0 THEN 'NaN'
+           ELSE (CASE WHEN i % 2 = 0 THEN '-' ELSE '' END) ||
+                '1234567890123' || (i % 1000) || '.' || (i % 7) ||
+                'e' || ((i % 9) * 120 - 480)
+         END::numeric AS v
+  FROM generate_series(1, 30000) i;
+
+SET work_mem = '16MB';
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v) AS prev
+          FROM abbrev_numeric_bulk) s
+  WHERE prev > v;
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v DESC) AS prev
+          FROM abbrev_numeric_bulk) s
+  WHERE prev < v;
+SELECT count(*), count(v), sum(CASE WHEN v = 'NaN' THEN 1 END) AS nans
+  FROM (SELECT v FROM abbrev_numeric_bulk ORDER BY v) s;
+
+SET work_mem = '64kB';
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v) AS prev
+          FROM abbrev_numeric_bulk) s
+  WHERE prev > v;
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v DESC) AS prev
+          FROM abbrev_numeric_bulk) s
+  WHERE prev < v;
+SELECT count(*), count(v), sum(CASE WHEN v = 'NaN' THEN 1 END) AS nans
+  FROM (SELECT v FROM abbrev_numeric_bulk ORDER BY v) s;
+RESET work_mem;
+
+-- text: empty and short strings, and strings that tie on their first
+-- eight bytes; lower-case letters only, so the order is the same in any
+-- locale
+CREATE TEMP TABLE abbrev_text (v text);
+INSERT INTO abbrev_text VALUES
+  ('abcdefgh'), ('abcdefghi'), ('abcdefg'), ('abcdefghb'), ('abcdefgha'),
+  (''), ('b'), ('abcdefgg'), ('abcdefghaa'), (NULL), ('a'), ('abcdefgh');
+
+SELECT v FROM abbrev_text ORDER BY v;
+SELECT v FROM abbrev_text ORDER BY v DESC;
+
+-- the first set differs early, so abbreviation pays off; in the second
+-- every string starts the same, so tuplesort should give up on it
+CREATE TEMP TABLE abbrev_text_bulk AS
+  SELECT i, CASE WHEN i % 101 = 0 THEN NULL
+                 WHEN i % 89 = 0 THEN ''
+                 ELSE substr(md5(i::text), 1, 1 + i % 20)
+            END AS v,
+         'abcdefghijkl' || md5(i::text) AS w
+  FROM generate_series(1, 20000) i;
+
+SET work_mem = '16MB';
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v) AS prev
+          FROM abbrev_text_bulk) s
+  WHERE prev > v;
+SELECT count(*) AS out_of_order
+  FROM (SELECT w, lag(w) OVER (ORDER BY w) AS prev
+          FROM abbrev_text_bulk) s
+  WHERE prev > w;
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, w, lag(v) OVER (ORDER BY v, w) AS prev_v,
+               lag(w) OVER (ORDER BY v, w) AS prev_w
+          FROM abbrev_text_bulk) s
+  WHERE prev_v > v OR (prev_v = v AND prev_w > w);
+
+SET work_mem = '64kB';
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, lag(v) OVER (ORDER BY v) AS prev
+          FROM abbrev_text_bulk) s
+  WHERE prev > v;
+SELECT count(*) AS out_of_order
+  FROM (SELECT w, lag(w) OVER (ORDER BY w) AS prev
+          FROM abbrev_text_bulk) s
+  WHERE prev > w;
+SELECT count(*) AS out_of_order
+  FROM (SELECT v, w, lag(v) OVER (ORDER BY v, w) AS prev_v,
+               lag(w) OVER (ORDER BY v, w) AS prev_w
+          FROM abbrev_text_bulk) s
+  WHERE prev_v > v OR (prev_v = v AND prev_w > w);
+SELECT count(*), count(v), count(DISTINCT w)
+  FROM (SELECT v, w FROM abbrev_text_bulk ORDER BY v) s;
+RESET work_mem;
+
+DROP TABLE abbrev_numeric, abbrev_numeric_bulk, abbrev_text, abbrev_text_bulk;
@@ -0,0 +1,23 @@
+--
+-- VACUUM FREEZE and the all-frozen visibility map bit
+--
+-- A freeze vacuum skips runs of pages marked all-frozen, and then leaves
+-- reltuples alone, which lets us see whether the bits are set.
+--
+
+CREATE TABLE vacfrz (a int, b text) WITH (autovacuum_enabled = false);
+INSERT INTO vacfrz SELECT g, repeat('x', 500) FROM generate_series(1, 1000) g;
+
+-- marks every page all-visible and all-frozen
+VACUUM FREEZE vacfrz;
+
+UPDATE pg_class SET reltuples = 0 WHERE relname = 'vacfrz';
+VACUUM FREEZE vacfrz;
+SELECT reltuples FROM pg_class WHERE relname = 'vacfrz';
+
+-- locking the rows stores an xmax in them, so the pages aren't frozen anymore
+SELECT count(*) FROM (SELECT a FROM vacfrz FOR SHARE) ss;
+VACUUM FREEZE vacfrz;
+SELECT reltuples FROM pg_class WHERE relname = 'vacfrz';
+
+DROP TABLE vacfrz;
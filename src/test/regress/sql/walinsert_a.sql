@@ -0,0 +1,20 @@
+--
+-- WALINSERT_A
+-- Concurrent WAL insertion.  This test runs in parallel with walinsert_b,
+-- so that many small records from this session are copied into the WAL
+-- buffers while the other session inserts records that span several pages.
+--
+CREATE TABLE walinsert_a (id int, payload text);
+
+INSERT INTO walinsert_a
+  SELECT g, repeat('a', g % 100) FROM generate_series(1, 20000) g;
+
+-- the first change to each page after this is logged with a full-page image
+CHECKPOINT;
+
+UPDATE walinsert_a SET payload = payload || 'x' WHERE id % 3 = 0;
+DELETE FROM walinsert_a WHERE id % 5 = 0;
+
+SELECT count(*), sum(length(payload)) FROM walinsert_a;
+
+DROP TABLE walinsert_a;
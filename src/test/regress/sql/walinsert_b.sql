@@ -0,0 +1,23 @@
+--
+-- WALINSERT_B
+-- Concurrent WAL insertion.  This test runs in parallel with walinsert_a;
+-- see there.  The records here are big enough to cross WAL page boundaries:
+-- out-of-line values are stored uncompressed, and after the checkpoint each
+-- heap update carries full-page images of both heap pages it touches.
+--
+CREATE TABLE walinsert_b (id int, payload text);
+ALTER TABLE walinsert_b ALTER COLUMN payload SET STORAGE EXTERNAL;
+
+INSERT INTO walinsert_b
+  SELECT g, repeat(md5(g::text), 400) FROM generate_series(1, 500) g;
+
+CHECKPOINT;
+
+UPDATE walinsert_b SET id = id + 1000;
+
+SELECT count(*), sum(length(payload)), min(id), max(id) FROM walinsert_b;
+
+SELECT count(*) FROM walinsert_b
+  WHERE payload <> repeat(md5((id - 1000)::text), 400);
+
+DROP TABLE walinsert_b;